@@ -0,0 +1,82 @@
+/**
+ *
+ * This tests logActionseqInRanges(), which filters the log rows that
+ * were already contained in the copy of a set.
+ *
+ * The function is checked directly, with the ranges given as a
+ * constant and as a column that differs from row to row.  A set is
+ * then subscribed while the origin is under load, so the first SYNC
+ * after the copy has to skip the action sequences of the copy.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+ActionseqRanges=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests filtering log rows by action sequence ranges';
+}
+ActionseqRanges.prototype = new BasicTest();
+ActionseqRanges.prototype.constructor = ActionseqRanges;
+
+ActionseqRanges.prototype.runTest = function() {
+        this.coordinator.log("ActionseqRanges.prototype.runTest - begin");
+
+	this.testResults.newGroup("Actionseq Ranges");
+	this.setupReplication();
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	var func = "_" + this.getClusterName() + ".logActionseqInRanges";
+
+	/**
+	 * Unsorted, overlapping ranges as a constant: 10-20, 15-30, 5-5
+	 * and 100-200 leave 5, 10-30 and 100-200, 123 values.
+	 */
+	var rs = stat.executeQuery("select count(*) from generate_series(1, 300) as s "
+				   + "where " + func + "(s, '{100,200,15,30,5,5,10,20}'::int8[])");
+	rs.next();
+	this.testResults.assertCheck('constant ranges', rs.getInt(1), 123);
+	rs.close();
+
+	rs = stat.executeQuery("select count(*) from generate_series(1, 300) as s "
+			       + "where " + func + "(s, '{}'::int8[])");
+	rs.next();
+	this.testResults.assertCheck('empty ranges', rs.getInt(1), 0);
+	rs.close();
+
+	/**
+	 * A range per row, covering only the row itself every other row.
+	 */
+	rs = stat.executeQuery("select count(*) from generate_series(1, 300) as s "
+			       + "where " + func + "(s, case when s % 2 = 0 "
+			       + "then array[s, s] else array[s + 1, s + 1] end::int8[])");
+	rs.next();
+	this.testResults.assertCheck('ranges changing per row', rs.getInt(1), 150);
+	rs.close();
+	stat.close();
+	dbCon.close();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(5*1000);
+	this.subscribeSet(1,1,1,[2]);
+	java.lang.Thread.sleep(5*1000);
+	populate.stop();
+	this.coordinator.join(populate);
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("ActionseqRanges.prototype.runTest - complete");
+}
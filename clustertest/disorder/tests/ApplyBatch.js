@@ -0,0 +1,130 @@
+/**
+ *
+ * This tests batch apply on the subscribers (apply_batch_size).
+ *
+ * All slons apply in batches.  Node 2 has a deferred constraint
+ * trigger on do_customer that is enabled for replicas, so the rows
+ * applied in a batch must queue its events before the transaction
+ * commits.  A set-based UPDATE of all customers on the origin is
+ * then expected to fire the trigger on node 2 once per customer.
+ *
+ * A second set holds a table with a unique column besides its primary
+ * key.  Every row takes over the value the next row gave up just
+ * before, which must not fail on the subscribers.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+ApplyBatch=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests applying log rows in batches';
+}
+ApplyBatch.prototype = new BasicTest();
+ApplyBatch.prototype.constructor = ApplyBatch;
+
+ApplyBatch.prototype.runTest = function() {
+        this.coordinator.log("ApplyBatch.prototype.runTest - begin");
+
+	this.testResults.newGroup("Apply Batch");
+	this.setupReplication();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		var confMap = this.getSlonConfFileMap(idx);
+		confMap.put('apply_batch_size','50');
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx,confMap);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2,3]);
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		var dbConN = this.coordinator.createJdbcConnection('db' + idx);
+		var statN = dbConN.createStatement();
+		statN.execute("create table disorder.do_batch_unique (bu_id integer primary key, "
+			      + "bu_email varchar not null unique)");
+		statN.close();
+		dbConN.close();
+	}
+	var tableId = this.tableIdCounter;
+	var slonikPreamble = this.getSlonikPreamble();
+	var slonikScript = 'echo \'ApplyBatch.prototype.runTest\';\n';
+	slonikScript += 'create set(id=2, origin=1, comment=\'unique set\');\n'
+		+ 'set add table(set id=2, origin=1, id=' + tableId
+		+ ', fully qualified name=\'disorder.do_batch_unique\');\n';
+	this.tableIdCounter++;
+	var slonik = this.coordinator.createSlonik('create set 2', slonikPreamble, slonikScript);
+	slonik.run();
+	this.coordinator.join(slonik);
+	this.testResults.assertCheck('create set 2 succeeded', slonik.getReturnCode(), 0);
+	this.subscribeSet(2,1,1,[2,3]);
+
+	var dbCon2 = this.coordinator.createJdbcConnection('db2');
+	var stat2 = dbCon2.createStatement();
+	stat2.execute("create table disorder.do_customer_audit (ca_c_id bigint, ca_c_name varchar)");
+	stat2.execute("create function disorder.customer_audit() returns trigger "
+		      + "language plpgsql as $$ begin "
+		      + "insert into disorder.do_customer_audit values (NEW.c_id, NEW.c_name); "
+		      + "return null; end; $$");
+	stat2.execute("create constraint trigger customer_audit after update on disorder.do_customer "
+		      + "deferrable initially deferred for each row "
+		      + "execute procedure disorder.customer_audit()");
+	stat2.execute("alter table disorder.do_customer enable always trigger customer_audit");
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(10*1000);
+	populate.stop();
+	this.coordinator.join(populate);
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	stat.execute("update disorder.do_customer set c_name = 'batch ' || c_id");
+	var rs = stat.executeQuery("select count(*) from disorder.do_customer");
+	rs.next();
+	var customers = rs.getInt(1);
+	rs.close();
+
+	/**
+	 * Row n moves from email n to n + 1, starting with the last row,
+	 * so every UPDATE takes the value the previous one just freed.
+	 */
+	stat.execute("insert into disorder.do_batch_unique "
+		     + "select i, 'email ' || i from generate_series(1, 200) as i");
+	dbCon.setAutoCommit(false);
+	for(var idx=200; idx >= 1; idx--) {
+		stat.execute("update disorder.do_batch_unique set bu_email = 'email "
+			     + (idx + 1) + "' where bu_id = " + idx);
+	}
+	dbCon.commit();
+	dbCon.setAutoCommit(true);
+	stat.close();
+	dbCon.close();
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+	this.compareDb('db1','db3');
+
+	rs = stat2.executeQuery("select count(distinct ca_c_id) from disorder.do_customer_audit "
+				+ "where ca_c_name = 'batch ' || ca_c_id");
+	rs.next();
+	this.testResults.assertCheck('deferred trigger fired for batched rows', rs.getInt(1), customers);
+	rs.close();
+	rs = stat2.executeQuery("select count(*) from disorder.do_batch_unique "
+				+ "where bu_email = 'email ' || (bu_id + 1)");
+	rs.next();
+	this.testResults.assertCheck('chained unique updates replicated', rs.getInt(1), 200);
+	rs.close();
+
+	stat2.execute("drop trigger customer_audit on disorder.do_customer");
+	stat2.execute("drop function disorder.customer_audit()");
+	stat2.execute("drop table disorder.do_customer_audit");
+	stat2.close();
+	dbCon2.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("ApplyBatch.prototype.runTest - complete");
+}
@@ -0,0 +1,93 @@
+/**
+ *
+ * This tests the binary log capture format (logtrigger.format = 2).
+ *
+ * The origin captures values of the built in types it can ship in
+ * binary into log_cmdbinargs.  Node 2 subscribes from the origin and
+ * node 3 from node 2, so the binary log rows are also forwarded.
+ * The test checks that the rows were in fact captured in binary,
+ * that logCmdArgsText() turns them back into complete log_cmdargs
+ * and that all nodes end up with the same data.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+BinaryLogFormat=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests the binary log capture format';
+}
+BinaryLogFormat.prototype = new BasicTest();
+BinaryLogFormat.prototype.constructor = BinaryLogFormat;
+
+BinaryLogFormat.prototype.runTest = function() {
+        this.coordinator.log("BinaryLogFormat.prototype.runTest - begin");
+
+	this.testResults.newGroup("Binary Log Format");
+	this.setupReplication();
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	stat.execute("insert into _" + this.getClusterName()
+		     + ".sl_registry (reg_key, reg_int4) values ('logtrigger.format', 2)");
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+	this.subscribeSet(1,1,2,[3]);
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(10*1000);
+
+	/**
+	 * The log rows on the origin must be in the binary format and
+	 * logCmdArgsText() must return a value for every binary value.
+	 */
+	var rs = stat.executeQuery("select count(*), "
+				   + "sum(case when array_length(_" + this.getClusterName()
+				   + ".logCmdArgsText(log_cmdargs, log_cmdbinargs), 1) = "
+				   + "array_length(log_cmdargs, 1) then 1 else 0 end) "
+				   + "from (select log_cmdargs, log_cmdbinargs from _"
+				   + this.getClusterName() + ".sl_log_1 where log_cmdformat = 2 "
+				   + "union all select log_cmdargs, log_cmdbinargs from _"
+				   + this.getClusterName() + ".sl_log_2 where log_cmdformat = 2) as L");
+	rs.next();
+	this.testResults.assertCheck('log rows captured in binary', rs.getInt(1) > 0, true);
+	this.testResults.assertCheck('logCmdArgsText keeps all arguments', rs.getInt(2), rs.getInt(1));
+	rs.close();
+
+	rs = stat.executeQuery("select count(*) from "
+			       + "(select log_cmdargs, log_cmdbinargs from _"
+			       + this.getClusterName() + ".sl_log_1 where log_cmdformat = 2 "
+			       + "union all select log_cmdargs, log_cmdbinargs from _"
+			       + this.getClusterName() + ".sl_log_2 where log_cmdformat = 2) as L, "
+			       + "generate_series(1, array_length(log_cmdbinargs, 1)) as I "
+			       + "where log_cmdbinargs[I] is not null "
+			       + "and (_" + this.getClusterName()
+			       + ".logCmdArgsText(log_cmdargs, log_cmdbinargs))[I * 2] is null");
+	rs.next();
+	this.testResults.assertCheck('no binary value converts to NULL', rs.getInt(1), 0);
+	rs.close();
+
+	populate.stop();
+	this.coordinator.join(populate);
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+	this.compareDb('db1','db3');
+
+	stat.execute("delete from _" + this.getClusterName()
+		     + ".sl_registry where reg_key = 'logtrigger.format'");
+	stat.close();
+	dbCon.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("BinaryLogFormat.prototype.runTest - complete");
+}
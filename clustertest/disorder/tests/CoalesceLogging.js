@@ -0,0 +1,182 @@
+/**
+ *
+ * This tests coalescing the changes to a row within a transaction
+ * (setTableCoalesce()).
+ *
+ * do_coalesce, keyed by a timestamptz, is added in a second set with
+ * coalescing turned on at the origin.  The test covers a TRUNCATE
+ * discarding pending rows, an INSERT followed by a DELETE, an UPDATE
+ * followed by a DELETE, a rolled back savepoint, a DDL script that
+ * logs the pending rows before itself and a change of TimeZone between
+ * two changes of the same row.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+CoalesceLogging=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests coalescing the changes to a row within a transaction';
+}
+CoalesceLogging.prototype = new BasicTest();
+CoalesceLogging.prototype.constructor = CoalesceLogging;
+
+CoalesceLogging.prototype.runTest = function() {
+        this.coordinator.log("CoalesceLogging.prototype.runTest - begin");
+
+	this.testResults.newGroup("Coalesce Logging");
+	this.setupReplication();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+
+	for(var idx=1; idx <= 2; idx++) {
+		var dbConN = this.coordinator.createJdbcConnection('db' + idx);
+		var statN = dbConN.createStatement();
+		statN.execute("create table disorder.do_coalesce (co_ts timestamptz primary key, "
+			      + "co_name varchar not null, co_val integer not null)");
+		statN.close();
+		dbConN.close();
+	}
+	var tableId = this.tableIdCounter;
+	var slonikPreamble = this.getSlonikPreamble();
+	var slonikScript = 'echo \'CoalesceLogging.prototype.runTest\';\n';
+	slonikScript += 'create set(id=2, origin=1, comment=\'coalesce set\');\n'
+		+ 'set add table(set id=2, origin=1, id=' + tableId
+		+ ', fully qualified name=\'disorder.do_coalesce\');\n';
+	this.tableIdCounter++;
+	var slonik = this.coordinator.createSlonik('create set 2', slonikPreamble, slonikScript);
+	slonik.run();
+	this.coordinator.join(slonik);
+	this.testResults.assertCheck('create set 2 succeeded', slonik.getReturnCode(), 0);
+	this.subscribeSet(2,1,1,[2]);
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	var schema = "_" + this.getClusterName();
+	stat.execute("select " + schema + ".setTableCoalesce(" + tableId + ", true)");
+	var logCountQuery = "select (select count(*) from " + schema
+		+ ".sl_log_1 where log_tableid = " + tableId + ") + "
+		+ "(select count(*) from " + schema
+		+ ".sl_log_2 where log_tableid = " + tableId + ")";
+	var rowTs = function(n) {
+		return "'2020-01-01 00:00:00+00'::timestamptz + interval '" + n + " hours'";
+	};
+	var rs;
+
+	/**
+	 * Committed starting rows 1 to 5.
+	 */
+	stat.execute("insert into disorder.do_coalesce "
+		     + "select '2020-01-01 00:00:00+00'::timestamptz + i * interval '1 hour', "
+		     + "'row ' || i, 1 from generate_series(1, 5) as i");
+
+	dbCon.setAutoCommit(false);
+
+	/**
+	 * TRUNCATE discards the pending INSERT of row 10; only row 11,
+	 * inserted after it, and the TRUNCATE itself are replicated.
+	 * The starting rows are inserted again afterwards.
+	 */
+	stat.execute("insert into disorder.do_coalesce values (" + rowTs(10) + ", 'row 10', 1)");
+	stat.execute("truncate disorder.do_coalesce");
+	stat.execute("insert into disorder.do_coalesce values (" + rowTs(11) + ", 'row 11', 1)");
+	stat.execute("insert into disorder.do_coalesce "
+		     + "select '2020-01-01 00:00:00+00'::timestamptz + i * interval '1 hour', "
+		     + "'row ' || i, 1 from generate_series(1, 5) as i");
+	dbCon.commit();
+
+	rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	var logRows = rs.getInt(1);
+	rs.close();
+	dbCon.commit();
+
+	/**
+	 * INSERT then DELETE, and UPDATE then DELETE of an existing row.
+	 */
+	stat.execute("insert into disorder.do_coalesce values (" + rowTs(20) + ", 'row 20', 1)");
+	stat.execute("delete from disorder.do_coalesce where co_ts = " + rowTs(20));
+	stat.execute("update disorder.do_coalesce set co_val = 2 where co_ts = " + rowTs(1));
+	stat.execute("delete from disorder.do_coalesce where co_ts = " + rowTs(1));
+	dbCon.commit();
+	rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	this.testResults.assertCheck('insert then delete not logged, update then delete logged once',
+				     rs.getInt(1), logRows + 1);
+	logRows = rs.getInt(1);
+	rs.close();
+	dbCon.commit();
+
+	/**
+	 * The changes after the savepoint are rolled back, the one before
+	 * it stays.
+	 */
+	stat.execute("update disorder.do_coalesce set co_val = 2 where co_ts = " + rowTs(2));
+	var savepoint = dbCon.setSavepoint();
+	stat.execute("update disorder.do_coalesce set co_val = 3 where co_ts = " + rowTs(2));
+	stat.execute("insert into disorder.do_coalesce values (" + rowTs(21) + ", 'row 21', 1)");
+	stat.execute("delete from disorder.do_coalesce where co_ts = " + rowTs(3));
+	dbCon.rollback(savepoint);
+	dbCon.commit();
+
+	/**
+	 * A change of TimeZone between two changes of the same row must
+	 * not split it: the INSERT and DELETE of row 22 cancel out, and
+	 * the two UPDATEs of row 4 are logged as one.
+	 */
+	stat.execute("set local timezone = 'UTC'");
+	stat.execute("insert into disorder.do_coalesce values (" + rowTs(22) + ", 'row 22', 1)");
+	stat.execute("update disorder.do_coalesce set co_val = 2 where co_ts = " + rowTs(4));
+	stat.execute("set local timezone = 'Asia/Tokyo'");
+	stat.execute("delete from disorder.do_coalesce where co_ts = " + rowTs(22));
+	stat.execute("update disorder.do_coalesce set co_val = 3 where co_ts = " + rowTs(4));
+	dbCon.commit();
+	rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	this.testResults.assertCheck('savepoint and timezone change logged once per row',
+				     rs.getInt(1), logRows + 2);
+	rs.close();
+	dbCon.commit();
+
+	/**
+	 * The pending UPDATE of row 5 must be logged before the script,
+	 * so the subscriber multiplies the updated value.
+	 */
+	var script = "update disorder.do_coalesce set co_val = co_val * 10 where co_ts = "
+		+ rowTs(5) + ";";
+	stat.execute("update disorder.do_coalesce set co_val = 2 where co_ts = " + rowTs(5));
+	rs = stat.executeQuery("select " + schema + ".ddlCapture('"
+			       + script.replace(/'/g, "''") + "', NULL)");
+	rs.close();
+	stat.execute(script);
+	dbCon.commit();
+	dbCon.setAutoCommit(true);
+	stat.close();
+	dbCon.close();
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+
+	var dbCon2 = this.coordinator.createJdbcConnection('db2');
+	var stat2 = dbCon2.createStatement();
+	rs = stat2.executeQuery("select string_agg(co_name || '=' || co_val, ',' order by co_ts) "
+				+ "from disorder.do_coalesce");
+	rs.next();
+	this.testResults.assertCheck('coalesced rows replicated',
+				     rs.getString(1), 'row 2=2,row 3=1,row 4=3,row 5=20,row 11=1');
+	rs.close();
+	stat2.close();
+	dbCon2.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("CoalesceLogging.prototype.runTest - complete");
+}
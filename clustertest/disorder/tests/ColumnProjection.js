@@ -0,0 +1,103 @@
+/**
+ *
+ * This tests the COLUMNS option of SET ADD TABLE.
+ *
+ * do_item_review is added in a second set without its comments
+ * column.  An UPDATE that changes only the comments must not create a
+ * log row, an UPDATE of a replicated column must, and the comments
+ * must never show up on the subscriber.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+ColumnProjection=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests replicating a subset of the columns of a table';
+}
+ColumnProjection.prototype = new BasicTest();
+ColumnProjection.prototype.constructor = ColumnProjection;
+
+ColumnProjection.prototype.runTest = function() {
+        this.coordinator.log("ColumnProjection.prototype.runTest - begin");
+
+	this.testResults.newGroup("Column Projection");
+	this.setupReplication();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+
+	var tableId = this.tableIdCounter;
+	var slonikPreamble = this.getSlonikPreamble();
+	var slonikScript = 'echo \'ColumnProjection.prototype.runTest\';\n';
+	slonikScript += 'create set(id=2, origin=1, comment=\'second set\');\n'
+		+ 'set add table(set id=2, origin=1, id=' + tableId
+		+ ', fully qualified name=\'disorder.do_item_review\', columns=\'ir_id, i_id\');\n';
+	this.tableIdCounter++;
+	var slonik = this.coordinator.createSlonik('create set 2', slonikPreamble, slonikScript);
+	slonik.run();
+	this.coordinator.join(slonik);
+	this.testResults.assertCheck('create set with columns succeeded', slonik.getReturnCode(), 0);
+	this.subscribeSet(2,1,1,[2]);
+
+	this.populateReviewTable(1);
+	this.slonikSync(1,1);
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	var logCountQuery = "select (select count(*) from _" + this.getClusterName()
+		+ ".sl_log_1 where log_tableid = " + tableId + ") + "
+		+ "(select count(*) from _" + this.getClusterName()
+		+ ".sl_log_2 where log_tableid = " + tableId + ")";
+
+	var rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	var logRows = rs.getInt(1);
+	rs.close();
+
+	stat.execute("update disorder.do_item_review set comments = 'changed on the origin'");
+	rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	this.testResults.assertCheck('update of excluded column not logged', rs.getInt(1), logRows);
+	rs.close();
+
+	stat.execute("update disorder.do_item_review set i_id = i_id + 1");
+	rs = stat.executeQuery(logCountQuery);
+	rs.next();
+	this.testResults.assertCheck('update of replicated column logged', rs.getInt(1) > logRows, true);
+	rs.close();
+
+	rs = stat.executeQuery("select count(*), sum(i_id) from disorder.do_item_review");
+	rs.next();
+	var rowCount = rs.getInt(1);
+	var idSum = rs.getLong(2);
+	rs.close();
+	stat.close();
+	dbCon.close();
+
+	this.slonikSync(1,1);
+
+	var dbCon2 = this.coordinator.createJdbcConnection('db2');
+	var stat2 = dbCon2.createStatement();
+	rs = stat2.executeQuery("select count(*), sum(i_id), count(comments) from disorder.do_item_review");
+	rs.next();
+	this.testResults.assertCheck('review rows replicated', rs.getInt(1), rowCount);
+	this.testResults.assertCheck('review keys replicated', rs.getLong(2), idSum);
+	this.testResults.assertCheck('comments not replicated', rs.getInt(3), 0);
+	rs.close();
+	stat2.close();
+	dbCon2.close();
+
+	this.compareDb('db1','db2');
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("ColumnProjection.prototype.runTest - complete");
+}
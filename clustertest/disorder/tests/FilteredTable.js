@@ -0,0 +1,145 @@
+/**
+ *
+ * This tests the FILTER option of SET ADD TABLE.
+ *
+ * do_filter is added in a second set with a filter on its tenant
+ * column.  Rows that exist before the subscription must be copied only
+ * if they pass the filter.  An UPDATE moving a row into the filter
+ * must be logged as an INSERT, one moving a row out of it as a DELETE,
+ * and one that stays outside must not be logged at all.  The
+ * subscriber must hold exactly the filtered rows of the origin after
+ * the subscription and after the load.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+FilteredTable=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests replicating the rows of a table that pass a filter';
+}
+FilteredTable.prototype = new BasicTest();
+FilteredTable.prototype.constructor = FilteredTable;
+
+FilteredTable.prototype.runTest = function() {
+        this.coordinator.log("FilteredTable.prototype.runTest - begin");
+
+	this.testResults.newGroup("Filtered Table");
+	this.setupReplication();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+
+	for(var idx=1; idx <= 2; idx++) {
+		var dbConN = this.coordinator.createJdbcConnection('db' + idx);
+		var statN = dbConN.createStatement();
+		statN.execute("create table disorder.do_filter (f_id integer primary key, "
+			      + "f_tenant integer not null, f_val varchar)");
+		statN.close();
+		dbConN.close();
+	}
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	stat.execute("insert into disorder.do_filter "
+		     + "select i, i % 10, 'initial ' || i from generate_series(1, 1000) as i");
+
+	var tableId = this.tableIdCounter;
+	var slonikPreamble = this.getSlonikPreamble();
+	var slonikScript = 'echo \'FilteredTable.prototype.runTest\';\n';
+	slonikScript += 'create set(id=2, origin=1, comment=\'filtered set\');\n'
+		+ 'set add table(set id=2, origin=1, id=' + tableId
+		+ ', fully qualified name=\'disorder.do_filter\', filter=\'f_tenant in (3, 7)\');\n';
+	this.tableIdCounter++;
+	var slonik = this.coordinator.createSlonik('create set 2', slonikPreamble, slonikScript);
+	slonik.run();
+	this.coordinator.join(slonik);
+	this.testResults.assertCheck('create set with filter succeeded', slonik.getReturnCode(), 0);
+	this.subscribeSet(2,1,1,[2]);
+	this.slonikSync(1,1);
+
+	var dbCon2 = this.coordinator.createJdbcConnection('db2');
+	var stat2 = dbCon2.createStatement();
+	var rowsQuery = "select count(*), coalesce(md5(string_agg(f_id || ':' || f_tenant || ':' "
+		+ "|| coalesce(f_val, ''), ',' order by f_id)), '') from disorder.do_filter";
+	var testResults = this.testResults;
+	var compareFiltered = function(label) {
+		var rs1 = stat.executeQuery(rowsQuery + " where f_tenant in (3, 7)");
+		var rs2 = stat2.executeQuery(rowsQuery);
+		rs1.next();
+		rs2.next();
+		testResults.assertCheck(label + ': filtered row count', rs2.getInt(1), rs1.getInt(1));
+		testResults.assertCheck(label + ': filtered rows', rs2.getString(2), rs1.getString(2));
+		rs1.close();
+		rs2.close();
+	};
+	compareFiltered('after subscribe');
+
+	var schema = "_" + this.getClusterName();
+	var logCounts = function() {
+		var counts = {};
+		var cmdtypes = ['I', 'U', 'D'];
+		for(var i=0; i < cmdtypes.length; i++) {
+			var rs = stat.executeQuery("select (select count(*) from " + schema
+						   + ".sl_log_1 where log_tableid = " + tableId
+						   + " and log_cmdtype = '" + cmdtypes[i] + "') + "
+						   + "(select count(*) from " + schema
+						   + ".sl_log_2 where log_tableid = " + tableId
+						   + " and log_cmdtype = '" + cmdtypes[i] + "')");
+			rs.next();
+			counts[cmdtypes[i]] = rs.getInt(1);
+			rs.close();
+		}
+		return counts;
+	};
+
+	/**
+	 * Row 1 (tenant 1) moves into the filter, row 3 (tenant 3) out of
+	 * it, row 2 (tenant 2) stays outside.
+	 */
+	var before = logCounts();
+	stat.execute("update disorder.do_filter set f_tenant = 7, f_val = 'moved in' where f_id = 1");
+	stat.execute("update disorder.do_filter set f_tenant = 4, f_val = 'moved out' where f_id = 3");
+	stat.execute("update disorder.do_filter set f_tenant = 5, f_val = 'stays out' where f_id = 2");
+	var after = logCounts();
+	this.testResults.assertCheck('update into the filter logged as insert', after['I'] - before['I'], 1);
+	this.testResults.assertCheck('update out of the filter logged as delete', after['D'] - before['D'], 1);
+	this.testResults.assertCheck('update outside the filter not logged', after['U'] - before['U'], 0);
+
+	/**
+	 * Move rows across the filter boundary in both directions while
+	 * the normal load runs.
+	 */
+	var populate=this.generateLoad();
+	for(var round=1; round <= 20; round++) {
+		stat.execute("update disorder.do_filter set f_tenant = (f_tenant + 1) % 10, "
+			     + "f_val = 'round " + round + "' where f_id % 20 = " + (round % 20));
+		stat.execute("insert into disorder.do_filter "
+			     + "select 1000 + " + round + " * 10 + i, i, 'new' "
+			     + "from generate_series(0, 9) as i");
+		stat.execute("delete from disorder.do_filter where f_id % 50 = " + round);
+		java.lang.Thread.sleep(500);
+	}
+	populate.stop();
+	this.coordinator.join(populate);
+
+	this.slonikSync(1,1);
+	compareFiltered('after load');
+	this.compareDb('db1','db2');
+
+	stat2.close();
+	dbCon2.close();
+	stat.close();
+	dbCon.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("FilteredTable.prototype.runTest - complete");
+}
@@ -0,0 +1,90 @@
+/**
+ *
+ * This tests the buffered log inserts of the log trigger
+ * (logtrigger.buffer).
+ *
+ * The buffer is made small enough that it is flushed inside a
+ * subtransaction.  Rows buffered by the parent must survive a
+ * rollback to the savepoint, rows of the rolled back subtransaction
+ * must not be replicated.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+LogBuffering=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests buffered log inserts with savepoints';
+}
+LogBuffering.prototype = new BasicTest();
+LogBuffering.prototype.constructor = LogBuffering;
+
+LogBuffering.prototype.runTest = function() {
+        this.coordinator.log("LogBuffering.prototype.runTest - begin");
+
+	this.testResults.newGroup("Log Buffering");
+	this.setupReplication();
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	stat.execute("insert into _" + this.getClusterName()
+		     + ".sl_registry (reg_key, reg_int4) values ('logtrigger.buffer', 5)");
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(10*1000);
+	populate.stop();
+	this.coordinator.join(populate);
+
+	/**
+	 * Three rows are buffered by the top level transaction.  The
+	 * subtransaction adds ten more, which flushes the buffer twice,
+	 * and is then rolled back.
+	 */
+	dbCon.setAutoCommit(false);
+	for(var idx=1; idx <= 3; idx++) {
+		stat.execute("insert into disorder.do_customer (c_name) values ('buffer parent " + idx + "')");
+	}
+	var savepoint = dbCon.setSavepoint();
+	for(var idx=1; idx <= 10; idx++) {
+		stat.execute("insert into disorder.do_customer (c_name) values ('buffer child " + idx + "')");
+	}
+	dbCon.rollback(savepoint);
+	stat.execute("insert into disorder.do_customer (c_name) values ('buffer parent 4')");
+	dbCon.commit();
+	dbCon.setAutoCommit(true);
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+
+	var dbCon2 = this.coordinator.createJdbcConnection('db2');
+	var stat2 = dbCon2.createStatement();
+	var rs = stat2.executeQuery("select count(*) from disorder.do_customer where c_name like 'buffer parent %'");
+	rs.next();
+	this.testResults.assertCheck('parent rows replicated', rs.getInt(1), 4);
+	rs.close();
+	rs = stat2.executeQuery("select count(*) from disorder.do_customer where c_name like 'buffer child %'");
+	rs.next();
+	this.testResults.assertCheck('rolled back rows not replicated', rs.getInt(1), 0);
+	rs.close();
+	stat2.close();
+	dbCon2.close();
+
+	stat.execute("delete from _" + this.getClusterName()
+		     + ".sl_registry where reg_key = 'logtrigger.buffer'");
+	stat.close();
+	dbCon.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("LogBuffering.prototype.runTest - complete");
+}
@@ -0,0 +1,65 @@
+/**
+ *
+ * This tests applying a SYNC group over several connections
+ * (apply_parallel_conns).
+ *
+ * Node 2 applies in parallel and forwards the set to node 3.  The
+ * SYNC transaction on node 2 is committed after the additional
+ * transactions, so node 3 must never copy a SYNC before its data is
+ * visible on node 2.  No prepared transactions may be left behind.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+ParallelApply=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests applying SYNC groups over several connections';
+}
+ParallelApply.prototype = new BasicTest();
+ParallelApply.prototype.constructor = ParallelApply;
+
+ParallelApply.prototype.runTest = function() {
+        this.coordinator.log("ParallelApply.prototype.runTest - begin");
+
+	this.testResults.newGroup("Parallel Apply");
+	this.setupReplication();
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		var confMap = this.getSlonConfFileMap(idx);
+		confMap.put('apply_parallel_conns','3');
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx,confMap);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+	this.subscribeSet(1,1,2,[3]);
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(10*1000);
+	populate.stop();
+	this.coordinator.join(populate);
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+	this.compareDb('db1','db3');
+
+	for(var idx=2; idx <= 3; idx++) {
+		var dbCon = this.coordinator.createJdbcConnection('db' + idx);
+		var stat = dbCon.createStatement();
+		var rs = stat.executeQuery("select count(*) from pg_catalog.pg_prepared_xacts "
+					   + "where database = current_database()");
+		rs.next();
+		this.testResults.assertCheck('no prepared transactions left on db' + idx, rs.getInt(1), 0);
+		rs.close();
+		stat.close();
+		dbCon.close();
+	}
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("ParallelApply.prototype.runTest - complete");
+}
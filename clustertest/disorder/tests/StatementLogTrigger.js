@@ -0,0 +1,89 @@
+/**
+ *
+ * This tests the statement level log triggers (logtrigger.statement),
+ * which need PostgreSQL 10 or later.
+ *
+ * The tables are added to replication with statement level log
+ * triggers.  An additional statement trigger, which fires before the
+ * log trigger, reads the same transition tables first, so the log
+ * trigger has to rewind them.  Set-based statements are run on the
+ * origin in addition to the normal load, some of them twice in one
+ * transaction.
+ *
+ */
+
+coordinator.includeFile('disorder/tests/BasicTest.js');
+
+StatementLogTrigger=function(coordinator,testResults) {
+	BasicTest.call(this,coordinator,testResults);
+	this.testDescription='Tests the statement level log triggers';
+}
+StatementLogTrigger.prototype = new BasicTest();
+StatementLogTrigger.prototype.constructor = StatementLogTrigger;
+
+StatementLogTrigger.prototype.runTest = function() {
+        this.coordinator.log("StatementLogTrigger.prototype.runTest - begin");
+
+	this.testResults.newGroup("Statement Log Trigger");
+	this.setupReplication();
+
+	var dbCon = this.coordinator.createJdbcConnection('db1');
+	var stat = dbCon.createStatement();
+	stat.execute("insert into _" + this.getClusterName()
+		     + ".sl_registry (reg_key, reg_int4) values ('logtrigger.statement', 1)");
+	stat.execute("create function disorder.read_transition() returns trigger "
+		     + "language plpgsql as $$ begin "
+		     + "perform count(*) from oldtab; perform count(*) from newtab; "
+		     + "return null; end; $$");
+	stat.execute("create trigger \"_0_read_transition\" after update on disorder.do_customer "
+		     + "referencing old table as oldtab new table as newtab "
+		     + "for each statement execute procedure disorder.read_transition()");
+
+	var slonArray=[];
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1] = this.coordinator.createSlonLauncher('db' + idx);
+		slonArray[idx-1].run();
+	}
+	this.addTables();
+	this.subscribeSet(1,1,1,[2]);
+
+	var rs = stat.executeQuery("select count(*) from pg_catalog.pg_trigger "
+				   + "where tgrelid = 'disorder.do_customer'::regclass "
+				   + "and tgname like '%logtrigger_upd'");
+	rs.next();
+	this.testResults.assertCheck('statement level log trigger created', rs.getInt(1), 1);
+	rs.close();
+
+	var populate=this.generateLoad();
+	java.lang.Thread.sleep(10*1000);
+
+	dbCon.setAutoCommit(false);
+	stat.execute("update disorder.do_customer set c_name = c_name || ' stmt'");
+	stat.execute("update disorder.do_customer set c_name = c_name || ' again'");
+	dbCon.commit();
+	stat.execute("insert into disorder.do_customer (c_name) "
+		     + "select 'stmt ' || i from generate_series(1, 1000) as i");
+	dbCon.commit();
+	stat.execute("delete from disorder.do_customer where c_name like 'stmt %'");
+	dbCon.commit();
+	dbCon.setAutoCommit(true);
+
+	populate.stop();
+	this.coordinator.join(populate);
+
+	this.slonikSync(1,1);
+	this.compareDb('db1','db2');
+
+	stat.execute("drop trigger \"_0_read_transition\" on disorder.do_customer");
+	stat.execute("drop function disorder.read_transition()");
+	stat.execute("delete from _" + this.getClusterName()
+		     + ".sl_registry where reg_key = 'logtrigger.statement'");
+	stat.close();
+	dbCon.close();
+
+	for(var idx=1; idx <= this.getNodeCount(); idx++) {
+		slonArray[idx-1].stop();
+		this.coordinator.join(slonArray[idx-1]);
+	}
+        this.coordinator.log("StatementLogTrigger.prototype.runTest - complete");
+}
@@ -31,6 +31,15 @@ coordinator.includeFile('disorder/tests/Resubscribe.js');
 coordinator.includeFile('disorder/tests/SiteFailover.js');
 coordinator.includeFile('disorder/tests/DropNode.js');
 coordinator.includeFile('disorder/tests/CleanupInterval.js');
+coordinator.includeFile('disorder/tests/BinaryLogFormat.js');
+coordinator.includeFile('disorder/tests/LogBuffering.js');
+coordinator.includeFile('disorder/tests/StatementLogTrigger.js');
+coordinator.includeFile('disorder/tests/ColumnProjection.js');
+coordinator.includeFile('disorder/tests/ApplyBatch.js');
+coordinator.includeFile('disorder/tests/ParallelApply.js');
+coordinator.includeFile('disorder/tests/ActionseqRanges.js');
+coordinator.includeFile('disorder/tests/CoalesceLogging.js');
+coordinator.includeFile('disorder/tests/FilteredTable.js');
 
 var tests = 
     [new EmptySet(coordinator,results)
@@ -63,6 +72,15 @@ var tests =
 	 ,new SiteFailover(coordinator,results)
 	 ,new DropNode(coordinator,results)
 	 ,new CleanupInterval(coordinator,results)
+	 ,new BinaryLogFormat(coordinator,results)
+	 ,new LogBuffering(coordinator,results)
+	 ,new StatementLogTrigger(coordinator,results)
+	 ,new ColumnProjection(coordinator,results)
+	 ,new ApplyBatch(coordinator,results)
+	 ,new ParallelApply(coordinator,results)
+	 ,new ActionseqRanges(coordinator,results)
+	 ,new CoalesceLogging(coordinator,results)
+	 ,new FilteredTable(coordinator,results)
 	 //Below tests are known to fail.
 	 //,new UnsubscribeBeforeEnable(coordinator,results)
      //,new DropSet(coordinator,results) //fails bug 133
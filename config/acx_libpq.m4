@@ -580,6 +580,30 @@ if test "$ac_cv_LookupExplicitNamespace_args" = 2; then
    AC_DEFINE(HAS_LOOKUPEXPLICITNAMESPACE_2)
 fi
 
+AC_MSG_CHECKING(for syscache callbacks taking a hash value)
+AC_EGREP_HEADER([int cacheid, uint32 hashvalue],
+	utils/inval.h,
+	[AC_MSG_RESULT(yes)
+	AC_DEFINE(HAVE_SYSCACHECALLBACK_HASHVALUE)],
+	AC_MSG_RESULT(no)
+)
+
+AC_MSG_CHECKING(for XACT_EVENT_PRE_COMMIT)
+AC_EGREP_HEADER(XACT_EVENT_PRE_COMMIT,
+	access/xact.h,
+	[AC_MSG_RESULT(yes)
+	AC_DEFINE(HAVE_XACT_EVENT_PRE_COMMIT)],
+	AC_MSG_RESULT(no)
+)
+
+AC_MSG_CHECKING(for transition tables in TriggerData)
+AC_EGREP_HEADER(tg_newtable,
+	commands/trigger.h,
+	[AC_MSG_RESULT(yes)
+	AC_DEFINE(HAVE_TRANSITION_TABLES)],
+	AC_MSG_RESULT(no)
+)
+
 AC_LANG_RESTORE
 ])dnl ACX_LIBPQ
 
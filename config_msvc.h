@@ -49,4 +49,16 @@
 #error "Postgresql 8.3 or higher is required"
 #endif
 
+#if PG_VERSION_NUM >= 90300
+#define HAVE_XACT_EVENT_PRE_COMMIT 1
+#endif
+
+#if PG_VERSION_NUM >= 100000
+#define HAVE_TRANSITION_TABLES 1
+#endif
+
+#if PG_VERSION_NUM >= 90200
+#define HAVE_SYSCACHECALLBACK_HASHVALUE 1
+#endif
+
 #endif /* SLONY_I_CONFIG_H */
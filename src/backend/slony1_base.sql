@@ -111,6 +111,9 @@ create table @NAMESPACE@.sl_table (
 	tab_idxname			name NOT NULL,
 	tab_altered			boolean NOT NULL,
 	tab_comment			text,
+	tab_columns			text[],
+	tab_filter			text,
+	tab_coalesce		boolean default false,
 
 	CONSTRAINT "sl_table-pkey"
 		PRIMARY KEY (tab_id),
@@ -127,6 +130,9 @@ comment on column @NAMESPACE@.sl_table.tab_set is 'ID of the replication set the
 comment on column @NAMESPACE@.sl_table.tab_idxname is 'The name of the primary index of the table';
 comment on column @NAMESPACE@.sl_table.tab_altered is 'Has the table been modified for replication?';
 comment on column @NAMESPACE@.sl_table.tab_comment is 'Human-oriented description of the table';
+comment on column @NAMESPACE@.sl_table.tab_columns is 'Names of the columns that are replicated, including the key columns. NULL means all columns';
+comment on column @NAMESPACE@.sl_table.tab_filter is 'Boolean expression over the columns of the table. If not NULL, only rows for which it is true are replicated';
+comment on column @NAMESPACE@.sl_table.tab_coalesce is 'If true, the log trigger logs only the net change of each row at the end of the transaction';
 
 
 -- ----------------------------------------------------------------------
@@ -374,7 +380,9 @@ create table @NAMESPACE@.sl_log_1 (
 	log_tablerelname	text,
 	log_cmdtype			"char",
 	log_cmdupdncols		int4,
-	log_cmdargs			text[]
+	log_cmdargs			text[],
+	log_cmdformat		int4,
+	log_cmdbinargs		bytea[]
 ) WITHOUT OIDS;
 create index sl_log_1_idx1 on @NAMESPACE@.sl_log_1
 	(log_origin, log_txid, log_actionseq);
@@ -392,7 +400,9 @@ comment on column @NAMESPACE@.sl_log_1.log_tablenspname is 'The schema name of t
 comment on column @NAMESPACE@.sl_log_1.log_tablerelname is 'The table name of the table affected';
 comment on column @NAMESPACE@.sl_log_1.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE';
 comment on column @NAMESPACE@.sl_log_1.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs';
-comment on column @NAMESPACE@.sl_log_1.log_cmdargs is 'The data needed to perform the log action on the replica';
+comment on column @NAMESPACE@.sl_log_1.log_cmdargs is 'The data needed to perform the log action on the replica. For log_cmdformat=2 values captured in binary are NULL here, use logCmdArgsText() to get them as text';
+comment on column @NAMESPACE@.sl_log_1.log_cmdformat is 'NULL or 1 = all values are text in log_cmdargs, 2 = some values are in log_cmdbinargs';
+comment on column @NAMESPACE@.sl_log_1.log_cmdbinargs is 'For log_cmdformat=2 one element per log_cmdargs name/value pair, holding the type OID and send/recv representation of values captured in binary';
 
 -- ----------------------------------------------------------------------
 -- TABLE sl_log_2
@@ -406,7 +416,9 @@ create table @NAMESPACE@.sl_log_2 (
 	log_tablerelname	text,
 	log_cmdtype			"char",
 	log_cmdupdncols		int4,
-	log_cmdargs			text[]
+	log_cmdargs			text[],
+	log_cmdformat		int4,
+	log_cmdbinargs		bytea[]
 ) WITHOUT OIDS;
 create index sl_log_2_idx1 on @NAMESPACE@.sl_log_2
 	(log_origin, log_txid, log_actionseq);
@@ -424,7 +436,9 @@ comment on column @NAMESPACE@.sl_log_2.log_tablenspname is 'The schema name of t
 comment on column @NAMESPACE@.sl_log_2.log_tablerelname is 'The table name of the table affected';
 comment on column @NAMESPACE@.sl_log_2.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE';
 comment on column @NAMESPACE@.sl_log_2.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs';
-comment on column @NAMESPACE@.sl_log_2.log_cmdargs is 'The data needed to perform the log action on the replica';
+comment on column @NAMESPACE@.sl_log_2.log_cmdargs is 'The data needed to perform the log action on the replica. For log_cmdformat=2 values captured in binary are NULL here, use logCmdArgsText() to get them as text';
+comment on column @NAMESPACE@.sl_log_2.log_cmdformat is 'NULL or 1 = all values are text in log_cmdargs, 2 = some values are in log_cmdbinargs';
+comment on column @NAMESPACE@.sl_log_2.log_cmdbinargs is 'For log_cmdformat=2 one element per log_cmdargs name/value pair, holding the type OID and send/recv representation of values captured in binary';
 
 -- ----------------------------------------------------------------------
 -- TABLE sl_log_script
@@ -479,7 +493,10 @@ create table @NAMESPACE@.sl_apply_stats (
 	as_cache_prepare	int8,
 	as_cache_hit		int8,
 	as_cache_evict		int8,
-	as_cache_prepare_max int8
+	as_cache_prepare_max int8,
+	as_cache_size		int4,
+	as_cache_resize		int8,
+	as_cache_evict_cost	int8
 ) WITHOUT OIDS;
 
 create index sl_apply_stats_idx1 on @NAMESPACE@.sl_apply_stats
@@ -498,6 +515,41 @@ comment on column @NAMESPACE@.sl_apply_stats.as_apply_first is 'Timestamp of fir
 comment on column @NAMESPACE@.sl_apply_stats.as_apply_last is 'Timestamp of most recent recorded SYNC';
 comment on column @NAMESPACE@.sl_apply_stats.as_cache_evict is 'Number of apply query cache evict operations';
 comment on column @NAMESPACE@.sl_apply_stats.as_cache_prepare_max is 'Maximum number of apply queries prepared in one SYNC group';
+comment on column @NAMESPACE@.sl_apply_stats.as_cache_size is 'Size of the apply query cache after the most recent SYNC';
+comment on column @NAMESPACE@.sl_apply_stats.as_cache_resize is 'Number of automatic apply query cache size changes';
+comment on column @NAMESPACE@.sl_apply_stats.as_cache_evict_cost is 'Number of evictions that kept the least recently used query because it was more expensive to prepare';
+
+
+-- ----------------------------------------------------------------------
+-- TABLE sl_apply_table_stats
+-- ----------------------------------------------------------------------
+create table @NAMESPACE@.sl_apply_table_stats (
+	ats_origin			int4,
+	ats_tableid			int4,
+	ats_num_insert		int8,
+	ats_num_update		int8,
+	ats_num_delete		int8,
+	ats_num_truncate	int8,
+	ats_duration		interval,
+	ats_max_latency		interval,
+	ats_apply_first		timestamptz,
+	ats_apply_last		timestamptz
+) WITHOUT OIDS;
+
+create index sl_apply_table_stats_idx1 on @NAMESPACE@.sl_apply_table_stats
+	(ats_origin, ats_tableid);
+
+comment on table @NAMESPACE@.sl_apply_table_stats is 'Local SYNC apply statistics per table (running totals)';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_origin is 'Origin of the SYNCs';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_tableid is 'The table ID (from sl_table.tab_id) the statistics are for';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_num_insert is 'Number of INSERT operations performed';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_num_update is 'Number of UPDATE operations performed';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_num_delete is 'Number of DELETE operations performed';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_num_truncate is 'Number of TRUNCATE operations performed';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_duration is 'Time spent in the apply trigger for this table';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_max_latency is 'Longest single apply statement for this table';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_apply_first is 'Timestamp of first recorded SYNC';
+comment on column @NAMESPACE@.sl_apply_table_stats.ats_apply_last is 'Timestamp of most recent recorded SYNC';
 
 
 -- **********************************************************************
@@ -518,6 +570,28 @@ create view @NAMESPACE@.sl_seqlastvalue as
 			and PGC.oid = SQ.seq_reloid and PGN.oid = PGC.relnamespace;
 		
 
+-- ----------------------------------------------------------------------
+-- VIEW sl_apply_table_status
+-- ----------------------------------------------------------------------
+create view @NAMESPACE@.sl_apply_table_status as
+	select ATS.ats_origin, ATS.ats_tableid,
+			"pg_catalog".quote_ident(T.tab_nspname) || '.' ||
+			"pg_catalog".quote_ident(T.tab_relname) as ats_tab_fqname,
+			ATS.ats_num_insert, ATS.ats_num_update,
+			ATS.ats_num_delete, ATS.ats_num_truncate,
+			ATS.ats_num_insert + ATS.ats_num_update +
+			ATS.ats_num_delete + ATS.ats_num_truncate as ats_num_total,
+			ATS.ats_duration,
+			ATS.ats_duration / "pg_catalog".greatest(ATS.ats_num_insert +
+				ATS.ats_num_update + ATS.ats_num_delete +
+				ATS.ats_num_truncate, 1) as ats_avg_latency,
+			ATS.ats_max_latency,
+			ATS.ats_apply_first, ATS.ats_apply_last
+		from @NAMESPACE@.sl_apply_table_stats ATS
+			left join @NAMESPACE@.sl_table T on T.tab_id = ATS.ats_tableid;
+
+comment on view @NAMESPACE@.sl_apply_table_status is 'Per table apply statistics with the table name and the average time per operation';
+
 create view @NAMESPACE@.sl_failover_targets as
 select  set_id,
 	set_origin as set_origin,
@@ -18,21 +18,28 @@
 #endif
 
 
-#include "avl_tree.c"
 
 #include "miscadmin.h"
+#include "lib/stringinfo.h"
 #include "nodes/makefuncs.h"
 #include "parser/parse_type.h"
 #include "executor/spi.h"
+#include "executor/tuptable.h"
+#include "utils/tuplestore.h"
+#include "funcapi.h"
 #include "commands/trigger.h"
 #include "commands/async.h"
+#include "commands/sequence.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
 #include "catalog/namespace.h"
 #include "access/xact.h"
 #include "access/transam.h"
 #include "access/hash.h"
+#include "access/tupmacs.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/elog.h"
 #include "utils/guc.h"
 #include "utils/rel.h"
@@ -40,6 +47,8 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
 #include "utils/timestamp.h"
 #include "utils/int8.h"
 #ifdef HAVE_GETACTIVESNAPSHOT
@@ -51,6 +60,7 @@
 #include "parser/parse_oper.h"
 #endif
 #include "mb/pg_wchar.h"
+#include "portability/instr_time.h"
 
 #include <signal.h>
 #include <errno.h>
@@ -73,10 +83,21 @@ PG_FUNCTION_INFO_V1(versionFunc(getLocalNodeId));
 PG_FUNCTION_INFO_V1(versionFunc(getModuleVersion));
 
 PG_FUNCTION_INFO_V1(versionFunc(logTrigger));
+PG_FUNCTION_INFO_V1(versionFunc(logTriggerStmt));
 PG_FUNCTION_INFO_V1(versionFunc(denyAccess));
 PG_FUNCTION_INFO_V1(versionFunc(logApply));
 PG_FUNCTION_INFO_V1(versionFunc(logApplySetCacheSize));
+PG_FUNCTION_INFO_V1(versionFunc(logApplySetCacheMaxSize));
 PG_FUNCTION_INFO_V1(versionFunc(logApplySaveStats));
+PG_FUNCTION_INFO_V1(versionFunc(logApplySaveTableStats));
+PG_FUNCTION_INFO_V1(versionFunc(logApplySetBatchSize));
+PG_FUNCTION_INFO_V1(versionFunc(logApplySetInsertBatchSize));
+PG_FUNCTION_INFO_V1(versionFunc(logApplyFlush));
+PG_FUNCTION_INFO_V1(versionFunc(logCmdArgsText));
+PG_FUNCTION_INFO_V1(versionFunc(logActionseqInRanges));
+PG_FUNCTION_INFO_V1(versionFunc(logSyncRows));
+PG_FUNCTION_INFO_V1(versionFunc(logCoalesceFlush));
+PG_FUNCTION_INFO_V1(versionFunc(logCoalesceTruncate));
 PG_FUNCTION_INFO_V1(versionFunc(lockedSet));
 PG_FUNCTION_INFO_V1(versionFunc(killBackend));
 PG_FUNCTION_INFO_V1(versionFunc(seqtrack));
@@ -92,10 +113,21 @@ Datum		versionFunc(getLocalNodeId) (PG_FUNCTION_ARGS);
 Datum		versionFunc(getModuleVersion) (PG_FUNCTION_ARGS);
 
 Datum		versionFunc(logTrigger) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logTriggerStmt) (PG_FUNCTION_ARGS);
 Datum		versionFunc(denyAccess) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApply) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApplySetCacheSize) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplySetCacheMaxSize) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApplySaveStats) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplySaveTableStats) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplySetBatchSize) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplySetInsertBatchSize) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplyFlush) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logCmdArgsText) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logActionseqInRanges) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logSyncRows) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logCoalesceFlush) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logCoalesceTruncate) (PG_FUNCTION_ARGS);
 Datum		versionFunc(lockedSet) (PG_FUNCTION_ARGS);
 Datum		versionFunc(killBackend) (PG_FUNCTION_ARGS);
 Datum		versionFunc(seqtrack) (PG_FUNCTION_ARGS);
@@ -121,6 +153,39 @@ extern DLLIMPORT Node *newNodeMacroHolder;
 #ifndef TEXTARRAYOID
 #define TEXTARRAYOID 1009
 #endif
+#ifndef BYTEAARRAYOID
+#define BYTEAARRAYOID 1001
+#endif
+#ifndef INT4ARRAYOID
+#define INT4ARRAYOID 1007
+#endif
+#ifndef INT8ARRAYOID
+#define INT8ARRAYOID 1016
+#endif
+#ifndef VARATT_IS_EXTERNAL_ONDISK
+#define VARATT_IS_EXTERNAL_ONDISK(PTR) VARATT_IS_EXTERNAL(PTR)
+#endif
+
+/*
+ * Values of sl_log_N.log_cmdformat. Rows in the text format leave the
+ * column NULL, like all rows written by earlier versions.
+ */
+#define SLON_LOGFORMAT_TEXT		1
+#define SLON_LOGFORMAT_BINARY	2
+
+/*
+ * Statement level capture reads the transition tables of the statement
+ * and writes the log rows through the log buffer.
+ */
+#if defined(HAVE_TRANSITION_TABLES) && defined(HAVE_XACT_EVENT_PRE_COMMIT)
+#define SLON_STMT_TRIGGER
+#endif
+
+/*
+ * Number of rows logTriggerStmt() collects before writing them into the
+ * log table when no transaction level log buffer is configured.
+ */
+#define LOG_STMT_FLUSH_ROWS		1024
 
 
 /* ----
@@ -136,43 +201,305 @@ typedef struct slony_I_cluster_status
 	int32		localNodeId;
 	TransactionId currentXid;
 	void	   *plan_active_log;
+	int32		log_format;
+	int32		log_buffer;
+	Oid			action_seq_oid;
 
 	int			have_plan;
 	void	   *plan_insert_event;
 	void	   *plan_insert_log_1;
 	void	   *plan_insert_log_2;
+	void	   *plan_buffer_log_1;
+	void	   *plan_buffer_log_2;
+	void	   *plan_buffer_batch_1;
+	void	   *plan_buffer_batch_2;
+	void	   *plan_active_buffer;
+	void	   *plan_active_batch;
 	void	   *plan_insert_log_script;
 	void	   *plan_record_sequences;
 	void	   *plan_get_logstatus;
 	void	   *plan_table_info;
+	void	   *plan_node_forwards;
 	void	   *plan_apply_stats_update;
 	void	   *plan_apply_stats_insert;
+	void	   *plan_apply_table_stats_update;
+	void	   *plan_apply_table_stats_insert;
+	void	   *plan_sync_rows_1;
+	void	   *plan_sync_rows_2;
 
 	text	   *cmdtype_I;
 	text	   *cmdtype_U;
 	text	   *cmdtype_D;
 	bool		event_txn;
 	bool		apply_init;
+	bool		apply_forwarder;
 	bool		log_init;
+	bool		seqtrack_seeded;
 	
 	struct slony_I_cluster_status *next;
 }	Slony_I_ClusterStatus;
 
 
-/*
- * Defining APPLY_CACHE_VERIFY causes the apply cache to store a second
- * copy of the query hash key and verify it when hash_search() reports "found".
- * The reason for doing this is that it is not entirely clear if using
- * a char pointer as the hash key works the way we are using it.
+/* ----
+ * LogTrigCacheEntry -
+ *
+ *	Everything logTrigger() needs to know about a replicated table that
+ *	does not change from row to row. Entries are keyed by the relation
+ *	and trigger OID, built on first use and thrown away by the relcache
+ *	invalidation callback whenever the table definition changes.
+ * ----
+ */
+typedef struct
+{
+	Oid			reloid;
+	Oid			tgoid;
+}	LogTrigCacheKey;
+
+typedef struct
+{
+	bool		isdropped;
+	bool		excluded;
+	bool		iskey;
+	bool		haveeq;
+	bool		sendbinary;
+	Oid			typid;
+	int16		typlen;
+	Datum		colname;
+	FmgrInfo	outfunc;
+	FmgrInfo	eqfunc;
+	FmgrInfo	sendfunc;
+}	LogTrigCacheAtt;
+
+typedef struct
+{
+	LogTrigCacheKey key;
+	bool		ready;
+	bool		valid;
+	MemoryContext mcxt;
+
+	Slony_I_ClusterStatus *cs;
+	int32		tab_id;
+	Datum		nspname;
+	Datum		relname;
+
+	int			natts;
+	LogTrigCacheAtt *atts;
+	bool		anyexcluded;
+	bool		anybinary;
+	bool		datestyle_any;
+	bool		datestyle_text;
+
+	void	   *filter_plan;
+	int			filter_nargs;
+	bool		coalesce;
+}	LogTrigCacheEntry;
+
+/* ----
+ * LogTrigArgs -
+ *
+ *	The log_cmdargs and log_cmdbinargs arrays of a log row under
+ *	construction.
+ * ----
+ */
+typedef struct
+{
+	bool		binary;
+	int			nargs;
+	Datum	   *args;
+	bool	   *argnulls;
+	Datum	   *binargs;
+	bool	   *binnulls;
+	int32		cmdupdncols;
+}	LogTrigArgs;
+
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+/* ----
+ * LogBufferRow -
+ *
+ *	A log row captured by logTrigger() while log buffering is enabled.
+ *	The rows are kept in a memory context below TopTransactionContext
+ *	and written into the active log table LOG_BUFFER_BATCH rows at a
+ *	time when the buffer is full and right before commit. Each row
+ *	gets its log_actionseq when it is captured, so the flush does not
+ *	change the order in which the subscribers apply the rows.
+ * ----
+ */
+#define LOG_BUFFER_NPARAMS	9
+#define LOG_BUFFER_BATCH	32
+
+typedef struct
+{
+	SubTransactionId subid;
+	Datum		values[LOG_BUFFER_NPARAMS];
+	char		nulls[LOG_BUFFER_NPARAMS];
+}	LogBufferRow;
+
+static MemoryContext logBufferContext = NULL;
+static LogBufferRow *logBuffer = NULL;
+static int	logBufferSize = 0;
+static int	logBufferUsed = 0;
+static Slony_I_ClusterStatus *logBufferCS = NULL;
+static bool logBufferCallbacks = false;
+
+/* ----
+ * Coalesced rows -
+ *
+ *	For tables with sl_table.tab_coalesce set the log triggers do not
+ *	log every change right away. Instead they keep the net effect of
+ *	the transaction on each row, identified by the binary image of
+ *	its key columns, and log one INSERT, UPDATE or DELETE per row
+ *	right before commit. Every row has a stack of versions, one per
+ *	subtransaction that changed it, so that rolling back a
+ *	subtransaction restores what its parent had.
+ * ----
+ */
+typedef struct CoalesceTable
+{
+	Oid			reloid;
+	Oid			tgoid;
+	char	  **tgargs;
+	TupleDesc	tupdesc;
+	struct CoalesceTable *next;
+}	CoalesceTable;
+
+typedef struct CoalesceVersion
+{
+	SubTransactionId subid;
+	bool		existed;		/* row existed before the transaction */
+	HeapTuple	orig;			/* ... and this is what it looked like */
+	HeapTuple	cur;			/* current row or NULL if deleted */
+	struct CoalesceVersion *prev;
+}	CoalesceVersion;
+
+typedef struct CoalesceRow
+{
+	CoalesceTable *tbl;
+	char	   *keydata;
+	int			keylen;
+	CoalesceVersion *top;
+	struct CoalesceRow *chain;	/* same hash key */
+	struct CoalesceRow *next;	/* in order of first change */
+}	CoalesceRow;
+
+typedef struct
+{
+	Oid			reloid;
+	uint32		hashval;
+}	CoalesceKey;
+
+typedef struct
+{
+	CoalesceKey key;
+	CoalesceRow *rows;
+}	CoalesceHashEntry;
+
+static MemoryContext coalesceContext = NULL;
+static HTAB *coalesceHash = NULL;
+static CoalesceTable *coalesceTables = NULL;
+static CoalesceRow *coalesceFirst = NULL;
+static CoalesceRow *coalesceLast = NULL;
+static SubTransactionId coalesceMaxSubid = InvalidSubTransactionId;
+
+static void logTrigCallbacksInit(void);
+static void logTrigBufferRow(Slony_I_ClusterStatus * cs,
+				 LogTrigCacheEntry * entry, text *cmdtype,
+				 LogTrigArgs * la, int flush_rows);
+static void logTrigBufferFlush(void);
+static void logTrigCoalesceRow(LogTrigCacheEntry * entry, TriggerData *tg,
+				   char cmdtype, HeapTuple old_row, HeapTuple new_row,
+				   TupleDesc tupdesc);
+static CoalesceRow *logTrigCoalesceFind(LogTrigCacheEntry * entry,
+					CoalesceTable * tbl, HeapTuple row,
+					TupleDesc tupdesc);
+static void logTrigCoalesceSet(CoalesceRow * crow, bool existed,
+				   HeapTuple orig, HeapTuple cur);
+static bool logTrigCoalesceSafe(void);
+static void logTrigCoalesceEmit(void);
+static void logTrigCoalesceReset(void);
+static void logTrigBufferXactCallback(XactEvent event, void *arg);
+static void logTrigBufferSubXactCallback(SubXactEvent event,
+							 SubTransactionId mySubid,
+							 SubTransactionId parentSubid, void *arg);
+static void *prepareLogBufferPlan(Slony_I_ClusterStatus * cs, int log_no,
+					 int nrows);
+#endif   /* HAVE_XACT_EVENT_PRE_COMMIT */
+
+static HTAB *logTrigCacheHash = NULL;
+static bool logTrigCacheStale = false;
+
+static LogTrigCacheEntry *logTrigCacheLookup(TriggerData *tg);
+static void logTrigCacheBuild(LogTrigCacheEntry * entry, TriggerData *tg);
+static void logTrigCacheRelease(LogTrigCacheEntry * entry);
+static void logTrigCacheFlush(void);
+static char logTrigFilterCmd(LogTrigCacheEntry * entry, char cmdtype,
+				 HeapTuple old_row, HeapTuple new_row, TupleDesc tupdesc);
+static bool logTrigFilterRow(LogTrigCacheEntry * entry, HeapTuple row,
+				 TupleDesc tupdesc);
+static void logTrigInitXact(Slony_I_ClusterStatus * cs);
+#ifdef SLON_STMT_TRIGGER
+static void logTrigStmtRewind(Tuplestorestate *tupstore);
+#endif
+static text *logTrigBuildRow(Slony_I_ClusterStatus * cs,
+				LogTrigCacheEntry * entry, char cmdtype,
+				HeapTuple old_row, HeapTuple new_row,
+				TupleDesc tupdesc, LogTrigArgs * la);
+static text *logTrigFormatRow(Slony_I_ClusterStatus * cs,
+				 LogTrigCacheEntry * entry, char cmdtype,
+				 HeapTuple old_row, HeapTuple new_row,
+				 TupleDesc tupdesc, LogTrigArgs * la);
+static void logTrigInsertRow(Slony_I_ClusterStatus * cs,
+				 LogTrigCacheEntry * entry, text *cmdtype,
+				 LogTrigArgs * la);
+static void logTrigRowValues(Slony_I_ClusterStatus * cs,
+				 LogTrigCacheEntry * entry, text *cmdtype,
+				 LogTrigArgs * la, Datum *values, char *nulls);
+static void logTrigArgsInit(LogTrigArgs * la, int maxpairs, bool binary);
+static void logTrigArgsAdd(LogTrigArgs * la, LogTrigCacheAtt * att,
+			   Datum value, bool isnull);
+static Datum logTrigBinaryValue(LogTrigCacheAtt * att, Datum value);
+static bool slon_binary_type(Oid typid);
+static bool slon_datestyle_type(Oid typid);
+static bool logTrigSameVarlena(Datum old_value, Datum new_value);
+static void logTrigCacheRelCallback(Datum arg, Oid relid);
+#ifdef HAVE_SYSCACHECALLBACK_HASHVALUE
+static void logTrigCacheNspCallback(Datum arg, int cacheid, uint32 hashvalue);
+#else
+static void logTrigCacheNspCallback(Datum arg, int cacheid,
+						ItemPointer tuplePtr);
+#endif
+
+
+/* ----
+ * ApplyCacheKey -
+ *
+ *	The apply cache is keyed by the table ID and the command type, plus
+ *	the names of the updated columns for an UPDATE. The column names
+ *	are not copied for a lookup. colnames points into the log_cmdargs
+ *	of the row being applied, where they are at every second position,
+ *	and only the hash over them is part of the fixed size hash key.
+ *	Entries keep their own copy of the names in the same layout.
+ * ----
  */
-#define APPLY_CACHE_VERIFY
+typedef struct
+{
+	int32		tableid;
+	int32		ncols;
+	uint32		colhash;
+	char		cmdtype;
+	Datum	   *colnames;
+}	ApplyCacheKey;
 
 typedef struct apply_cache_entry
 {
-	char	   *queryKey;
+	ApplyCacheKey key;
 
 	void	   *plan;
+	int64		prepcost;		/* microseconds it took to prepare */
+	bool		ready;
+	bool		valid;
+	Oid			reloid;
 	bool		forward;
+	TransactionId forwardXid;
 	struct apply_cache_entry *prev;
 	struct apply_cache_entry *next;
 
@@ -180,10 +507,25 @@ typedef struct apply_cache_entry
 	Oid		   *typioparam;
 	int32	   *typmod;
 
-#ifdef APPLY_CACHE_VERIFY
-	char	   *verifyKey;
-	int			evicted;
-#endif
+	/*
+	 * Column types and the lazily looked up receive functions used for
+	 * values captured in the binary log format.
+	 */
+	Oid		   *coltype;
+	bool	   *have_recv;
+	FmgrInfo   *finfo_recv;
+	Oid		   *typioparam_recv;
+
+	/*
+	 * The set-based form of the query used by batch apply. batchQuery is
+	 * NULL if the query cannot be batched.
+	 */
+	int			nvals;
+	char	   *batchQuery;
+	void	   *batchPlan;
+	int16	   *typlen;
+	bool	   *typbyval;
+	char	   *typalign;
 }	ApplyCacheEntry;
 
 
@@ -193,9 +535,104 @@ static ApplyCacheEntry *applyCacheHead = NULL;
 static ApplyCacheEntry *applyCacheTail = NULL;
 static int	applyCacheSize = 100;
 static int	applyCacheUsed = 0;
+static bool applyCacheValid = false;
+static bool applyCacheStale = false;
+
+/* ----
+ * Adaptive cache size -
+ *
+ *	With a maximum size above the configured one, the cache grows by
+ *	half when more than 1 in APPLY_CACHE_EVICT_RATE lookups since the
+ *	last adjustment had to evict, and shrinks back towards the
+ *	configured size when less than half of it is used. Eviction picks
+ *	the entry cheapest to prepare again among the
+ *	APPLY_CACHE_EVICT_CANDIDATES least recently used ones.
+ * ----
+ */
+#define APPLY_CACHE_ADAPT_LOOKUPS		1000
+#define APPLY_CACHE_EVICT_RATE			20
+#define APPLY_CACHE_EVICT_CANDIDATES	4
+
+static int	applyCacheSizeBase = 100;
+static int	applyCacheSizeMax = 0;
+static int64 applyAdaptLookups = 0;
+static int64 applyAdaptEvicts = 0;
+
+/* ----
+ * Batch apply -
+ *
+ *	With a batch size greater than 1, logApply() collects consecutive
+ *	rows that use the same apply query and applies them with one
+ *	set-based statement taking an array per column. The batch is
+ *	applied when a row needs a different query, when it is full and
+ *	by logApplyFlush() at the end of the statement that inserted the
+ *	log rows, so the order of changes across tables is kept and any
+ *	triggers queued by the batch fire like for single rows. An UPDATE
+ *	batch never holds the same key twice; the key hashes of an UPDATE
+ *	batch are kept in a small open addressing hash table.
+ *
+ *	While a subscriber catches up, slon can allow longer runs of
+ *	INSERTs, which is what most of a large backlog consists of.
+ * ----
+ */
+static int	applyBatchSize = 0;
+static int	applyInsertBatchSize = 0;
+static MemoryContext applyBatchContext = NULL;
+static ApplyCacheEntry *applyBatchEnt = NULL;
+static int	applyBatchUsed = 0;
+static bool applyBatchBinary = false;
+static Datum *applyBatchValues = NULL;
+static bool *applyBatchNulls = NULL;
+static uint32 *applyBatchKeys = NULL;
+static bool *applyBatchKeyUsed = NULL;
+static uint32 applyBatchKeyMask = 0;
+
+/* ----
+ * ApplyLogAttnums -
+ *
+ *	The attribute numbers of the columns of a log table that logApply()
+ *	reads, so that they are not looked up by name for every row. There
+ *	is one slot for each of sl_log_1 and sl_log_2.
+ * ----
+ */
+typedef struct
+{
+	Oid			reloid;
+	int			log_origin;
+	int			log_txid;
+	int			log_tableid;
+	int			log_actionseq;
+	int			log_tablenspname;
+	int			log_tablerelname;
+	int			log_cmdtype;
+	int			log_cmdupdncols;
+	int			log_cmdformat;
+	int			log_cmdargs;
+	int			log_cmdbinargs;
+}	ApplyLogAttnums;
+
+static ApplyLogAttnums applyLogAttnums[2];
+static int	applyLogAttnumsNext = 0;
 
 static uint32 applyCache_hash(const void *kp, Size ksize);
 static int	applyCache_cmp(const void *kp1, const void *kp2, Size ksize);
+static ApplyLogAttnums *applyLogAttnumsGet(Relation rel);
+static void applyBatchPrepare(ApplyCacheEntry * cacheEnt, char cmdtype,
+				  char *nspname, char *relname, Datum *cmdargs,
+				  int cmdargsn, int cmdupdncols);
+static int	applyBatchLimit(ApplyCacheEntry * cacheEnt);
+static void applyBatchAdd(ApplyCacheEntry * cacheEnt, Datum *queryvals,
+			  char *querynulls, bool binary, uint32 keyhash);
+static bool applyBatchKeyFind(uint32 keyhash, bool enter);
+static void applyBatchFlush(void);
+static bool applyBatchUpdateOk(Oid reloid, char **keynames, int nkeys);
+static void applyBatchReset(void);
+static void applyCacheReset(void);
+static void applyCacheRemove(ApplyCacheEntry * cacheEnt);
+static void applyCacheRelease(ApplyCacheEntry * cacheEnt);
+static void applyCacheEvict(void);
+static void applyCacheAdapt(void);
+static void applyCacheRelCallback(Datum arg, Oid relid);
 
 static char *applyQuery = NULL;
 static char *applyQueryPos = NULL;
@@ -203,6 +640,10 @@ static int	applyQuerySize = 8192;
 
 static void applyQueryReset(void);
 static void applyQueryIncrease(void);
+static Datum applyBinaryValue(ApplyCacheEntry * cacheEnt, int idx,
+				 Datum binval);
+static Oid	slon_binary_header(Datum binval, StringInfo buf);
+static char *slon_binary_to_cstring(Datum binval);
 
 static int64 apply_num_insert;
 static int64 apply_num_update;
@@ -212,6 +653,42 @@ static int64 apply_num_script;
 static int64 apply_num_prepare;
 static int64 apply_num_hit;
 static int64 apply_num_evict;
+static int64 apply_num_evict_cost;
+static int64 apply_num_resize;
+
+/* ----
+ * ApplyTableStats -
+ *
+ *	Per table apply counters of the current transaction, saved into
+ *	sl_apply_table_stats by logApplySaveStats(). Times are in
+ *	microseconds. A batch adds its statement time when it is applied.
+ * ----
+ */
+typedef struct
+{
+	int32		tableid;
+	int64		num_insert;
+	int64		num_update;
+	int64		num_delete;
+	int64		num_truncate;
+	int64		apply_time;
+	int64		max_latency;
+}	ApplyTableStats;
+
+static HTAB *applyTableStatsHash = NULL;
+
+static void applyTableStatsAdd(int32 tableid, char cmdtype,
+				   instr_time *start);
+static void applyTableStatsSave(Slony_I_ClusterStatus * cs, int32 origin);
+static void applyTableStatsReset(void);
+
+/*
+ * Number of log rows logSyncRows() fetches from its cursor at a time.
+ */
+#define SYNC_ROWS_FETCH		1000
+
+static void *syncRowsPlan(Slony_I_ClusterStatus * cs, FunctionCallInfo fcinfo,
+			 int sl_log_no);
 
 
 /*@null@*/
@@ -222,6 +699,7 @@ getClusterStatus(Name cluster_name,
 static const char *slon_quote_identifier(const char *ident);
 static int prepareLogPlan(Slony_I_ClusterStatus * cs,
 			   int log_status);
+static void seqtrackSeed(Slony_I_ClusterStatus * cs);
 
 Datum
 versionFunc(createEvent) (PG_FUNCTION_ARGS)
@@ -318,6 +796,7 @@ versionFunc(createEvent) (PG_FUNCTION_ARGS)
 		if (strcmp(ev_type_c, "SYNC") == 0 ||
 			strcmp(ev_type_c, "ENABLE_SUBSCRIPTION") == 0)
 		{
+			seqtrackSeed(cs);
 /*@-nullpass@*/
 			if ((rc = SPI_execp(cs->plan_record_sequences, NULL, NULL, 0)) < 0)
 				elog(ERROR, "Slony-I: SPI_execp() failed for \"INSERT INTO sl_seqlog ...\"");
@@ -384,25 +863,15 @@ versionFunc(getModuleVersion) (PG_FUNCTION_ARGS)
 Datum
 versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 {
-	TransactionId newXid = GetTopTransactionId();
 	Slony_I_ClusterStatus *cs;
+	LogTrigCacheEntry *entry;
 	TriggerData *tg;
-	Datum		log_param[6];
 	text	   *cmdtype = NULL;
-	int32		cmdupdncols = 0;
+	HeapTuple	old_row = NULL;
+	HeapTuple	new_row = NULL;
+	char		event;
+	LogTrigArgs la;
 	int			rc;
-	Name		cluster_name;
-	int32		tab_id;
-	char	   *attkind;
-	int			attkind_idx;
-
-	char	   *olddatestyle = NULL;
-	Datum	   *cmdargs = NULL;
-	Datum	   *cmdargselem = NULL;
-	bool	   *cmdnulls = NULL;
-	bool	   *cmdnullselem = NULL;
-	int			cmddims[1];
-	int			cmdlbs[1];
 
 	/*
 	 * Don't do any logging if the current session role isn't Origin.
@@ -434,1731 +903,5047 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 		elog(ERROR, "Slony-I: SPI_connect() failed in logTrigger()");
 
 	/*
-	 * Get all the trigger arguments
+	 * Get the cached per table information. This also holds the cluster
+	 * status information with the SPI plans that we need here, so the
+	 * trigger arguments only need to be decoded when the entry is built.
 	 */
-	cluster_name = DatumGetName(DirectFunctionCall1(namein,
-								CStringGetDatum(tg->tg_trigger->tgargs[0])));
-	tab_id = strtol(tg->tg_trigger->tgargs[1], NULL, 10);
-	attkind = tg->tg_trigger->tgargs[2];
+	entry = logTrigCacheLookup(tg);
+	cs = entry->cs;
 
-	/*
-	 * Get or create the cluster status information and make sure it has the
-	 * SPI plans that we need here.
-	 */
-	cs = getClusterStatus(cluster_name, PLAN_INSERT_LOG_STATUS);
+	logTrigInitXact(cs);
 
-	bool initRequired = false;
-	if(!TransactionIdEquals(cs->currentXid, newXid))
+	if (TRIGGER_FIRED_BY_INSERT(tg->tg_event))
 	{
-		initRequired = true;
-		cs->apply_init = false;
-		cs->event_txn=false;
-		cs->log_init = true;
+		event = 'I';
+		new_row = tg->tg_trigtuple;
 	}
-	else if (!cs->log_init)
+	else if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event))
 	{
-		initRequired = true;
+		event = 'U';
+		old_row = tg->tg_trigtuple;
+		new_row = tg->tg_newtuple;
 	}
-
-	if(cs->event_txn)
+	else if (TRIGGER_FIRED_BY_DELETE(tg->tg_event))
 	{
-		elog(ERROR,"Slony-I: log trigger called in an event transaction");
+		event = 'D';
+		old_row = tg->tg_trigtuple;
 	}
-	
+	else
+	{
+		elog(ERROR, "Slony-I: logTrigger() fired for unhandled event");
+		event = '\0';
+	}
+
 	/*
-	 * Do the following only once per transaction.
+	 * Apply the row filter of the table, if it has one.
 	 */
-	if (initRequired)
+	event = logTrigFilterCmd(entry, event, old_row, new_row,
+							 tg->tg_relation->rd_att);
+	if (event == '\0')
 	{
-		int32		log_status;
-		bool		isnull;
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
 
-		/*
-		 * Determine the currently active log table
-		 */
-		if (SPI_execp(cs->plan_get_logstatus, NULL, NULL, 0) < 0)
-			elog(ERROR, "Slony-I: cannot determine log status");
-		if (SPI_processed != 1)
-			elog(ERROR, "Slony-I: cannot determine log status");
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	/*
+	 * Changes to coalesced tables are logged at commit.
+	 */
+	if (entry->coalesce)
+	{
+		logTrigCoalesceRow(entry, tg, event, old_row, new_row,
+						   tg->tg_relation->rd_att);
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
+#endif
 
-		log_status = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
-										 SPI_tuptable->tupdesc, 1, &isnull));
-		SPI_freetuptable(SPI_tuptable);
-		prepareLogPlan(cs, log_status);
-		switch (log_status)
-		{
-			case 0:
-			case 2:
-				cs->plan_active_log = cs->plan_insert_log_1;
-				break;
+	/*
+	 * Determine cmdtype and cmdargs depending on the command type
+	 */
+	cmdtype = logTrigBuildRow(cs, entry, event, old_row, new_row,
+							  tg->tg_relation->rd_att, &la);
+	if (cmdtype == NULL)
+	{
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
 
-			case 1:
-			case 3:
-				cs->plan_active_log = cs->plan_insert_log_2;
-				break;
+	/*
+	 * Insert the log row, or add it to the log buffer.
+	 */
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	if (cs->log_buffer > 0)
+		logTrigBufferRow(cs, entry, cmdtype, &la, cs->log_buffer);
+	else
+#endif
+		logTrigInsertRow(cs, entry, cmdtype, &la);
 
-			default:
-				elog(ERROR, "Slony-I: illegal log status %d", log_status);
-				break;
-		}
+	SPI_finish();
+	return PointerGetDatum(NULL);
+}
 
-		cs->currentXid = newXid;
-		cs->event_txn = false;
-		cs->log_init = true;
-	}
 
+/*
+ * versionFunc(logTriggerStmt) -
+ *
+ *	Statement level variant of logTrigger(). It is installed as three
+ *	AFTER ... FOR EACH STATEMENT triggers with transition tables and
+ *	the same arguments as logTrigger(). All rows of the statement are
+ *	captured exactly like logTrigger() would, but written into the log
+ *	table with multi-row inserts.
+ */
+Datum
+versionFunc(logTriggerStmt) (PG_FUNCTION_ARGS)
+{
+#ifdef SLON_STMT_TRIGGER
+	Slony_I_ClusterStatus *cs;
+	LogTrigCacheEntry *entry;
+	TriggerData *tg;
+	TupleDesc	tupdesc;
+	TupleTableSlot *old_slot = NULL;
+	TupleTableSlot *new_slot = NULL;
+	MemoryContext rowContext;
+	MemoryContext oldContext;
+	text	   *cmdtype;
+	LogTrigArgs la;
+	char		event;
+	char		rowevent;
+	int			flush_rows;
+	int			rc;
 
 	/*
-	 * Save the current datestyle setting and switch to ISO (if not already)
+	 * Don't do any logging if the current session role isn't Origin.
 	 */
-#ifdef GETCONFIGOPTIONBYNAME_2
-	olddatestyle = GetConfigOptionByName("DateStyle", NULL);
-#elif defined (GETCONFIGOPTIONBYNAME_3)
-	olddatestyle = GetConfigOptionByName("DateStyle", NULL, false);
-#else
-#error "GETCONFIGOPTIONBYNAME_2 or GETCONFIGOPTIONBYNAME_3 must be defined"
-#endif
-	if (!strstr(olddatestyle, "ISO"))
-	{
-#ifdef SETCONFIGOPTION_6
-		set_config_option("DateStyle", "ISO", PGC_USERSET, PGC_S_SESSION,
-						  true, true);
-#elif defined(SETCONFIGOPTION_7)
-		set_config_option("DateStyle", "ISO", PGC_USERSET, PGC_S_SESSION,
-						  true, true, 0);
-#elif defined(SETCONFIGOPTION_8)
-		set_config_option("DateStyle", "ISO", PGC_USERSET, PGC_S_SESSION,
-						  true, true, 0, 0);
-#endif
-	}
+	if (SessionReplicationRole != SESSION_REPLICATION_ROLE_ORIGIN)
+		return PointerGetDatum(NULL);
 
+	/*
+	 * Get the trigger call context
+	 */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "Slony-I: logTriggerStmt() not called as trigger");
+	tg = (TriggerData *) (fcinfo->context);
 
 	/*
-	 * Determine cmdtype and cmdargs depending on the command type
+	 * Check all logTriggerStmt() calling conventions
 	 */
+	if (!TRIGGER_FIRED_AFTER(tg->tg_event))
+		elog(ERROR, "Slony-I: logTriggerStmt() must be fired AFTER");
+	if (TRIGGER_FIRED_FOR_ROW(tg->tg_event))
+		elog(ERROR, "Slony-I: logTriggerStmt() must be fired FOR EACH STATEMENT");
+	if (tg->tg_trigger->tgnargs != 3)
+		elog(ERROR, "Slony-I: logTriggerStmt() must be defined with 3 args");
+
 	if (TRIGGER_FIRED_BY_INSERT(tg->tg_event))
+		event = 'I';
+	else if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event))
+		event = 'U';
+	else if (TRIGGER_FIRED_BY_DELETE(tg->tg_event))
+		event = 'D';
+	else
 	{
-		HeapTuple	new_row = tg->tg_trigtuple;
-		TupleDesc	tupdesc = tg->tg_relation->rd_att;
-		char	   *col_value;
+		elog(ERROR, "Slony-I: logTriggerStmt() fired for unhandled event");
+		event = '\0';
+	}
 
-		int			i;
+	if ((event != 'I' && tg->tg_oldtable == NULL) ||
+		(event != 'D' && tg->tg_newtable == NULL))
+		elog(ERROR, "Slony-I: logTriggerStmt() must be defined with "
+			 "REFERENCING OLD TABLE and/or NEW TABLE");
 
-		/*
-		 * INSERT
-		 *
-		 * cmdtype = 'I' cmdargs = colname, newval [, ...]
-		 */
-		cmdtype = cs->cmdtype_I;
+	/*
+	 * Connect to the SPI manager
+	 */
+	if ((rc = SPI_connect()) < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logTriggerStmt()");
 
-		cmdargselem = cmdargs = (Datum *) palloc(sizeof(Datum) *
-								 ((tg->tg_relation->rd_att->natts * 2) + 2));
-		cmdnullselem = cmdnulls = (bool *) palloc(sizeof(bool) *
-								 ((tg->tg_relation->rd_att->natts * 2) + 2));
+	entry = logTrigCacheLookup(tg);
+	cs = entry->cs;
 
-		/*
-		 * Specify all the columns
-		 */
-		for (i = 0; i < tg->tg_relation->rd_att->natts; i++)
-		{
-			/*
-			 * Skip dropped columns
-			 */
-			if (tupdesc->attrs[i]->attisdropped)
-				continue;
+	logTrigInitXact(cs);
 
-			/*
-			 * Add the column name
-			 */
-			*cmdargselem++ = DirectFunctionCall1(textin,
-								 CStringGetDatum(SPI_fname(tupdesc, i + 1)));
-			*cmdnullselem++ = false;
+	/*
+	 * Without a transaction level log buffer we still collect the rows
+	 * of the statement, but write them out at the end of it.
+	 */
+	flush_rows = (cs->log_buffer > 0) ? cs->log_buffer : LOG_STMT_FLUSH_ROWS;
 
-			/*
-			 * Add the column value
-			 */
-			if ((col_value = SPI_getvalue(new_row, tupdesc, i + 1)) == NULL)
-			{
-				*cmdnullselem++ = true;
-				cmdargselem++;
-			}
-			else
+	tupdesc = tg->tg_relation->rd_att;
+	if (tg->tg_oldtable != NULL && event != 'I')
+	{
+		old_slot = MakeSingleTupleTableSlot(tupdesc);
+		logTrigStmtRewind(tg->tg_oldtable);
+	}
+	if (tg->tg_newtable != NULL && event != 'D')
+	{
+		new_slot = MakeSingleTupleTableSlot(tupdesc);
+		logTrigStmtRewind(tg->tg_newtable);
+	}
+
+	rowContext = AllocSetContextCreate(CurrentMemoryContext,
+									   "Slony-I logTriggerStmt row",
+									   ALLOCSET_DEFAULT_MINSIZE,
+									   ALLOCSET_DEFAULT_INITSIZE,
+									   ALLOCSET_DEFAULT_MAXSIZE);
+
+	/*
+	 * For an UPDATE the old and new transition tables hold the row
+	 * versions in the same order, so we can read them side by side.
+	 */
+	for (;;)
+	{
+		HeapTuple	old_row = NULL;
+		HeapTuple	new_row = NULL;
+
+		if (old_slot != NULL)
+		{
+			if (!tuplestore_gettupleslot(tg->tg_oldtable, true, false,
+										 old_slot))
+				break;
+			old_row = ExecFetchSlotTuple(old_slot);
+		}
+		if (new_slot != NULL)
+		{
+			if (!tuplestore_gettupleslot(tg->tg_newtable, true, false,
+										 new_slot))
 			{
-				*cmdargselem++ = DirectFunctionCall1(textin,
-												 CStringGetDatum(col_value));
-				*cmdnullselem++ = false;
+				if (old_slot != NULL)
+					elog(ERROR, "Slony-I: logTriggerStmt() transition "
+						 "tables have different sizes");
+				break;
 			}
+			new_row = ExecFetchSlotTuple(new_slot);
 		}
 
+		oldContext = MemoryContextSwitchTo(rowContext);
+		rowevent = logTrigFilterCmd(entry, event, old_row, new_row, tupdesc);
+		if (rowevent != '\0' && entry->coalesce)
+			logTrigCoalesceRow(entry, tg, rowevent, old_row, new_row,
+							   tupdesc);
+		else if (rowevent != '\0')
+		{
+			cmdtype = logTrigBuildRow(cs, entry, rowevent, old_row, new_row,
+									  tupdesc, &la);
+			if (cmdtype != NULL)
+				logTrigBufferRow(cs, entry, cmdtype, &la, flush_rows);
+		}
+		MemoryContextSwitchTo(oldContext);
+		MemoryContextReset(rowContext);
 	}
-	else if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event))
+
+	/*
+	 * Write out what is left unless the transaction level log buffer
+	 * takes care of it.
+	 */
+	if (cs->log_buffer == 0)
+		logTrigBufferFlush();
+
+	MemoryContextDelete(rowContext);
+	if (old_slot != NULL)
+		ExecDropSingleTupleTableSlot(old_slot);
+	if (new_slot != NULL)
+		ExecDropSingleTupleTableSlot(new_slot);
+
+	SPI_finish();
+#else
+	elog(ERROR, "Slony-I: logTriggerStmt() requires PostgreSQL 10 or later");
+#endif   /* SLON_STMT_TRIGGER */
+
+	return PointerGetDatum(NULL);
+}
+
+
+#ifdef SLON_STMT_TRIGGER
+/*
+ * logTrigStmtRewind -
+ *
+ *	Position a transition table at its start. Other AFTER triggers of
+ *	the statement may have read the table already. Queries reading it
+ *	through the trigger's ephemeral named relation allocate read
+ *	pointers of their own, so read pointer 0 is only used by us. It
+ *	was created together with the tuplestore, which the trigger code
+ *	does without random access and thus with EXEC_FLAG_REWIND, so it
+ *	can be rewound without allocating another read pointer for every
+ *	call.
+ */
+static void
+logTrigStmtRewind(Tuplestorestate *tupstore)
+{
+	tuplestore_select_read_pointer(tupstore, 0);
+	tuplestore_rescan(tupstore);
+}
+#endif   /* SLON_STMT_TRIGGER */
+
+
+/*
+ * logTrigInitXact -
+ *
+ *	Things the log triggers need to do once per transaction: make sure
+ *	we are not in an event transaction and find out which log table is
+ *	active and how log rows are captured.
+ */
+static void
+logTrigInitXact(Slony_I_ClusterStatus * cs)
+{
+	TransactionId newXid = GetTopTransactionId();
+	bool		initRequired = false;
+
+	if(!TransactionIdEquals(cs->currentXid, newXid))
+	{
+		initRequired = true;
+		cs->apply_init = false;
+		cs->event_txn=false;
+		cs->log_init = true;
+	}
+	else if (!cs->log_init)
 	{
-		HeapTuple	old_row = tg->tg_trigtuple;
-		HeapTuple	new_row = tg->tg_newtuple;
-		TupleDesc	tupdesc = tg->tg_relation->rd_att;
-		Datum		old_value;
-		Datum		new_value;
-		bool		old_isnull;
-		bool		new_isnull;
+		initRequired = true;
+	}
 
-		char	   *col_ident;
-		char	   *col_value;
-		int			i;
+	if(cs->event_txn)
+	{
+		elog(ERROR,"Slony-I: log trigger called in an event transaction");
+	}
+	
+	/*
+	 * Do the following only once per transaction.
+	 */
+	if (initRequired)
+	{
+		int32		log_status;
+		bool		isnull;
 
 		/*
-		 * UPDATE
-		 *
-		 * cmdtype = 'U' cmdargs = pkcolname, oldval [, ...] colname, newval
-		 * [, ...]
+		 * Determine the currently active log table
 		 */
-		cmdtype = cs->cmdtype_U;
+		if (SPI_execp(cs->plan_get_logstatus, NULL, NULL, 0) < 0)
+			elog(ERROR, "Slony-I: cannot determine log status");
+		if (SPI_processed != 1)
+			elog(ERROR, "Slony-I: cannot determine log status");
+
+		log_status = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										 SPI_tuptable->tupdesc, 1, &isnull));
 
-		cmdargselem = cmdargs = (Datum *) palloc(sizeof(Datum) *
-								 ((tg->tg_relation->rd_att->natts * 4) + 3));
-		cmdnullselem = cmdnulls = (bool *) palloc(sizeof(bool) *
-								 ((tg->tg_relation->rd_att->natts * 4) + 3));
+		/*
+		 * The same query tells us which capture format to use.
+		 */
+		cs->log_format = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										 SPI_tuptable->tupdesc, 2, &isnull));
+		if (isnull || cs->log_format != SLON_LOGFORMAT_BINARY)
+			cs->log_format = SLON_LOGFORMAT_TEXT;
 
 		/*
-		 * For all changed columns, add name+value pairs and count them.
+		 * ... and how many rows to buffer before writing them into the
+		 * log table. Zero means every row is inserted right away.
 		 */
-		for (i = 0; i < tg->tg_relation->rd_att->natts; i++)
+		cs->log_buffer = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										 SPI_tuptable->tupdesc, 3, &isnull));
+		if (isnull || cs->log_buffer < 0)
+			cs->log_buffer = 0;
+		SPI_freetuptable(SPI_tuptable);
+		prepareLogPlan(cs, log_status);
+		switch (log_status)
 		{
+			case 0:
+			case 2:
+				cs->plan_active_log = cs->plan_insert_log_1;
+				cs->plan_active_buffer = cs->plan_buffer_log_1;
+				cs->plan_active_batch = cs->plan_buffer_batch_1;
+				break;
+
+			case 1:
+			case 3:
+				cs->plan_active_log = cs->plan_insert_log_2;
+				cs->plan_active_buffer = cs->plan_buffer_log_2;
+				cs->plan_active_batch = cs->plan_buffer_batch_2;
+				break;
+
+			default:
+				elog(ERROR, "Slony-I: illegal log status %d", log_status);
+				break;
+		}
+
+		cs->currentXid = newXid;
+		cs->event_txn = false;
+		cs->log_init = true;
+	}
+}
+
+
+/*
+ * logTrigBuildRow -
+ *
+ *	Build the log_cmdargs (and log_cmdbinargs) of the log row for
+ *	one INSERT, UPDATE or DELETE and return the log_cmdtype text.
+ *	The old and new tuple are NULL where not applicable. NULL is
+ *	returned for an UPDATE that changed only columns that are not
+ *	replicated; nothing must be logged for it.
+ *
+ *	Date and time values are always captured in ISO format. If the
+ *	table has columns whose text output depends on the DateStyle, we
+ *	switch the DateStyle variable itself for the duration of the
+ *	call. Going through the GUC machinery for this on every row is
+ *	far too expensive.
+ */
+static text *
+logTrigBuildRow(Slony_I_ClusterStatus * cs, LogTrigCacheEntry * entry,
+				char cmdtype, HeapTuple old_row, HeapTuple new_row,
+				TupleDesc tupdesc, LogTrigArgs * la)
+{
+	int			save_datestyle = DateStyle;
+	bool		need_iso;
+	text	   *result = NULL;
+
+	if (cs->log_format == SLON_LOGFORMAT_BINARY && entry->anybinary)
+		need_iso = entry->datestyle_text;
+	else
+		need_iso = entry->datestyle_any;
+
+	if (!need_iso || DateStyle == USE_ISO_DATES)
+		return logTrigFormatRow(cs, entry, cmdtype, old_row, new_row,
+								tupdesc, la);
+
+	DateStyle = USE_ISO_DATES;
+	PG_TRY();
+	{
+		result = logTrigFormatRow(cs, entry, cmdtype, old_row, new_row,
+								  tupdesc, la);
+	}
+	PG_CATCH();
+	{
+		DateStyle = save_datestyle;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	DateStyle = save_datestyle;
+
+	return result;
+}
+
+
+/*
+ * logTrigFormatRow -
+ *
+ *	The work horse of logTrigBuildRow().
+ */
+static text *
+logTrigFormatRow(Slony_I_ClusterStatus * cs, LogTrigCacheEntry * entry,
+				 char cmdtype, HeapTuple old_row, HeapTuple new_row,
+				 TupleDesc tupdesc, LogTrigArgs * la)
+{
+	Datum		old_value;
+	Datum		new_value;
+	bool		old_isnull;
+	bool		new_isnull;
+	bool		binary;
+	int			i;
+
+	binary = (cs->log_format == SLON_LOGFORMAT_BINARY && entry->anybinary);
+
+	switch (cmdtype)
+	{
+		case 'I':
+
 			/*
-			 * Ignore dropped columns
+			 * INSERT
+			 *
+			 * cmdtype = 'I' cmdargs = colname, newval [, ...]
 			 */
-			if (tupdesc->attrs[i]->attisdropped)
-				continue;
+			logTrigArgsInit(la, entry->natts + 1, binary);
+
+			/*
+			 * Specify all the columns
+			 */
+			for (i = 0; i < entry->natts; i++)
+			{
+				LogTrigCacheAtt *att = &(entry->atts[i]);
+
+				/*
+				 * Skip dropped and not replicated columns
+				 */
+				if (att->isdropped || att->excluded)
+					continue;
+
+				new_value = heap_getattr(new_row, i + 1, tupdesc, &new_isnull);
+				logTrigArgsAdd(la, att, new_value, new_isnull);
+			}
 
-			old_value = SPI_getbinval(old_row, tupdesc, i + 1, &old_isnull);
-			new_value = SPI_getbinval(new_row, tupdesc, i + 1, &new_isnull);
+			return cs->cmdtype_I;
+
+		case 'U':
 
 			/*
-			 * If old and new value are NULL, the column is unchanged
+			 * UPDATE
+			 *
+			 * cmdtype = 'U' cmdargs = colname, newval [, ...] pkcolname,
+			 * oldval [, ...]
 			 */
-			if (old_isnull && new_isnull)
-				continue;
+			logTrigArgsInit(la, (entry->natts * 2) + 1, binary);
 
 			/*
-			 * If both are NOT NULL, we need to compare the values and skip
-			 * setting the column if equal
+			 * For all changed columns, add name+value pairs and count them.
 			 */
-			if (!old_isnull && !new_isnull)
+			for (i = 0; i < entry->natts; i++)
 			{
-				Oid			opr_oid;
-				FmgrInfo   *opr_finfo_p;
+				LogTrigCacheAtt *att = &(entry->atts[i]);
 
 				/*
-				 * Lookup the equal operators function call info using the
-				 * typecache if available
+				 * Ignore dropped and not replicated columns
 				 */
-#ifdef HAVE_TYPCACHE
-				TypeCacheEntry *type_cache;
-
-				type_cache = lookup_type_cache(
-											   SPI_gettypeid(tupdesc, i + 1),
-								  TYPECACHE_EQ_OPR | TYPECACHE_EQ_OPR_FINFO);
-				opr_oid = type_cache->eq_opr;
-				if (opr_oid == ARRAY_EQ_OP)
-					opr_oid = InvalidOid;
-				else
-					opr_finfo_p = &(type_cache->eq_opr_finfo);
-#else
-				FmgrInfo	opr_finfo;
+				if (att->isdropped || att->excluded)
+					continue;
 
-				opr_oid = compatible_oper_funcid(makeList1(makeString("=")),
-											   SPI_gettypeid(tupdesc, i + 1),
-										SPI_gettypeid(tupdesc, i + 1), true);
-				if (OidIsValid(opr_oid))
-				{
-					fmgr_info(opr_oid, &opr_finfo);
-					opr_finfo_p = &opr_finfo;
-				}
-#endif
+				old_value = heap_getattr(old_row, i + 1, tupdesc, &old_isnull);
+				new_value = heap_getattr(new_row, i + 1, tupdesc, &new_isnull);
+
+				/*
+				 * If old and new value are NULL, the column is unchanged
+				 */
+				if (old_isnull && new_isnull)
+					continue;
 
 				/*
-				 * If we have an equal operator, use that to do binary
-				 * comparision. Else get the string representation of both
-				 * attributes and do string comparision.
+				 * If both are NOT NULL, we need to compare the values and
+				 * skip setting the column if equal
 				 */
-				if (OidIsValid(opr_oid))
+				if (!old_isnull && !new_isnull)
 				{
-					if (DatumGetBool(FunctionCall2(opr_finfo_p,
-												   old_value, new_value)))
+					/*
+					 * Identical varlena images are equal whatever the type
+					 * is. This catches unchanged TOASTed columns, which
+					 * keep their toast pointer on UPDATE, and compressed
+					 * values without detoasting them.
+					 */
+					if (att->typlen == -1 &&
+						logTrigSameVarlena(old_value, new_value))
 						continue;
-				}
-				else
-				{
-					char	   *old_strval = SPI_getvalue(old_row, tupdesc, i + 1);
-					char	   *new_strval = SPI_getvalue(new_row, tupdesc, i + 1);
 
-					if (strcmp(old_strval, new_strval) == 0)
-						continue;
+					/*
+					 * If we have an equal operator, use that to do binary
+					 * comparision. Else get the string representation of
+					 * both attributes and do string comparision.
+					 */
+					if (att->haveeq)
+					{
+						if (DatumGetBool(FunctionCall2(&(att->eqfunc),
+													   old_value, new_value)))
+							continue;
+					}
+					else
+					{
+						char	   *old_strval = OutputFunctionCall(
+											   &(att->outfunc), old_value);
+						char	   *new_strval = OutputFunctionCall(
+											   &(att->outfunc), new_value);
+
+						if (strcmp(old_strval, new_strval) == 0)
+							continue;
+					}
 				}
-			}
 
-			*cmdargselem++ = DirectFunctionCall1(textin,
-								 CStringGetDatum(SPI_fname(tupdesc, i + 1)));
-			*cmdnullselem++ = false;
-			if (new_isnull)
-			{
-				*cmdnullselem++ = true;
-				cmdargselem++;
+				logTrigArgsAdd(la, att, new_value, new_isnull);
+				la->cmdupdncols++;
 			}
-			else
+
+			/*
+			 * Add pairs of PK column names and values
+			 */
+			for (i = 0; i < entry->natts; i++)
 			{
-				*cmdargselem++ = DirectFunctionCall1(textin,
-					 CStringGetDatum(SPI_getvalue(new_row, tupdesc, i + 1)));
-				*cmdnullselem++ = false;
+				LogTrigCacheAtt *att = &(entry->atts[i]);
+
+				if (!att->iskey)
+					continue;
+
+				old_value = heap_getattr(old_row, i + 1, tupdesc, &old_isnull);
+				if (old_isnull)
+					elog(ERROR, "Slony-I: old key column %s.%s IS NULL on UPDATE",
+						 DatumGetCString(DirectFunctionCall1(textout,
+															 entry->relname)),
+						 NameStr(tupdesc->attrs[i]->attname));
+
+				logTrigArgsAdd(la, att, old_value, false);
 			}
-			cmdupdncols++;
-		}
 
-		/*
-		 * Add pairs of PK column names and values
-		 */
-		for (i = 0, attkind_idx = -1; i < tg->tg_relation->rd_att->natts; i++)
-		{
 			/*
-			 * Ignore dropped columns
+			 * If only columns that are not replicated were changed,
+			 * there is nothing to log. An UPDATE that does not change
+			 * anything is still logged like it always was.
 			 */
-			if (tupdesc->attrs[i]->attisdropped)
-				continue;
+			if (la->cmdupdncols == 0 && entry->anyexcluded)
+				return NULL;
 
-			attkind_idx++;
-			if (!attkind[attkind_idx])
-				break;
-			if (attkind[attkind_idx] != 'k')
-				continue;
-			col_ident = SPI_fname(tupdesc, i + 1);
-			col_value = SPI_getvalue(old_row, tupdesc, i + 1);
-			if (col_value == NULL)
-				elog(ERROR, "Slony-I: old key column %s.%s IS NULL on UPDATE",
-					 NameStr(tg->tg_relation->rd_rel->relname), col_ident);
-
-			*cmdargselem++ = DirectFunctionCall1(textin,
-												 CStringGetDatum(col_ident));
-			*cmdnullselem++ = false;
-
-			*cmdargselem++ = DirectFunctionCall1(textin,
-												 CStringGetDatum(col_value));
-			*cmdnullselem++ = false;
-		}
+			return cs->cmdtype_U;
 
-	}
-	else if (TRIGGER_FIRED_BY_DELETE(tg->tg_event))
-	{
-		HeapTuple	old_row = tg->tg_trigtuple;
-		TupleDesc	tupdesc = tg->tg_relation->rd_att;
-		char	   *col_ident;
-		char	   *col_value;
-		int			i;
+		case 'D':
 
-		/*
-		 * DELETE
-		 *
-		 * cmdtype = 'D' cmdargs = pkcolname, oldval [, ...]
-		 */
-		cmdtype = cs->cmdtype_D;
+			/*
+			 * DELETE
+			 *
+			 * cmdtype = 'D' cmdargs = pkcolname, oldval [, ...]
+			 */
+			logTrigArgsInit(la, entry->natts + 1, binary);
 
-		cmdargselem = cmdargs = (Datum *) palloc(sizeof(Datum) *
-								 ((tg->tg_relation->rd_att->natts * 2) + 2));
-		cmdnullselem = cmdnulls = (bool *) palloc(sizeof(bool) *
-								 ((tg->tg_relation->rd_att->natts * 2) + 2));
+			/*
+			 * Add the PK columns
+			 */
+			for (i = 0; i < entry->natts; i++)
+			{
+				LogTrigCacheAtt *att = &(entry->atts[i]);
 
-		/*
-		 * Add the PK columns
-		 */
-		for (i = 0, attkind_idx = -1; i < tg->tg_relation->rd_att->natts; i++)
-		{
-			if (tupdesc->attrs[i]->attisdropped)
-				continue;
+				if (!att->iskey)
+					continue;
 
-			attkind_idx++;
-			if (!attkind[attkind_idx])
-				break;
-			if (attkind[attkind_idx] != 'k')
-				continue;
+				old_value = heap_getattr(old_row, i + 1, tupdesc, &old_isnull);
+				if (old_isnull)
+					elog(ERROR, "Slony-I: old key column %s.%s IS NULL on DELETE",
+						 DatumGetCString(DirectFunctionCall1(textout,
+															 entry->relname)),
+						 NameStr(tupdesc->attrs[i]->attname));
 
-			*cmdargselem++ = DirectFunctionCall1(textin,
-					 CStringGetDatum(col_ident = SPI_fname(tupdesc, i + 1)));
-			*cmdnullselem++ = false;
-
-			col_value = SPI_getvalue(old_row, tupdesc, i + 1);
-			if (col_value == NULL)
-				elog(ERROR, "Slony-I: old key column %s.%s IS NULL on DELETE",
-					 NameStr(tg->tg_relation->rd_rel->relname), col_ident);
-			*cmdargselem++ = DirectFunctionCall1(textin,
-												 CStringGetDatum(col_value));
-			*cmdnullselem++ = false;
-		}
-	}
-	else
-		elog(ERROR, "Slony-I: logTrigger() fired for unhandled event");
+				logTrigArgsAdd(la, att, old_value, false);
+			}
 
-	/*
-	 * Restore the datestyle
-	 */
-	if (!strstr(olddatestyle, "ISO"))
-	{
-#ifdef SETCONFIGOPTION_6
-		set_config_option("DateStyle", olddatestyle,
-						  PGC_USERSET, PGC_S_SESSION, true, true);
-#elif defined(SETCONFIGOPTION_7)
-		set_config_option("DateStyle", olddatestyle,
-						  PGC_USERSET, PGC_S_SESSION, true, true, 0);
-#elif defined(SETCONFIGOPTION_8)
-		set_config_option("DateStyle", olddatestyle,
-						  PGC_USERSET, PGC_S_SESSION, true, true, 0, 0);
-#endif
+			return cs->cmdtype_D;
+
+		default:
+			elog(ERROR, "Slony-I: logTrigFormatRow() called for unhandled "
+				 "cmdtype '%c'", cmdtype);
+			break;
 	}
 
-	/*
-	 * Construct the parameter array and insert the log row.
-	 */
-	cmddims[0] = cmdargselem - cmdargs;
-	cmdlbs[0] = 1;
+	return NULL;
+}
 
-	log_param[0] = Int32GetDatum(tab_id);
-	log_param[1] = DirectFunctionCall1(textin,
-									   CStringGetDatum(get_namespace_name(
-									RelationGetNamespace(tg->tg_relation))));
-	log_param[2] = DirectFunctionCall1(textin,
-				  CStringGetDatum(RelationGetRelationName(tg->tg_relation)));
-	log_param[3] = PointerGetDatum(cmdtype);
-	log_param[4] = Int32GetDatum(cmdupdncols);
-	log_param[5] = PointerGetDatum(construct_md_array(cmdargs, cmdnulls, 1,
-								  cmddims, cmdlbs, TEXTOID, -1, false, 'i'));
 
-	SPI_execp(cs->plan_active_log, log_param, NULL, 0);
+/*
+ * logTrigInsertRow -
+ *
+ *	Insert a log row built by logTrigBuildRow() into the active
+ *	log table.
+ */
+static void
+logTrigInsertRow(Slony_I_ClusterStatus * cs, LogTrigCacheEntry * entry,
+				 text *cmdtype, LogTrigArgs * la)
+{
+	Datum		log_param[8];
+	char		log_nulls[9];
+
+	logTrigRowValues(cs, entry, cmdtype, la, log_param, log_nulls);
+	log_nulls[8] = '\0';
 
-	SPI_finish();
-	return PointerGetDatum(NULL);
+	if (SPI_execp(cs->plan_active_log, log_param, log_nulls, 0) < 0)
+		elog(ERROR, "Slony-I: SPI_execp() failed for \"INSERT INTO sl_log_N ...\"");
 }
 
 
-Datum
-versionFunc(denyAccess) (PG_FUNCTION_ARGS)
+/*
+ * logTrigRowValues -
+ *
+ *	Fill the first 8 parameters of the log row insert plans. The
+ *	arrays are built in the current memory context.
+ */
+static void
+logTrigRowValues(Slony_I_ClusterStatus * cs, LogTrigCacheEntry * entry,
+				 text *cmdtype, LogTrigArgs * la, Datum *values, char *nulls)
 {
-	TriggerData *tg;
+	int			cmddims[1];
+	int			cmdlbs[1];
 
-	/*
-	 * Get the trigger call context
-	 */
-	if (!CALLED_AS_TRIGGER(fcinfo))
-		elog(ERROR, "Slony-I: denyAccess() not called as trigger");
-	tg = (TriggerData *) (fcinfo->context);
+	memset(nulls, ' ', 8);
+	cmdlbs[0] = 1;
+
+	values[0] = Int32GetDatum(entry->tab_id);
+	values[1] = entry->nspname;
+	values[2] = entry->relname;
+	values[3] = PointerGetDatum(cmdtype);
+	values[4] = Int32GetDatum(la->cmdupdncols);
+
+	cmddims[0] = la->nargs;
+	values[5] = PointerGetDatum(construct_md_array(la->args, la->argnulls,
+								  1, cmddims, cmdlbs, TEXTOID, -1, false, 'i'));
 
 	/*
-	 * Check all logTrigger() calling conventions
-	 */
-	if (!TRIGGER_FIRED_BEFORE(tg->tg_event))
-		elog(ERROR, "Slony-I: denyAccess() must be fired BEFORE");
-	if (!TRIGGER_FIRED_FOR_ROW(tg->tg_event))
-		elog(ERROR, "Slony-I: denyAccess() must be fired FOR EACH ROW");
-	if (tg->tg_trigger->tgnargs != 1)
-		elog(ERROR, "Slony-I: denyAccess() must be defined with 1 arg");
-
-	/*
-	 * Connect to the SPI manager
-	 */
-	if (SPI_connect() < 0)
-		elog(ERROR, "Slony-I: SPI_connect() failed in denyAccess()");
-
-	/*
-	 * If the replication role is: ORIGIN - default role --> FAIL REPLICA -
-	 * this trigger will not fire in --> N/A LOCAL - role when running "local
-	 * updates" --> PERMIT UPDATE
+	 * Rows in the text format leave log_cmdformat and log_cmdbinargs
+	 * NULL, exactly like the rows of earlier versions.
 	 */
-	if (SessionReplicationRole == SESSION_REPLICATION_ROLE_ORIGIN)
-		elog(ERROR,
-			 "Slony-I: Table %s is replicated and cannot be "
-			 "modified on a subscriber node - role=%d",
-		  NameStr(tg->tg_relation->rd_rel->relname), SessionReplicationRole);
-
-	SPI_finish();
-	if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event))
-		return PointerGetDatum(tg->tg_newtuple);
+	if (la->binary)
+	{
+		cmddims[0] = la->nargs / 2;
+		values[6] = Int32GetDatum(SLON_LOGFORMAT_BINARY);
+		values[7] = PointerGetDatum(construct_md_array(la->binargs,
+							  la->binnulls, 1, cmddims, cmdlbs, BYTEAOID, -1,
+													   false, 'i'));
+	}
 	else
-		return PointerGetDatum(tg->tg_trigtuple);
+	{
+		values[6] = (Datum) 0;
+		values[7] = (Datum) 0;
+		nulls[6] = 'n';
+		nulls[7] = 'n';
+	}
 }
 
 
-Datum
-versionFunc(logApply) (PG_FUNCTION_ARGS)
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+/*
+ * logTrigBufferRow -
+ *
+ *	Add a log row built by logTrigBuildRow() to the log buffer and
+ *	flush the buffer if it holds flush_rows rows.
+ */
+static void
+logTrigBufferRow(Slony_I_ClusterStatus * cs, LogTrigCacheEntry * entry,
+				 text *cmdtype, LogTrigArgs * la, int flush_rows)
 {
-	TransactionId newXid = GetTopTransactionId();
-	Slony_I_ClusterStatus *cs;
-	TriggerData *tg;
-	HeapTuple	new_row;
-	TupleDesc	tupdesc;
-	Name		cluster_name;
-	int			rc;
-	bool		isnull;
-	Relation	target_rel;
-
-	Datum		dat;
-	char		cmdtype;
-	int32		tableid;
-	char	   *nspname;
-	char	   *relname;
-	int32		cmdupdncols;
-	Datum	   *cmdargs;
-	bool	   *cmdargsnulls;
-	int			cmdargsn;
-	int			querynvals = 0;
-	Datum	   *queryvals = NULL;
-	Oid		   *querytypes = NULL;
-	char	   *querynulls = NULL;
-	char	  **querycolnames = NULL;
-	int			i;
-	int			spi_rc;
-
 	MemoryContext oldContext;
-	ApplyCacheEntry *cacheEnt;
-	char	   *cacheKey;
-	bool		found;
+	LogBufferRow *row;
 
 	/*
-	 * Get the trigger call context
+	 * The buffer only ever holds rows for one cluster.
 	 */
-	if (!CALLED_AS_TRIGGER(fcinfo))
-		elog(ERROR, "Slony-I: logApply() not called as trigger");
-	tg = (TriggerData *) (fcinfo->context);
+	if (logBufferCS != NULL && logBufferCS != cs)
+	{
+		logTrigBufferFlush();
+		if (logBufferUsed > 0)
+			elog(ERROR, "Slony-I: cannot buffer log rows of two clusters "
+				 "in one subtransaction");
+	}
 
-	/*
-	 * Don't do any applying if the current session role isn't Replica.
-	 */
-	if (SessionReplicationRole != SESSION_REPLICATION_ROLE_REPLICA)
-		return PointerGetDatum(tg->tg_trigtuple);
+	logTrigCallbacksInit();
 
-	/*
-	 * Check all logApply() calling conventions
-	 */
-	if (!TRIGGER_FIRED_BEFORE(tg->tg_event))
-		elog(ERROR, "Slony-I: logApply() must be fired BEFORE");
-	if (!TRIGGER_FIRED_FOR_ROW(tg->tg_event))
-		elog(ERROR, "Slony-I: logApply() must be fired FOR EACH ROW");
-	if (tg->tg_trigger->tgnargs != 1)
-		elog(ERROR, "Slony-I: logApply() must be defined with 1 arg");
+	if (logBufferContext == NULL)
+		logBufferContext = AllocSetContextCreate(TopTransactionContext,
+												 "Slony-I log buffer",
+												 ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
+	logBufferCS = cs;
 
-	/*
-	 * Connect to the SPI manager
-	 */
-	if ((rc = SPI_connect()) < 0)
-		elog(ERROR, "Slony-I: SPI_connect() failed in logApply()");
+	oldContext = MemoryContextSwitchTo(logBufferContext);
+
+	if (logBufferUsed >= logBufferSize)
+	{
+		if (logBuffer == NULL)
+		{
+			logBufferSize = LOG_BUFFER_BATCH;
+			logBuffer = (LogBufferRow *)
+				palloc(sizeof(LogBufferRow) * logBufferSize);
+		}
+		else
+		{
+			logBufferSize *= 2;
+			logBuffer = (LogBufferRow *)
+				repalloc(logBuffer, sizeof(LogBufferRow) * logBufferSize);
+		}
+	}
 
 	/*
-	 * Get or create the cluster status information and make sure it has the
-	 * SPI plans that we need here.
+	 * Copy everything the row needs into the buffer context and assign
+	 * the log_actionseq now.
 	 */
-	cluster_name = DatumGetName(DirectFunctionCall1(namein,
-								CStringGetDatum(tg->tg_trigger->tgargs[0])));
-	cs = getClusterStatus(cluster_name, PLAN_APPLY_QUERIES);
+	row = &(logBuffer[logBufferUsed]);
+	logTrigRowValues(cs, entry, cmdtype, la, row->values, row->nulls);
+	row->values[1] = datumCopy(entry->nspname, false, -1);
+	row->values[2] = datumCopy(entry->relname, false, -1);
+	row->values[8] = DirectFunctionCall1(nextval_oid,
+										 ObjectIdGetDatum(cs->action_seq_oid));
+	row->nulls[8] = ' ';
+	row->subid = GetCurrentSubTransactionId();
+	logBufferUsed++;
+
+	MemoryContextSwitchTo(oldContext);
+
+	if (logBufferUsed >= flush_rows)
+		logTrigBufferFlush();
+}
+
+
+/*
+ * logTrigBufferFlush -
+ *
+ *	Write the buffered log rows of the current subtransaction and its
+ *	children into the log table.
+ */
+static void
+logTrigBufferFlush(void)
+{
+	Slony_I_ClusterStatus *cs = logBufferCS;
+	SubTransactionId subid = GetCurrentSubTransactionId();
+	Datum		values[LOG_BUFFER_BATCH * LOG_BUFFER_NPARAMS];
+	char		nulls[LOG_BUFFER_BATCH * LOG_BUFFER_NPARAMS + 1];
+	int			nrows = 0;
+	int			kept = 0;
+	int			i;
 
 	/*
-	 * Do the following only once per transaction.
+	 * Rows captured by a parent of the current subtransaction must stay
+	 * in the buffer, or they would be lost if the current subtransaction
+	 * rolls back. Their log_actionseq is already assigned, so writing
+	 * them later does not change the order in which they are applied.
 	 */
-	bool planInitRequired = false;
-	if(!TransactionIdEquals(cs->currentXid, newXid))
-	{
-		planInitRequired = true;
-		cs->log_init = false;
-		cs->event_txn=false;
-	}
-	else if (!cs->apply_init)
+	for (i = 0; i < logBufferUsed; i++)
 	{
-		planInitRequired = true;
+		if (logBuffer[i].subid >= subid)
+			break;
 	}
-	
-	if (planInitRequired)
-	{
-		HASHCTL		hctl;
+	if (i == logBufferUsed)
+		return;
 
-		/*
-		 * Free all prepared apply queries.
-		 */
-		for (cacheEnt = applyCacheHead; cacheEnt; cacheEnt = cacheEnt->next)
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logTrigBufferFlush()");
+
+	for (i = 0; i < logBufferUsed; i++)
+	{
+		if (logBuffer[i].subid < subid)
 		{
-			if (cacheEnt->plan != NULL)
-				SPI_freeplan(cacheEnt->plan);
-			cacheEnt->plan = NULL;
+			if (kept != i)
+				logBuffer[kept] = logBuffer[i];
+			kept++;
+			continue;
 		}
-		applyCacheHead = NULL;
-		applyCacheTail = NULL;
-		applyCacheUsed = 0;
 
-		/*
-		 * Destroy and recreate the hashtable for the apply cache
-		 */
-		if (applyCacheHash != NULL)
-			hash_destroy(applyCacheHash);
-		memset(&hctl, 0, sizeof(hctl));
-		hctl.keysize = sizeof(char *);
-		hctl.entrysize = sizeof(ApplyCacheEntry);
-		hctl.hash = applyCache_hash;
-		hctl.match = applyCache_cmp;
-		applyCacheHash = hash_create("Slony-I apply cache",
-									 50, &hctl,
-								   HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+		memcpy(&(values[nrows * LOG_BUFFER_NPARAMS]), logBuffer[i].values,
+			   sizeof(Datum) * LOG_BUFFER_NPARAMS);
+		memcpy(&(nulls[nrows * LOG_BUFFER_NPARAMS]), logBuffer[i].nulls,
+			   LOG_BUFFER_NPARAMS);
+		nrows++;
 
-		/*
-		 * Reset or create the apply cache key memory context.
-		 */
-		if (applyCacheContext == NULL)
-		{
-			applyCacheContext = AllocSetContextCreate(
-													  TopMemoryContext,
-												  "Slony-I apply query keys",
-													ALLOCSET_DEFAULT_MINSIZE,
-												   ALLOCSET_DEFAULT_INITSIZE,
-												   ALLOCSET_DEFAULT_MAXSIZE);
-		}
-		else
+		if (nrows == LOG_BUFFER_BATCH)
 		{
-			MemoryContextReset(applyCacheContext);
+			nulls[nrows * LOG_BUFFER_NPARAMS] = '\0';
+			if (SPI_execp(cs->plan_active_batch, values, nulls, 0) < 0)
+				elog(ERROR, "Slony-I: SPI_execp() failed for buffered "
+					 "\"INSERT INTO sl_log_N ...\"");
+			nrows = 0;
 		}
-
-		/*
-		 * Reset statistic counters.
-		 */
-		apply_num_insert = 0;
-		apply_num_update = 0;
-		apply_num_delete = 0;
-		apply_num_truncate = 0;
-		apply_num_script = 0;
-		apply_num_prepare = 0;
-		apply_num_hit = 0;
-		apply_num_evict = 0;
-
-		cs->currentXid = newXid;
-		cs->apply_init = true;
 	}
 
-	/*
-	 * Get the cmdtype first.
-	 */
-	new_row = tg->tg_trigtuple;
-	tupdesc = tg->tg_relation->rd_att;
+	for (i = 0; i < nrows; i++)
+	{
+		if (SPI_execp(cs->plan_active_buffer,
+					  &(values[i * LOG_BUFFER_NPARAMS]),
+					  &(nulls[i * LOG_BUFFER_NPARAMS]), 0) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() failed for buffered "
+				 "\"INSERT INTO sl_log_N ...\"");
+	}
 
-	dat = SPI_getbinval(new_row, tupdesc,
-						SPI_fnumber(tupdesc, "log_cmdtype"), &isnull);
-	if (isnull)
-		elog(ERROR, "Slony-I: log_cmdtype is NULL");
-	cmdtype = DatumGetChar(dat);
+	SPI_finish();
 
 	/*
-	 * Rows coming from sl_log_script are handled different from regular data
-	 * log rows since they don't have all the columns.
+	 * Start over with an empty buffer if nothing had to stay.
 	 */
-	if (cmdtype == 'S')
+	logBufferUsed = kept;
+	if (kept == 0)
 	{
-		char	   *ddl_script;
-		bool		localNodeFound = true;
-		Datum		script_insert_args[5];
-		Datum	   *nodeargs;
-		bool	   *nodeargsnulls;
-		int			nodeargsn;
-		Datum	   *seqargs;
-		bool	   *seqargsnulls;
-		int			seqargsn;
-		Datum		array_holder;
-		Datum		delim_text;
+		MemoryContextReset(logBufferContext);
+		logBuffer = NULL;
+		logBufferSize = 0;
+	}
+}
 
-		apply_num_script++;
 
+/*
+ * logTrigBufferXactCallback -
+ *
+ *	Log the coalesced rows and flush the log buffer right before the
+ *	transaction commits or is prepared. The memory of these and of the
+ *	logApply() batch goes away with TopTransactionContext.
+ */
+static void
+logTrigBufferXactCallback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PRE_PREPARE:
 
-		/*
-		 * Turn the log_cmdargs into a plain array of Text Datums.
-		 */
-		dat = SPI_getbinval(new_row, tupdesc,
-							SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
-		if (isnull)
-			elog(ERROR, "Slony-I: log_cmdargs is NULL");
-		deconstruct_array(DatumGetArrayTypeP(dat),
-						  TEXTOID, -1, false, 'i',
-						  &cmdargs, &cmdargsnulls, &cmdargsn);
+			/*
+			 * Deferred triggers have fired already, so it is too late
+			 * to apply a batch here. logApplyFlush() should have done
+			 * that at the end of the statement.
+			 */
+			if (applyBatchUsed > 0)
+				elog(ERROR, "Slony-I: logApply() batch still pending at "
+					 "commit, apply_flush_trigger missing on the log table");
+			logTrigCoalesceEmit();
+			logTrigBufferFlush();
+			break;
 
-		nodeargs = NULL;
-		nodeargsn = 0;
-		seqargs = NULL;
-		seqargsn = 0;
-		if (cmdargsn >= 2)
-		{
-			delim_text = DirectFunctionCall1(textin, CStringGetDatum(","));
-			if ((!cmdargsnulls[1]))
-			{
-				char	   *astr = DatumGetCString(DirectFunctionCall1(textout,
-																cmdargs[1]));
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+			logBufferContext = NULL;
+			logBuffer = NULL;
+			logBufferSize = 0;
+			logBufferUsed = 0;
+			logBufferCS = NULL;
+			coalesceContext = NULL;
+			logTrigCoalesceReset();
+			applyBatchReset();
+			break;
 
-				if (strcmp(astr, ""))
-				{
-					array_holder = DirectFunctionCall2(text_to_array, cmdargs[1],
-													   delim_text);
-					deconstruct_array(DatumGetArrayTypeP(array_holder),
-									  TEXTOID, -1, false, 'i',
-									  &nodeargs, &nodeargsnulls, &nodeargsn);
-				}
-			}
-		}
-		if (cmdargsn >= 3)
-		{
-			if ((!cmdargsnulls[2]))
-			{
-				char	   *astr = DatumGetCString(DirectFunctionCall1(textout,
-																cmdargs[2]));
+		default:
+			break;
+	}
+}
 
-				if (strcmp(astr, ""))
-				{
-					array_holder = DirectFunctionCall2(text_to_array, cmdargs[2],
-													   delim_text);
-					deconstruct_array(DatumGetArrayTypeP(array_holder),
-									  TEXTOID, -1, false, 'i',
-									  &seqargs, &seqargsnulls, &seqargsn);
-				}
-			}
-		}
 
-		/*
-		 * The first element is the DDL statement itself.
-		 */
-		ddl_script = DatumGetCString(DirectFunctionCall1(
-													   textout, cmdargs[0]));
+/*
+ * logTrigBufferSubXactCallback -
+ *
+ *	Forget the buffered rows and coalesced row versions of an aborted
+ *	subtransaction. Rows are appended in order, and everything captured
+ *	since the subtransaction started belongs to it or to one of its
+ *	children, which all have a higher SubTransactionId.
+ */
+static void
+logTrigBufferSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
+							 SubTransactionId parentSubid, void *arg)
+{
+	CoalesceRow *crow;
 
-		/*
-		 * If there is an optional node ID list, check that we are in it.
-		 */
-		if (nodeargsn > 0)
-		{
-			localNodeFound = false;
-			for (i = 0; i < nodeargsn; i++)
-			{
-				int32		nodeId = DatumGetInt32(
-												   DirectFunctionCall1(int4in,
-								 DirectFunctionCall1(textout, nodeargs[i])));
+	if (event != SUBXACT_EVENT_ABORT_SUB)
+		return;
 
-				if (nodeId == cs->localNodeId)
-				{
-					localNodeFound = true;
-					break;
-				}
-			}
-		}
+	while (logBufferUsed > 0 && logBuffer[logBufferUsed - 1].subid >= mySubid)
+		logBufferUsed--;
 
-		/*
-		 * Execute the DDL statement if the node list is empty or our local
-		 * node ID appears in it.
-		 */
-		if (localNodeFound)
-		{
+	if (coalesceMaxSubid == InvalidSubTransactionId ||
+		coalesceMaxSubid < mySubid)
+		return;
+	for (crow = coalesceFirst; crow != NULL; crow = crow->next)
+	{
+		while (crow->top != NULL && crow->top->subid >= mySubid)
+			crow->top = crow->top->prev;
+	}
+	coalesceMaxSubid = parentSubid;
+}
 
-			char		query[1024];
-			Oid			argtypes[3];
-			void	   *plan = NULL;
 
-			argtypes[0] = INT4OID;
-			argtypes[1] = INT4OID;
-			argtypes[2] = INT8OID;
+/*
+ * logTrigCallbacksInit -
+ *
+ *	Register the transaction callbacks of the log buffer and the
+ *	coalesced rows.
+ */
+static void
+logTrigCallbacksInit(void)
+{
+	if (logBufferCallbacks)
+		return;
 
-			snprintf(query, 1023, "select \"%s\".sequenceSetValue($1," \
-					 "$2,NULL,$3,true); ", tg->tg_trigger->tgargs[0]);
-			plan = SPI_prepare(query, 3, argtypes);
-			if (plan == NULL)
-			{
+	RegisterXactCallback(logTrigBufferXactCallback, NULL);
+	RegisterSubXactCallback(logTrigBufferSubXactCallback, NULL);
+	logBufferCallbacks = true;
+}
 
-				elog(ERROR, "could not prepare plan to call sequenceSetValue");
-			}
-			/**
-			 * before we execute the DDL we need to update the sequences.
-			 */
-			if (seqargsn > 0)
-			{
 
-				for (i = 0; (i + 2) < seqargsn; i = i + 3)
-				{
-					Datum		call_args[3];
-					bool		call_nulls[3];
+/*
+ * logTrigCoalesceRow -
+ *
+ *	Fold one change to a coalesced table into the net change of the
+ *	row. An UPDATE of the key is treated as a DELETE of the old key
+ *	followed by an INSERT of the new one.
+ */
+static void
+logTrigCoalesceRow(LogTrigCacheEntry * entry, TriggerData *tg, char cmdtype,
+				   HeapTuple old_row, HeapTuple new_row, TupleDesc tupdesc)
+{
+	Oid			reloid = RelationGetRelid(tg->tg_relation);
+	CoalesceTable *tbl;
+	CoalesceRow *crow;
+	CoalesceRow *new_crow;
+	CoalesceVersion *top;
+	MemoryContext oldContext;
 
-					call_args[0] = DirectFunctionCall1(int4in,
-								   DirectFunctionCall1(textout, seqargs[i]));
-					call_args[1] = DirectFunctionCall1(int4in,
-							   DirectFunctionCall1(textout, seqargs[i + 1]));
-					call_args[2] = DirectFunctionCall1(int8in,
-							   DirectFunctionCall1(textout, seqargs[i + 2]));
+	logTrigCallbacksInit();
 
-					call_nulls[0] = 0;
-					call_nulls[1] = 0;
-					call_nulls[2] = 0;
+	if (coalesceContext == NULL)
+	{
+		HASHCTL		hctl;
 
-					if (SPI_execp(plan, call_args, call_nulls, 0) < 0)
-					{
-						elog(ERROR, "error executing sequenceSetValue plan");
+		coalesceContext = AllocSetContextCreate(TopTransactionContext,
+												"Slony-I coalesced rows",
+												ALLOCSET_DEFAULT_MINSIZE,
+												ALLOCSET_DEFAULT_INITSIZE,
+												ALLOCSET_DEFAULT_MAXSIZE);
+		memset(&hctl, 0, sizeof(hctl));
+		hctl.keysize = sizeof(CoalesceKey);
+		hctl.entrysize = sizeof(CoalesceHashEntry);
+		hctl.hash = tag_hash;
+		hctl.hcxt = coalesceContext;
+		coalesceHash = hash_create("Slony-I coalesced rows", 256, &hctl,
+								   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+	}
 
-					}
+	oldContext = MemoryContextSwitchTo(coalesceContext);
 
-				}
+	/*
+	 * Remember how to get at the log trigger cache entry of the table
+	 * again at commit. All log triggers of a table have the same
+	 * arguments, so any of them will do.
+	 */
+	for (tbl = coalesceTables; tbl != NULL; tbl = tbl->next)
+	{
+		if (tbl->reloid == reloid)
+			break;
+	}
+	if (tbl == NULL)
+	{
+		int			i;
 
+		tbl = (CoalesceTable *) palloc(sizeof(CoalesceTable));
+		tbl->reloid = reloid;
+		tbl->tgoid = tg->tg_trigger->tgoid;
+		tbl->tgargs = (char **) palloc(sizeof(char *) * 3);
+		for (i = 0; i < 3; i++)
+			tbl->tgargs[i] = pstrdup(tg->tg_trigger->tgargs[i]);
+		tbl->tupdesc = CreateTupleDescCopy(tupdesc);
+		tbl->next = coalesceTables;
+		coalesceTables = tbl;
+	}
 
-			}
+	switch (cmdtype)
+	{
+		case 'I':
+			crow = logTrigCoalesceFind(entry, tbl, new_row, tupdesc);
+			top = crow->top;
+			if (top == NULL)
+				logTrigCoalesceSet(crow, false, NULL,
+								   heap_copytuple(new_row));
+			else
+				logTrigCoalesceSet(crow, top->existed, top->orig,
+								   heap_copytuple(new_row));
+			break;
 
-			sprintf(query, "set session_replication_role to local;");
-			if (SPI_exec(query, 0) < 0)
+		case 'U':
+			crow = logTrigCoalesceFind(entry, tbl, old_row, tupdesc);
+			new_crow = logTrigCoalesceFind(entry, tbl, new_row, tupdesc);
+			if (new_crow != crow)
 			{
-				elog(ERROR, "SPI_exec() failed for statement '%s'",
-					 query);
+				MemoryContextSwitchTo(oldContext);
+				logTrigCoalesceRow(entry, tg, 'D', old_row, NULL, tupdesc);
+				logTrigCoalesceRow(entry, tg, 'I', NULL, new_row, tupdesc);
+				return;
 			}
+			top = crow->top;
+			if (top == NULL)
+				logTrigCoalesceSet(crow, true, heap_copytuple(old_row),
+								   heap_copytuple(new_row));
+			else
+				logTrigCoalesceSet(crow, top->existed, top->orig,
+								   heap_copytuple(new_row));
+			break;
 
+		case 'D':
+			crow = logTrigCoalesceFind(entry, tbl, old_row, tupdesc);
+			top = crow->top;
+			if (top == NULL)
+				logTrigCoalesceSet(crow, true, heap_copytuple(old_row), NULL);
+			else
+				logTrigCoalesceSet(crow, top->existed, top->orig, NULL);
+			break;
 
-			if (SPI_exec(ddl_script, 0) < 0)
-			{
-				elog(ERROR, "SPI_exec() failed for DDL statement '%s'",
-					 ddl_script);
-			}
-
-			sprintf(query, "set session_replication_role to replica;");
-			if (SPI_exec(query, 0) < 0)
-			{
-				elog(ERROR, "SPI_exec() failed for statement '%s'",
-					 query);
-			}
+		default:
+			elog(ERROR, "Slony-I: logTrigCoalesceRow() called for unhandled "
+				 "cmdtype '%c'", cmdtype);
+			break;
+	}
 
-			/*
-			 * Set the currentXid to invalid to flush the apply query cache.
-			 */
-			cs->currentXid = InvalidTransactionId;
-		}
+	MemoryContextSwitchTo(oldContext);
+}
 
-		/*
-		 * Build the parameters for the insert into sl_log_script and execute
-		 * the query.
-		 */
-		script_insert_args[0] = SPI_getbinval(new_row, tupdesc,
-								SPI_fnumber(tupdesc, "log_origin"), &isnull);
-		script_insert_args[1] = SPI_getbinval(new_row, tupdesc,
-								  SPI_fnumber(tupdesc, "log_txid"), &isnull);
-		script_insert_args[2] = SPI_getbinval(new_row, tupdesc,
-							 SPI_fnumber(tupdesc, "log_actionseq"), &isnull);
-		script_insert_args[3] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_cmdtype"), &isnull);
-		script_insert_args[4] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
-		if (SPI_execp(cs->plan_insert_log_script, script_insert_args, NULL, 0) < 0)
-			elog(ERROR, "Execution of sl_log_script insert plan failed");
 
-		/*
-		 * Return NULL to suppress the insert into the original sl_log_N.
-		 */
-		SPI_finish();
-		return PointerGetDatum(NULL);
-	}
+/*
+ * logTrigCoalesceFind -
+ *
+ *	Find the coalesced row with the key of the given tuple or add a
+ *	new one without any version.
+ */
+static CoalesceRow *
+logTrigCoalesceFind(LogTrigCacheEntry * entry, CoalesceTable * tbl,
+					HeapTuple row, TupleDesc tupdesc)
+{
+	StringInfoData keybuf;
+	CoalesceKey key;
+	CoalesceHashEntry *hentry;
+	CoalesceRow *crow;
+	bool		found;
+	int			i;
 
 	/*
-	 * Process the special ddlScript_complete row.
+	 * The key is the datum image of all key columns. Unlike the output
+	 * function text it does not depend on DateStyle, IntervalStyle or
+	 * TimeZone, which the transaction may change between two updates
+	 * of the same row. Varlena values are detoasted so that they always
+	 * carry a full length header.
 	 */
-	if (cmdtype == 's')
+	initStringInfo(&keybuf);
+	for (i = 0; i < entry->natts; i++)
 	{
-		bool		localNodeFound = true;
-		Datum		script_insert_args[5];
-
-		apply_num_script++;
+		LogTrigCacheAtt *att = &(entry->atts[i]);
+		Form_pg_attribute attr = tupdesc->attrs[i];
+		Datum		value;
+		bool		isnull;
 
-		/*
-		 * Turn the log_cmdargs into a plain array of Text Datums.
-		 */
-		dat = SPI_getbinval(new_row, tupdesc,
-							SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
+		if (!att->iskey)
+			continue;
+		value = heap_getattr(row, i + 1, tupdesc, &isnull);
 		if (isnull)
-			elog(ERROR, "Slony-I: log_cmdargs is NULL");
-
-		deconstruct_array(DatumGetArrayTypeP(dat),
-						  TEXTOID, -1, false, 'i',
-						  &cmdargs, &cmdargsnulls, &cmdargsn);
+			elog(ERROR, "Slony-I: key column %s.%s IS NULL",
+				 DatumGetCString(DirectFunctionCall1(textout,
+													 entry->relname)),
+				 NameStr(attr->attname));
+		if (attr->attbyval)
+		{
+			char		image[sizeof(Datum)];
 
-		/*
-		 * If there is an optional node ID list, check that we are in it.
-		 */
-		if (cmdargsn > 1)
+			store_att_byval(image, value, attr->attlen);
+			appendBinaryStringInfo(&keybuf, image, attr->attlen);
+		}
+		else if (attr->attlen == -1)
 		{
-			localNodeFound = false;
-			for (i = 1; i < cmdargsn; i++)
-			{
-				int32		nodeId = DatumGetInt32(
-												   DirectFunctionCall1(int4in,
-								  DirectFunctionCall1(textout, cmdargs[i])));
+			struct varlena *detoasted = pg_detoast_datum((struct varlena *)
+												   DatumGetPointer(value));
 
-				if (nodeId == cs->localNodeId)
-				{
-					localNodeFound = true;
-					break;
-				}
-			}
+			appendBinaryStringInfo(&keybuf, (char *) detoasted,
+								   VARSIZE(detoasted));
+			if ((Pointer) detoasted != DatumGetPointer(value))
+				pfree(detoasted);
 		}
+		else if (attr->attlen == -2)
+			appendBinaryStringInfo(&keybuf, DatumGetCString(value),
+								   strlen(DatumGetCString(value)) + 1);
+		else
+			appendBinaryStringInfo(&keybuf, DatumGetPointer(value),
+								   attr->attlen);
+	}
 
-		/*
-		 * Execute the ddlScript_complete_int() call if we have to.
-		 */
-		if (localNodeFound)
+	key.reloid = tbl->reloid;
+	key.hashval = DatumGetUInt32(hash_any((unsigned char *) keybuf.data,
+										  keybuf.len));
+	hentry = (CoalesceHashEntry *) hash_search(coalesceHash, &key,
+											   HASH_ENTER, &found);
+	if (!found)
+		hentry->rows = NULL;
+
+	for (crow = hentry->rows; crow != NULL; crow = crow->chain)
+	{
+		if (crow->tbl == tbl && crow->keylen == keybuf.len &&
+			memcmp(crow->keydata, keybuf.data, keybuf.len) == 0)
 		{
-			char		query[1024];
+			pfree(keybuf.data);
+			return crow;
+		}
+	}
 
-			snprintf(query, sizeof(query),
-					 "select %s.ddlScript_complete_int();",
-					 cs->clusterident);
+	crow = (CoalesceRow *) palloc(sizeof(CoalesceRow));
+	crow->tbl = tbl;
+	crow->keydata = keybuf.data;
+	crow->keylen = keybuf.len;
+	crow->top = NULL;
+	crow->chain = hentry->rows;
+	hentry->rows = crow;
+	crow->next = NULL;
+	if (coalesceLast == NULL)
+		coalesceFirst = crow;
+	else
+		coalesceLast->next = crow;
+	coalesceLast = crow;
 
-			if (SPI_exec(query, 0) < 0)
-			{
-				elog(ERROR, "SPI_exec() failed for statement '%s'",
-					 query);
-			}
+	return crow;
+}
 
 
-			/*
-			 * Set the currentXid to invalid to flush the apply query cache.
-			 */
-			cs->currentXid = InvalidTransactionId;
-		}
+/*
+ * logTrigCoalesceSet -
+ *
+ *	Set the state of a coalesced row in the current subtransaction.
+ *	Versions of committed children of the current subtransaction are
+ *	superseded by the new one.
+ */
+static void
+logTrigCoalesceSet(CoalesceRow * crow, bool existed, HeapTuple orig,
+				   HeapTuple cur)
+{
+	SubTransactionId subid = GetCurrentSubTransactionId();
+	CoalesceVersion *version;
 
-		/*
-		 * Build the parameters for the insert into sl_log_script and execute
-		 * the query.
-		 */
-		script_insert_args[0] = SPI_getbinval(new_row, tupdesc,
-								SPI_fnumber(tupdesc, "log_origin"), &isnull);
-		script_insert_args[1] = SPI_getbinval(new_row, tupdesc,
-								  SPI_fnumber(tupdesc, "log_txid"), &isnull);
-		script_insert_args[2] = SPI_getbinval(new_row, tupdesc,
-							 SPI_fnumber(tupdesc, "log_actionseq"), &isnull);
-		script_insert_args[3] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_cmdtype"), &isnull);
-		script_insert_args[4] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
-		if (SPI_execp(cs->plan_insert_log_script, script_insert_args, NULL, 0) < 0)
-			elog(ERROR, "Execution of sl_log_script insert plan failed");
+	while (crow->top != NULL && crow->top->subid > subid)
+		crow->top = crow->top->prev;
 
-		/*
-		 * Return NULL to suppress the insert into the original sl_log_N.
-		 */
-		SPI_finish();
-		return PointerGetDatum(NULL);
+	if (crow->top != NULL && crow->top->subid == subid)
+		version = crow->top;
+	else
+	{
+		version = (CoalesceVersion *)
+			MemoryContextAlloc(coalesceContext, sizeof(CoalesceVersion));
+		version->subid = subid;
+		version->prev = crow->top;
+		crow->top = version;
 	}
+	version->existed = existed;
+	version->orig = orig;
+	version->cur = cur;
 
-	/*
-	 * Normal data log row. Get all the relevant data from the log row.
-	 */
-	dat = SPI_getbinval(new_row, tupdesc,
-						SPI_fnumber(tupdesc, "log_tableid"), &isnull);
-	if (isnull)
-		elog(ERROR, "Slony-I: log_tableid is NULL");
-	tableid = DatumGetInt32(dat);
-	nspname = SPI_getvalue(new_row, tupdesc,
-						   SPI_fnumber(tupdesc, "log_tablenspname"));
-	if (nspname == NULL)
-		elog(ERROR, "Slony-I: log_tablenspname is NULL on INSERT/UPDATE/DELETE");
-
-	relname = SPI_getvalue(new_row, tupdesc,
-						   SPI_fnumber(tupdesc, "log_tablerelname"));
-	if (relname == NULL)
-		elog(ERROR, "Slony-I: log_tablerelname is NULL on INSERT/UPDATE/DELETE");
+	if (coalesceMaxSubid == InvalidSubTransactionId ||
+		coalesceMaxSubid < subid)
+		coalesceMaxSubid = subid;
+}
 
-	dat = SPI_getbinval(new_row, tupdesc,
-						SPI_fnumber(tupdesc, "log_cmdupdncols"), &isnull);
-	if (isnull && cmdtype == 'U')
-		elog(ERROR, "Slony-I: log_cmdupdncols is NULL on UPDATE");
-	cmdupdncols = DatumGetInt32(dat);
 
-	dat = SPI_getbinval(new_row, tupdesc,
-						SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
-	if (isnull)
-		elog(ERROR, "Slony-I: log_cmdargs is NULL");
+/*
+ * logTrigCoalesceSafe -
+ *
+ *	Tell if the coalesced rows can be logged now, which is the case
+ *	unless a parent of the current subtransaction changed any of them.
+ */
+static bool
+logTrigCoalesceSafe(void)
+{
+	SubTransactionId subid = GetCurrentSubTransactionId();
+	CoalesceRow *crow;
+	CoalesceVersion *version;
 
-	/*
-	 * Turn the log_cmdargs into a plain array of Text Datums.
-	 */
-	deconstruct_array(DatumGetArrayTypeP(dat),
-					  TEXTOID, -1, false, 'i',
-					  &cmdargs, &cmdargsnulls, &cmdargsn);
-
-	/*
-	 * Build the query cache key. This is for insert, update and truncate just
-	 * the operation type and the table ID. For update we also append the
-	 * fully quoted names of updated columns.
-	 */
-	applyQueryReset();
-	sprintf(applyQueryPos, "%c,%d", cmdtype, tableid);
-	applyQueryPos += strlen(applyQueryPos);
-
-	if (cmdtype == 'U')
+	for (crow = coalesceFirst; crow != NULL; crow = crow->next)
 	{
-		char	   *colname;
-
-		for (i = 0; i < cmdupdncols * 2; i += 2)
+		for (version = crow->top; version != NULL; version = version->prev)
 		{
-			applyQueryIncrease();
-
-			colname = DatumGetCString(DirectFunctionCall1(
-													   textout, cmdargs[i]));
-			snprintf(applyQueryPos, applyQuerySize - (applyQueryPos - applyQuery),
-					 ",%s", slon_quote_identifier(colname));
-			applyQueryPos += strlen(applyQueryPos);
+			if (version->subid < subid)
+				return false;
 		}
 	}
+	return true;
+}
 
-	/*
-	 * We now need to copy this cache key into the cache context because the
-	 * hash_search() call will eventually create the hash entry pointing to
-	 * this string.
-	 */
-	oldContext = MemoryContextSwitchTo(applyCacheContext);
-	cacheKey = pstrdup(applyQuery);
-	MemoryContextSwitchTo(oldContext);
 
-/*	elog(NOTICE, "looking for key=%s", cacheKey); */
-	cacheEnt = hash_search(applyCacheHash, &cacheKey, HASH_ENTER, &found);
-	if (found)
-	{
-		apply_num_hit++;
+/*
+ * logTrigCoalesceEmit -
+ *
+ *	Log the net change of every coalesced row, in the order in which
+ *	the rows were first changed, and forget them.
+ */
+static void
+logTrigCoalesceEmit(void)
+{
+	CoalesceRow *crow;
+	CoalesceTable *tbl;
+	MemoryContext rowContext;
+	MemoryContext oldContext;
 
-		/* elog(NOTICE, "cache entry for %s found", cacheKey); */
+	if (coalesceFirst == NULL)
+		return;
 
-		/*
-		 * Free the cacheKey copy.
-		 */
-		oldContext = MemoryContextSwitchTo(applyCacheContext);
-#ifdef APPLY_CACHE_VERIFY
-		if (cacheEnt->evicted)
-			elog(ERROR, "Slony-I: query cache returned evicted entry for '%s'",
-				 cacheKey);
-		if (strcmp(cacheEnt->verifyKey, cacheKey) != 0)
-			elog(ERROR, "Slony-I: query cache key verification failed - "
-				 "searched='%s' found='%s'", cacheKey,
-				 cacheEnt->verifyKey);
-#endif
-		pfree(cacheKey);
-		MemoryContextSwitchTo(oldContext);
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logTrigCoalesceEmit()");
 
-		/*
-		 * We are reusing an existing query plan. Just move it to the end of
-		 * the list.
-		 */
-		if (cacheEnt != applyCacheTail)
+	rowContext = AllocSetContextCreate(CurrentMemoryContext,
+									   "Slony-I coalesced row",
+									   ALLOCSET_DEFAULT_MINSIZE,
+									   ALLOCSET_DEFAULT_INITSIZE,
+									   ALLOCSET_DEFAULT_MAXSIZE);
+
+	for (crow = coalesceFirst; crow != NULL; crow = crow->next)
+	{
+		CoalesceVersion *version = crow->top;
+		Slony_I_ClusterStatus *cs;
+		LogTrigCacheEntry *entry;
+		TriggerData tgdata;
+		Trigger		trigger;
+		Relation	rel;
+		text	   *cmdtype;
+		LogTrigArgs la;
+
+		if (version == NULL || (!version->existed && version->cur == NULL))
+			continue;
+
+		tbl = crow->tbl;
+		rel = RelationIdGetRelation(tbl->reloid);
+		if (!RelationIsValid(rel))
+			elog(ERROR, "Slony-I: could not open relation with OID %u",
+				 tbl->reloid);
+
+		memset(&trigger, 0, sizeof(trigger));
+		trigger.tgoid = tbl->tgoid;
+		trigger.tgnargs = 3;
+		trigger.tgargs = tbl->tgargs;
+		memset(&tgdata, 0, sizeof(tgdata));
+		tgdata.type = T_TriggerData;
+		tgdata.tg_relation = rel;
+		tgdata.tg_trigger = &trigger;
+
+		entry = logTrigCacheLookup(&tgdata);
+		RelationClose(rel);
+		if (entry->natts != tbl->tupdesc->natts)
+			elog(ERROR, "Slony-I: table %s changed while changes to it "
+				 "were coalesced",
+				 DatumGetCString(DirectFunctionCall1(textout,
+													 entry->relname)));
+		cs = entry->cs;
+		logTrigInitXact(cs);
+
+		oldContext = MemoryContextSwitchTo(rowContext);
+		if (!version->existed)
+			cmdtype = logTrigBuildRow(cs, entry, 'I', NULL, version->cur,
+									  tbl->tupdesc, &la);
+		else if (version->cur == NULL)
+			cmdtype = logTrigBuildRow(cs, entry, 'D', version->orig, NULL,
+									  tbl->tupdesc, &la);
+		else
 		{
-			/*
-			 * Remove the entry from the list
-			 */
-			if (cacheEnt->prev == NULL)
-				applyCacheHead = cacheEnt->next;
-			else
-				cacheEnt->prev->next = cacheEnt->next;
-			if (cacheEnt->next == NULL)
-				applyCacheTail = cacheEnt->prev;
-			else
-				cacheEnt->next->prev = cacheEnt->prev;
+			cmdtype = logTrigBuildRow(cs, entry, 'U', version->orig,
+									  version->cur, tbl->tupdesc, &la);
 
 			/*
-			 * Put the entry back at the end of the list.
+			 * The row was changed back to what it was, or only in
+			 * columns that are not replicated.
 			 */
-			if (applyCacheHead == NULL)
-			{
-				cacheEnt->prev = NULL;
-				cacheEnt->next = NULL;
-				applyCacheHead = cacheEnt;
-				applyCacheTail = cacheEnt;
-			}
-			else
-			{
-				cacheEnt->prev = applyCacheTail;
-				cacheEnt->next = NULL;
-				applyCacheTail->next = cacheEnt;
-				applyCacheTail = cacheEnt;
-			}
+			if (la.cmdupdncols == 0)
+				cmdtype = NULL;
 		}
+		if (cmdtype != NULL)
+			logTrigBufferRow(cs, entry, cmdtype, &la,
+							 (cs->log_buffer > 0) ? cs->log_buffer :
+							 LOG_STMT_FLUSH_ROWS);
+		MemoryContextSwitchTo(oldContext);
+		MemoryContextReset(rowContext);
 	}
-	else
-	{
-		Datum		query_args[2];
 
-		apply_num_prepare++;
+	MemoryContextDelete(rowContext);
+	SPI_finish();
 
-		/* elog(NOTICE, "cache entry for %s NOT found", cacheKey); */
+	MemoryContextDelete(coalesceContext);
+	coalesceContext = NULL;
+	logTrigCoalesceReset();
+}
 
-		/*
-		 * Allocate memory for the function call info to cast all datums from
-		 * TEXT to the required Datum type.
-		 */
-		oldContext = MemoryContextSwitchTo(applyCacheContext);
-		cacheEnt->finfo_input = (FmgrInfo *) palloc(sizeof(FmgrInfo) * (cmdargsn / 2));
-		cacheEnt->typioparam = (Oid *) palloc(sizeof(Oid) * (cmdargsn / 2));
-		cacheEnt->typmod = (int32 *) palloc(sizeof(int32) * (cmdargsn / 2));
-		MemoryContextSwitchTo(oldContext);
 
-		if (cacheEnt->finfo_input == NULL || cacheEnt->typioparam == NULL ||
-			cacheEnt->typmod == NULL)
-			elog(ERROR, "Slony-I: out of memory in logApply()");
+/*
+ * logTrigCoalesceReset -
+ *
+ *	Forget all coalesced rows. Their memory is freed by the caller.
+ */
+static void
+logTrigCoalesceReset(void)
+{
+	coalesceHash = NULL;
+	coalesceTables = NULL;
+	coalesceFirst = NULL;
+	coalesceLast = NULL;
+	coalesceMaxSubid = InvalidSubTransactionId;
+}
+#endif   /* HAVE_XACT_EVENT_PRE_COMMIT */
 
-#ifdef APPLY_CACHE_VERIFY
 
-		/*
-		 * Save a second copy of the query key for verification/debugging
-		 */
-		oldContext = MemoryContextSwitchTo(applyCacheContext);
-		cacheEnt->verifyKey = pstrdup(cacheKey);
-		MemoryContextSwitchTo(oldContext);
-		cacheEnt->evicted = 0;
-#endif
+/*
+ * logTrigSameVarlena -
+ *
+ *	Tell if two varlena values have the same stored image. For values
+ *	stored out of line this compares the toast pointers, so neither
+ *	value needs to be fetched or decompressed. A false result does
+ *	not mean that the values differ.
+ */
+static bool
+logTrigSameVarlena(Datum old_value, Datum new_value)
+{
+	char	   *old_ptr = DatumGetPointer(old_value);
+	char	   *new_ptr = DatumGetPointer(new_value);
+	Size		len;
 
-		/*
-		 * Find the target relation in the system cache. We need this to find
-		 * the data types of the target columns for casting.
-		 */
-#ifdef HAS_LOOKUPEXPLICITNAMESPACE_2
-		target_rel = RelationIdGetRelation(
-										   get_relname_relid(relname,
-								   LookupExplicitNamespace(nspname, false)));
-#else
-		target_rel = RelationIdGetRelation(
-			   get_relname_relid(relname, LookupExplicitNamespace(nspname)));
-#endif
-		if (target_rel == NULL)
-			elog(ERROR, "Slony-I: cannot find table %s.%s in logApply()",
-				 slon_quote_identifier(nspname),
-				 slon_quote_identifier(relname));
+	if (old_ptr == new_ptr)
+		return true;
 
-		/*
-		 * Create the saved SPI plan for this query
-		 */
-		applyQueryReset();
+	/*
+	 * Only on-disk toast pointers identify the value they point to.
+	 */
+	if ((VARATT_IS_EXTERNAL(old_ptr) && !VARATT_IS_EXTERNAL_ONDISK(old_ptr)) ||
+		(VARATT_IS_EXTERNAL(new_ptr) && !VARATT_IS_EXTERNAL_ONDISK(new_ptr)))
+		return false;
 
-		/*
-		 * Build the query string and parameter type array for the
-		 * SPI_prepare() call.
-		 */
-		switch (cmdtype)
-		{
-			case 'I':
+	len = VARSIZE_ANY(old_ptr);
+	if (len != VARSIZE_ANY(new_ptr))
+		return false;
 
-				/*
-				 * INSERT
-				 */
-				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
-				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+	return (memcmp(old_ptr, new_ptr, len) == 0);
+}
 
-				sprintf(applyQueryPos, "INSERT INTO %s.%s (",
-						slon_quote_identifier(nspname),
-						slon_quote_identifier(relname));
-				applyQueryPos += strlen(applyQueryPos);
 
-				/*
-				 * Construct the list of quoted column names.
-				 */
-				for (i = 0; i < cmdargsn; i += 2)
-				{
-					char	   *colname;
+/*
+ * logTrigArgsInit -
+ *
+ *	Prepare an empty set of log row arrays for up to maxpairs
+ *	column name/value pairs.
+ */
+static void
+logTrigArgsInit(LogTrigArgs * la, int maxpairs, bool binary)
+{
+	la->binary = binary;
+	la->nargs = 0;
+	la->cmdupdncols = 0;
+	la->args = (Datum *) palloc(sizeof(Datum) * maxpairs * 2);
+	la->argnulls = (bool *) palloc(sizeof(bool) * maxpairs * 2);
+	if (binary)
+	{
+		la->binargs = (Datum *) palloc(sizeof(Datum) * maxpairs);
+		la->binnulls = (bool *) palloc(sizeof(bool) * maxpairs);
+	}
+	else
+	{
+		la->binargs = NULL;
+		la->binnulls = NULL;
+	}
+}
 
-					applyQueryIncrease();
 
-					if (i > 0)
-					{
-						strcpy(applyQueryPos, ", ");
-						applyQueryPos += 2;
-					}
+/*
+ * logTrigArgsAdd -
+ *
+ *	Append a column name/value pair to the log row arrays. In the
+ *	binary format, values of types that have a portable send/recv
+ *	representation go into log_cmdbinargs and leave a NULL in the
+ *	value slot of log_cmdargs. All other values stay text.
+ */
+static void
+logTrigArgsAdd(LogTrigArgs * la, LogTrigCacheAtt * att,
+			   Datum value, bool isnull)
+{
+	int			pair = la->nargs / 2;
 
-					if (cmdargsnulls[i])
-						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
-					querycolnames[i / 2] = DatumGetCString(DirectFunctionCall1(
-													   textout, cmdargs[i]));
-					colname = (char *) slon_quote_identifier(querycolnames[i / 2]);
-					strcpy(applyQueryPos, colname);
-					applyQueryPos += strlen(applyQueryPos);
-				}
+	la->args[la->nargs] = att->colname;
+	la->argnulls[la->nargs++] = false;
 
-				/*
-				 * Add ") VALUES ("
-				 */
-				strcpy(applyQueryPos, ") VALUES (");
-				applyQueryPos += strlen(applyQueryPos);
+	if (la->binary)
+	{
+		la->binargs[pair] = (Datum) 0;
+		la->binnulls[pair] = true;
+	}
 
-				/*
-				 * Add $n::<coltype> placeholders for all the values.
-				 */
-				for (i = 0; i < cmdargsn; i += 2)
-				{
-					int			colnum;
-					Oid			coltype;
-					Oid			typinput;
+	if (isnull)
+	{
+		la->args[la->nargs] = (Datum) 0;
+		la->argnulls[la->nargs++] = true;
+	}
+	else if (la->binary && att->sendbinary)
+	{
+		la->args[la->nargs] = (Datum) 0;
+		la->argnulls[la->nargs++] = true;
+		la->binargs[pair] = logTrigBinaryValue(att, value);
+		la->binnulls[pair] = false;
+	}
+	else
+	{
+		la->args[la->nargs] = DirectFunctionCall1(textin,
+									CStringGetDatum(OutputFunctionCall(
+												  &(att->outfunc), value)));
+		la->argnulls[la->nargs++] = false;
+	}
+}
 
-					applyQueryIncrease();
 
-					/*
-					 * Lookup the column data type in the target relation and
-					 * remember everything we need to know later to cast TEXT
-					 * to the correct column Datum.
-					 */
-					colnum = SPI_fnumber(target_rel->rd_att, querycolnames[i / 2]);
-					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
-					if (coltype == InvalidOid)
-						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
-							 querycolnames[i / 2]);
-					getTypeInputInfo(coltype, &typinput,
-									 &(cacheEnt->typioparam[i / 2]));
-					oldContext = MemoryContextSwitchTo(applyCacheContext);
-					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
-					MemoryContextSwitchTo(oldContext);
-					cacheEnt->typmod[i / 2] =
-						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
+/*
+ * logTrigBinaryValue -
+ *
+ *	Return the log_cmdbinargs element for a value. This is the type
+ *	OID in network byte order followed by the output of the type's
+ *	send function, so that a subscriber can tell if the column type
+ *	differs on its side.
+ */
+static Datum
+logTrigBinaryValue(LogTrigCacheAtt * att, Datum value)
+{
+	bytea	   *sent;
+	bytea	   *result;
+	unsigned char *p;
+	int			len;
 
-					/*
-					 * Add the parameter to the query string
-					 */
-					sprintf(applyQueryPos, "%s$%d", (i == 0) ? "" : ", ",
-							i / 2 + 1);
-					applyQueryPos += strlen(applyQueryPos);
+	sent = SendFunctionCall(&(att->sendfunc), value);
+	len = VARSIZE(sent) - VARHDRSZ;
 
-					querytypes[i / 2] = coltype;
-				}
+	result = (bytea *) palloc(VARHDRSZ + 4 + len);
+	SET_VARSIZE(result, VARHDRSZ + 4 + len);
+	p = (unsigned char *) VARDATA(result);
+	p[0] = (unsigned char) ((att->typid >> 24) & 0xff);
+	p[1] = (unsigned char) ((att->typid >> 16) & 0xff);
+	p[2] = (unsigned char) ((att->typid >> 8) & 0xff);
+	p[3] = (unsigned char) (att->typid & 0xff);
+	memcpy(p + 4, VARDATA(sent), len);
+	pfree(sent);
 
-				/*
-				 * Finish the query string
-				 */
-				strcpy(applyQueryPos, ");");
-				applyQueryPos += 2;
-				querynvals = cmdargsn / 2;
+	return PointerGetDatum(result);
+}
 
-				break;
 
-			case 'U':
+/*
+ * slon_binary_type -
+ *
+ *	Built in types whose send/recv representation does not depend on
+ *	the client encoding or any other session setting and is the same
+ *	in all supported PostgreSQL versions. Only values of these types
+ *	are captured in binary. The time, timestamp and interval types are
+ *	left out because their send format depends on integer_datetimes.
+ */
+static bool
+slon_binary_type(Oid typid)
+{
+	switch (typid)
+	{
+		case BOOLOID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case OIDOID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		case CASHOID:
+		case DATEOID:
+		case BYTEAOID:
+		case UUIDOID:
+		case INETOID:
+		case CIDROID:
+		case MACADDROID:
+		case BITOID:
+		case VARBITOID:
+			return true;
 
-				/*
-				 * UPDATE
-				 */
-				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
-				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+		default:
+			return false;
+	}
+}
 
-				sprintf(applyQueryPos, "UPDATE ONLY %s.%s SET ",
-						slon_quote_identifier(nspname),
-						slon_quote_identifier(relname));
-				applyQueryPos += strlen(applyQueryPos);
 
-				/*
-				 * This can all be done in one pass over the cmdargs array. We
-				 * just have to switch the behavior slightly between the SET
-				 * clause and the WHERE clause.
-				 */
-				for (i = 0; i < cmdargsn; i += 2)
-				{
-					char	   *colname;
-					int			colnum;
-					Oid			coltype;
-					Oid			typinput;
+/*
+ * slon_datestyle_type -
+ *
+ *	Tell if the text output of a type may depend on the DateStyle.
+ *	Arrays and domains are looked through. Composite, range and user
+ *	defined types might contain date/time values, so we assume they
+ *	do.
+ */
+static bool
+slon_datestyle_type(Oid typid)
+{
+	Oid			elemtype;
+	char		typtype;
 
-					applyQueryIncrease();
+	typid = getBaseType(typid);
 
-					/*
-					 * Get the column name and data type as well as everything
-					 * needed later to cast TEXT to the correct input Datum.
-					 */
-					if (cmdargsnulls[i])
-						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
-					colname = DatumGetCString(DirectFunctionCall1(
-													   textout, cmdargs[i]));
-					colnum = SPI_fnumber(target_rel->rd_att, colname);
-					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
-					if (coltype == InvalidOid)
-						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
-							 colname);
-					getTypeInputInfo(coltype, &typinput,
-									 &(cacheEnt->typioparam[i / 2]));
-					oldContext = MemoryContextSwitchTo(applyCacheContext);
-					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
-					MemoryContextSwitchTo(oldContext);
-					cacheEnt->typmod[i / 2] =
-						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
+	switch (typid)
+	{
+		case DATEOID:
+		case TIMEOID:
+		case TIMETZOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case INTERVALOID:
+#ifdef ABSTIMEOID
+		case ABSTIMEOID:
+		case RELTIMEOID:
+		case TINTERVALOID:
+#endif
+			return true;
 
-					/*
-					 * Special case if there were no columns updated. We tell
-					 * it to set the first PK column to itself.
-					 */
-					if (cmdupdncols == 0 && i == 0)
-					{
-						sprintf(applyQueryPos, "%s = %s",
-								slon_quote_identifier(colname),
-								slon_quote_identifier(colname));
-						applyQueryPos += strlen(applyQueryPos);
-					}
+		default:
+			break;
+	}
 
-					/*
-					 * If we are at the transition point from SET to WHERE,
-					 * add the WHERE keyword.
-					 */
-					if (i == cmdupdncols * 2)
-					{
-						strcpy(applyQueryPos, " WHERE ");
-						applyQueryPos += 7;
-					}
+	elemtype = get_element_type(typid);
+	if (OidIsValid(elemtype))
+		return slon_datestyle_type(elemtype);
 
-					if (i < cmdupdncols * 2)
-					{
-						/*
-						 * This is inside the SET clause. Add the <colname> =
-						 * $n::<coltype> separated by comma.
-						 */
-						sprintf(applyQueryPos, "%s%s = $%d",
-								(i > 0) ? ", " : "",
-								slon_quote_identifier(colname),
-								i / 2 + 1);
-					}
-					else
-					{
-						/*
-						 * This is in the WHERE clause. Same as above but
-						 * separated by AND.
-						 */
-						sprintf(applyQueryPos, "%s%s = $%d",
-								(i > cmdupdncols * 2) ? " AND " : "",
-								slon_quote_identifier(colname),
-								i / 2 + 1);
-					}
-					applyQueryPos += strlen(applyQueryPos);
+	typtype = get_typtype(typid);
+	if (typtype == 'c' || typtype == 'r')
+		return true;
 
-					querytypes[i / 2] = coltype;
-				}
+	return (typid >= FirstNormalObjectId);
+}
 
-				strcpy(applyQueryPos, ";");
-				applyQueryPos += 1;
-				querynvals = cmdargsn / 2;
 
-				break;
+/*
+ * logTrigCacheLookup -
+ *
+ *	Return the (possibly newly built) logTrigger() cache entry for
+ *	the relation and trigger of the current trigger call. Must be
+ *	called while connected to the SPI manager.
+ */
+static LogTrigCacheEntry *
+logTrigCacheLookup(TriggerData *tg)
+{
+	LogTrigCacheKey key;
+	LogTrigCacheEntry *entry;
+	bool		found;
 
-			case 'D':
+	if (logTrigCacheHash == NULL)
+	{
+		HASHCTL		hctl;
+		static bool callbacks_registered = false;
 
-				/*
-				 * DELETE
-				 */
-				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
-				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+		memset(&hctl, 0, sizeof(hctl));
+		hctl.keysize = sizeof(LogTrigCacheKey);
+		hctl.entrysize = sizeof(LogTrigCacheEntry);
+		hctl.hash = tag_hash;
+		hctl.hcxt = CacheMemoryContext;
+		logTrigCacheHash = hash_create("Slony-I logTrigger cache",
+									   64, &hctl,
+									HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
 
-				sprintf(applyQueryPos, "DELETE FROM ONLY %s.%s WHERE ",
-						slon_quote_identifier(nspname),
-						slon_quote_identifier(relname));
-				applyQueryPos += strlen(applyQueryPos);
+		/*
+		 * Invalidation callbacks cannot be unregistered, so they are
+		 * only registered once per backend and survive resetSession().
+		 */
+		if (!callbacks_registered)
+		{
+			CacheRegisterRelcacheCallback(logTrigCacheRelCallback,
+										  (Datum) 0);
+			CacheRegisterSyscacheCallback(NAMESPACEOID,
+										  logTrigCacheNspCallback,
+										  (Datum) 0);
+			callbacks_registered = true;
+		}
+	}
 
-				for (i = 0; i < cmdargsn; i += 2)
-				{
-					int			colnum;
-					char	   *colname;
-					Oid			coltype;
-					Oid			typinput;
+	/*
+	 * Get rid of entries invalidated since the last call. This cannot
+	 * be done in the callbacks themselves because they can fire while
+	 * an entry is in use.
+	 */
+	if (logTrigCacheStale)
+	{
+		HASH_SEQ_STATUS status;
 
-					applyQueryIncrease();
+		logTrigCacheStale = false;
+		hash_seq_init(&status, logTrigCacheHash);
+		while ((entry = (LogTrigCacheEntry *) hash_seq_search(&status)) != NULL)
+		{
+			if (entry->valid)
+				continue;
+			logTrigCacheRelease(entry);
+			hash_search(logTrigCacheHash, &(entry->key), HASH_REMOVE, NULL);
+		}
+	}
 
-					/*
-					 * Add <colname> = $n separated by comma.
-					 */
-					if (cmdargsnulls[i])
-						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
-					colname = DatumGetCString(DirectFunctionCall1(
-													   textout, cmdargs[i]));
-					colnum = SPI_fnumber(target_rel->rd_att, colname);
-					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
-					if (coltype == InvalidOid)
-						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
-							 colname);
-					getTypeInputInfo(coltype, &typinput,
-									 &(cacheEnt->typioparam[i / 2]));
-					oldContext = MemoryContextSwitchTo(applyCacheContext);
-					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
-					MemoryContextSwitchTo(oldContext);
-					cacheEnt->typmod[i / 2] =
-						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
-					sprintf(applyQueryPos, "%s%s = $%d",
-							(i > 0) ? " AND " : "",
-							slon_quote_identifier(colname),
-							i / 2 + 1);
+	key.reloid = RelationGetRelid(tg->tg_relation);
+	key.tgoid = tg->tg_trigger->tgoid;
 
-					applyQueryPos += strlen(applyQueryPos);
+	entry = (LogTrigCacheEntry *) hash_search(logTrigCacheHash, &key,
+											  HASH_ENTER, &found);
+	if (found && entry->ready && entry->valid &&
+		entry->natts == tg->tg_relation->rd_att->natts)
+		return entry;
 
-					querytypes[i / 2] = coltype;
-				}
+	/*
+	 * New entry or one whose previous build did not complete.
+	 */
+	if (!found)
+	{
+		entry->mcxt = NULL;
+		entry->filter_plan = NULL;
+	}
+	logTrigCacheBuild(entry, tg);
 
-				strcpy(applyQueryPos, ";");
-				applyQueryPos += 1;
+	return entry;
+}
 
-				querynvals = cmdargsn / 2;
 
-				break;
+/*
+ * logTrigCacheBuild -
+ *
+ *	(Re)build a logTrigger() cache entry from the trigger arguments
+ *	and the relation's tuple descriptor.
+ */
+static void
+logTrigCacheBuild(LogTrigCacheEntry * entry, TriggerData *tg)
+{
+	TupleDesc	tupdesc = tg->tg_relation->rd_att;
+	MemoryContext oldContext;
+	Name		cluster_name;
+	char	   *attkind;
+	int			attkind_idx;
+	bool		attkind_done = false;
+	StringInfoData query;
+	char	   *filter = NULL;
+	int			i;
 
-			case 'T':
+	logTrigCacheRelease(entry);
+	entry->ready = false;
 
-				/*
-				 * TRUNCATE
-				 */
-				querytypes = (Oid *) palloc(sizeof(Oid) * 2);
+	/*
+	 * Set valid before doing anything that might process invalidation
+	 * messages, so that a concurrent invalidation is not lost.
+	 */
+	entry->valid = true;
 
-				sprintf(applyQueryPos, "TRUNCATE ONLY %s.%s CASCADE ;",
-						slon_quote_identifier(nspname),
-						slon_quote_identifier(relname));
+	/*
+	 * Get all the trigger arguments and the cluster status. The latter
+	 * may prepare SPI plans, so do it before switching memory contexts.
+	 */
+	cluster_name = DatumGetName(DirectFunctionCall1(namein,
+								CStringGetDatum(tg->tg_trigger->tgargs[0])));
+	entry->cs = getClusterStatus(cluster_name, PLAN_INSERT_LOG_STATUS);
+	entry->tab_id = strtol(tg->tg_trigger->tgargs[1], NULL, 10);
+	attkind = tg->tg_trigger->tgargs[2];
 
-				querynvals = 0;
+	/*
+	 * Look up the row filter of the table and whether its changes are
+	 * coalesced.
+	 */
+	initStringInfo(&query);
+	appendStringInfo(&query,
+					 "select tab_filter, tab_coalesce from %s.sl_table "
+					 "where tab_id = %d",
+					 entry->cs->clusterident, entry->tab_id);
+	if (SPI_exec(query.data, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Slony-I: cannot read sl_table entry of table %d",
+			 entry->tab_id);
+	entry->coalesce = false;
+	if (SPI_processed == 1)
+	{
+		bool		isnull;
 
-				break;
+		filter = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+		entry->coalesce = DatumGetBool(SPI_getbinval(SPI_tuptable->vals[0],
+									   SPI_tuptable->tupdesc, 2, &isnull));
+		if (isnull)
+			entry->coalesce = false;
+#endif
+	}
+	SPI_freetuptable(SPI_tuptable);
 
-			default:
-				elog(ERROR, "Slony-I: unhandled log cmdtype '%c' in logApply()",
-					 cmdtype);
-				break;
+	entry->mcxt = AllocSetContextCreate(CacheMemoryContext,
+										"Slony-I logTrigger cache entry",
+										ALLOCSET_SMALL_MINSIZE,
+										ALLOCSET_SMALL_INITSIZE,
+										ALLOCSET_SMALL_MAXSIZE);
+	oldContext = MemoryContextSwitchTo(entry->mcxt);
+
+	entry->nspname = DirectFunctionCall1(textin,
+										 CStringGetDatum(get_namespace_name(
+									RelationGetNamespace(tg->tg_relation))));
+	entry->relname = DirectFunctionCall1(textin,
+				  CStringGetDatum(RelationGetRelationName(tg->tg_relation)));
+
+	entry->anyexcluded = false;
+	entry->anybinary = false;
+	entry->datestyle_any = false;
+	entry->datestyle_text = false;
+	entry->natts = tupdesc->natts;
+	entry->atts = (LogTrigCacheAtt *) palloc0(sizeof(LogTrigCacheAtt) *
+											  (entry->natts + 1));
+
+	/*
+	 * The attkind argument has one character per not dropped column: 'k'
+	 * for key columns, 'v' for other columns and 'x' for columns that
+	 * are not replicated at all. Trailing 'v' characters are omitted.
+	 */
+	attkind_idx = -1;
+	for (i = 0; i < entry->natts; i++)
+	{
+		LogTrigCacheAtt *att = &(entry->atts[i]);
+		Form_pg_attribute attr = tupdesc->attrs[i];
+		Oid			typoutput;
+		bool		typisvarlena;
+		Oid			opr_oid;
+
+		if (attr->attisdropped)
+		{
+			att->isdropped = true;
+			continue;
+		}
+
+		if (!attkind_done)
+		{
+			attkind_idx++;
+			if (attkind[attkind_idx] == '\0')
+				attkind_done = true;
+			else
+			{
+				att->iskey = (attkind[attkind_idx] == 'k');
+				att->excluded = (attkind[attkind_idx] == 'x');
+			}
+		}
+		if (att->excluded)
+		{
+			entry->anyexcluded = true;
+			continue;
 		}
 
+		att->colname = DirectFunctionCall1(textin,
+									 CStringGetDatum(NameStr(attr->attname)));
+
+		getTypeOutputInfo(attr->atttypid, &typoutput, &typisvarlena);
+		fmgr_info_cxt(typoutput, &(att->outfunc), entry->mcxt);
+
 		/*
-		 * Close the target relation.
+		 * Remember the send function for the binary capture format.
 		 */
-		RelationClose(target_rel);
+		att->typid = attr->atttypid;
+		att->typlen = attr->attlen;
+		if (slon_binary_type(attr->atttypid))
+		{
+			Oid			typsend;
+
+			getTypeBinaryOutputInfo(attr->atttypid, &typsend, &typisvarlena);
+			fmgr_info_cxt(typsend, &(att->sendfunc), entry->mcxt);
+			att->sendbinary = true;
+			entry->anybinary = true;
+		}
 
 		/*
-		 * Prepare the saved SPI query plan.
+		 * Remember if the text output of the column depends on the
+		 * DateStyle.
 		 */
-		cacheEnt->plan = SPI_saveplan(
-							SPI_prepare(applyQuery, querynvals, querytypes));
-		if (cacheEnt->plan == NULL)
-			elog(ERROR, "Slony-I: SPI_prepare() failed for query '%s'",
-				 applyQuery);
-/*	elog(NOTICE, "key=%s nvals=%d query=%s ", cacheEnt->verifyKey, querynvals, applyQuery); */
+		if (slon_datestyle_type(attr->atttypid))
+		{
+			entry->datestyle_any = true;
+			if (!att->sendbinary)
+				entry->datestyle_text = true;
+		}
 
 		/*
-		 * Add the plan to the double linked LRU list
+		 * Lookup the equal operator using the typecache if available
 		 */
-		if (applyCacheHead == NULL)
+#ifdef HAVE_TYPCACHE
 		{
-			cacheEnt->prev = NULL;
-			cacheEnt->next = NULL;
-			applyCacheHead = cacheEnt;
-			applyCacheTail = cacheEnt;
+			TypeCacheEntry *type_cache;
+
+			type_cache = lookup_type_cache(attr->atttypid, TYPECACHE_EQ_OPR);
+			opr_oid = type_cache->eq_opr;
+			if (opr_oid == ARRAY_EQ_OP)
+				opr_oid = InvalidOid;
+			if (OidIsValid(opr_oid))
+				opr_oid = get_opcode(opr_oid);
 		}
-		else
+#else
+		opr_oid = compatible_oper_funcid(makeList1(makeString("=")),
+										 attr->atttypid, attr->atttypid,
+										 true);
+#endif
+		if (OidIsValid(opr_oid))
 		{
-			cacheEnt->prev = applyCacheTail;
-			cacheEnt->next = NULL;
-			applyCacheTail->next = cacheEnt;
-			applyCacheTail = cacheEnt;
+			fmgr_info_cxt(opr_oid, &(att->eqfunc), entry->mcxt);
+			att->haveeq = true;
 		}
-		applyCacheUsed++;
+	}
 
-		/*
-		 * If that pushes us over the maximum allowed cached plans, evict the
-		 * one that wasn't used the longest.
-		 */
-		if (applyCacheUsed > applyCacheSize)
-		{
-			ApplyCacheEntry *evict = applyCacheHead;
+	MemoryContextSwitchTo(oldContext);
 
-			apply_num_evict++;
+	/*
+	 * Prepare the row filter once. It is evaluated against a subselect
+	 * that exposes the values of the row under the column names, so
+	 * the filter can be written like a WHERE clause on the table.
+	 */
+	entry->filter_nargs = 0;
+	if (filter != NULL)
+	{
+		Oid		   *argtypes;
+		void	   *plan;
 
-			SPI_freeplan(evict->plan);
-			oldContext = MemoryContextSwitchTo(applyCacheContext);
-			pfree(evict->finfo_input);
-			pfree(evict->typioparam);
-			pfree(evict->typmod);
-			MemoryContextSwitchTo(oldContext);
-			evict->finfo_input = NULL;
-			evict->typioparam = NULL;
-			evict->typmod = NULL;
-			evict->plan = NULL;
-#ifdef APPLY_CACHE_VERIFY
-			evict->evicted = 1;
-#endif
+		argtypes = (Oid *) palloc(sizeof(Oid) * (entry->natts + 1));
+		resetStringInfo(&query);
+		appendStringInfo(&query, "select (%s)::boolean from (select ", filter);
+		for (i = 0; i < entry->natts; i++)
+		{
+			Form_pg_attribute attr = tupdesc->attrs[i];
 
-			if (evict->prev == NULL)
-				applyCacheHead = evict->next;
-			else
-				evict->prev->next = evict->next;
-			if (evict->next == NULL)
-				applyCacheTail = evict->prev;
-			else
-				evict->next->prev = evict->prev;
+			if (attr->attisdropped)
+				continue;
+			appendStringInfo(&query, "%s$%d as %s",
+							 (entry->filter_nargs > 0) ? ", " : "",
+							 entry->filter_nargs + 1,
+							 quote_identifier(NameStr(attr->attname)));
+			argtypes[entry->filter_nargs++] = attr->atttypid;
+		}
+		appendStringInfo(&query, ") as %s",
+			 quote_identifier(RelationGetRelationName(tg->tg_relation)));
+
+		plan = SPI_prepare(query.data, entry->filter_nargs, argtypes);
+		if (plan == NULL)
+			elog(ERROR, "Slony-I: cannot prepare row filter of table %d: %s",
+				 entry->tab_id, SPI_result_code_string(SPI_result));
+		entry->filter_plan = SPI_saveplan(plan);
+		SPI_freeplan(plan);
+		pfree(argtypes);
+	}
+	pfree(query.data);
 
-			hash_search(applyCacheHash, &(evict->queryKey), HASH_REMOVE, &found);
-			if (!found)
-				elog(ERROR, "Slony-I: cached queries hash entry not found "
-					 "on evict");
+	entry->ready = true;
+}
 
-			applyCacheUsed--;
-		}
 
-		/*
-		 * We also need to determine if this table belongs to a set, that we
-		 * are a forwarder of.
-		 */
-		query_args[0] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_tableid"), &isnull);
-		query_args[1] = Int32GetDatum(cs->localNodeId);
+/*
+ * logTrigCacheRelease -
+ *
+ *	Free what a logTrigger() cache entry holds.
+ */
+static void
+logTrigCacheRelease(LogTrigCacheEntry * entry)
+{
+	if (entry->filter_plan != NULL)
+		SPI_freeplan(entry->filter_plan);
+	entry->filter_plan = NULL;
+	if (entry->mcxt != NULL)
+		MemoryContextDelete(entry->mcxt);
+	entry->mcxt = NULL;
+}
 
-		if (SPI_execp(cs->plan_table_info, query_args, NULL, 0) < 0)
-			elog(ERROR, "SPI_execp() failed for table forward lookup");
 
-		if (SPI_processed != 1)
-			elog(ERROR, "forwarding lookup for table %d failed",
-				 DatumGetInt32(query_args[1]));
+/*
+ * logTrigFilterCmd -
+ *
+ *	Apply the row filter of the table to one captured row and return
+ *	the command to log for it, or '\0' if nothing is to be logged. An
+ *	UPDATE that moves a row into or out of the filtered set is logged
+ *	as INSERT or DELETE, so the subscribers only ever hold the rows
+ *	that pass the filter.
+ */
+static char
+logTrigFilterCmd(LogTrigCacheEntry * entry, char cmdtype,
+				 HeapTuple old_row, HeapTuple new_row, TupleDesc tupdesc)
+{
+	bool		old_match;
+	bool		new_match;
 
-		cacheEnt->forward = DatumGetBool(
-				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
-				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
-	}
+	if (entry->filter_plan == NULL)
+		return cmdtype;
 
-	/*
-	 * We now have a cached SPI plan. Construct the call parameter and null
-	 * flag arrays.
-	 */
 	switch (cmdtype)
 	{
 		case 'I':
-		case 'U':
+			return logTrigFilterRow(entry, new_row, tupdesc) ? 'I' : '\0';
+
 		case 'D':
+			return logTrigFilterRow(entry, old_row, tupdesc) ? 'D' : '\0';
 
-			/*
-			 * INSERT, UPDATE and DELETE
-			 */
-			queryvals = (Datum *) palloc(sizeof(Datum) * cmdargsn / 2);
-			querynulls = (char *) palloc(cmdargsn / 2 + 1);
+		case 'U':
+			old_match = logTrigFilterRow(entry, old_row, tupdesc);
+			new_match = logTrigFilterRow(entry, new_row, tupdesc);
+			if (old_match && new_match)
+				return 'U';
+			if (new_match)
+				return 'I';
+			if (old_match)
+				return 'D';
+			return '\0';
 
-			for (i = 0; i < cmdargsn; i += 2)
-			{
-				char	   *tmpval;
+		default:
+			break;
+	}
 
-				if (cmdargsnulls[i + 1])
-				{
-					queryvals[i / 2] = (Datum) 0;
-					querynulls[i / 2] = 'n';
-				}
-				else
-				{
-					tmpval = DatumGetCString(DirectFunctionCall1(textout,
-															cmdargs[i + 1]));
-					queryvals[i / 2] = InputFunctionCall(
-											 &(cacheEnt->finfo_input[i / 2]),
-														 tmpval,
-												 cacheEnt->typioparam[i / 2],
-													cacheEnt->typmod[i / 2]);
-					pfree(tmpval);
-					querynulls[i / 2] = ' ';
-				}
-			}
-			querynulls[cmdargsn / 2] = '\0';
+	return cmdtype;
+}
 
-			break;
 
-		case 'T':
+/*
+ * logTrigFilterRow -
+ *
+ *	Evaluate the prepared row filter for one row version.
+ */
+static bool
+logTrigFilterRow(LogTrigCacheEntry * entry, HeapTuple row, TupleDesc tupdesc)
+{
+	Datum	   *values;
+	char	   *nulls;
+	Datum		result;
+	bool		isnull;
+	int			i;
+	int			j = 0;
 
-			/*
-			 * TRUNCATE
-			 */
+	values = (Datum *) palloc(sizeof(Datum) * (entry->filter_nargs + 1));
+	nulls = (char *) palloc(entry->filter_nargs + 1);
+	for (i = 0; i < entry->natts; i++)
+	{
+		if (entry->atts[i].isdropped)
+			continue;
+		values[j] = heap_getattr(row, i + 1, tupdesc, &isnull);
+		nulls[j] = isnull ? 'n' : ' ';
+		j++;
+	}
 
-			break;
+	if (SPI_execp(entry->filter_plan, values, nulls, 1) != SPI_OK_SELECT ||
+		SPI_processed != 1)
+		elog(ERROR, "Slony-I: cannot evaluate row filter of table %d",
+			 entry->tab_id);
+	result = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1,
+						   &isnull);
+	SPI_freetuptable(SPI_tuptable);
 
-		default:
-			elog(ERROR, "Slony-I: unhandled log cmdtype '%c' in logApply()",
-				 cmdtype);
-			break;
+	pfree(values);
+	pfree(nulls);
+
+	return !isnull && DatumGetBool(result);
+}
+
+
+/*
+ * logTrigCacheFlush -
+ *
+ *	Throw away the entire logTrigger() cache.
+ */
+static void
+logTrigCacheFlush(void)
+{
+	HASH_SEQ_STATUS status;
+	LogTrigCacheEntry *entry;
+
+	if (logTrigCacheHash == NULL)
+		return;
+
+	hash_seq_init(&status, logTrigCacheHash);
+	while ((entry = (LogTrigCacheEntry *) hash_seq_search(&status)) != NULL)
+		logTrigCacheRelease(entry);
+	hash_destroy(logTrigCacheHash);
+	logTrigCacheHash = NULL;
+	logTrigCacheStale = false;
+}
+
+
+/*
+ * logTrigCacheRelCallback -
+ *
+ *	Relcache invalidation callback. Marks the cache entries of the
+ *	relation (or all of them) as invalid.
+ */
+static void
+logTrigCacheRelCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	LogTrigCacheEntry *entry;
+
+	if (logTrigCacheHash == NULL)
+		return;
+
+	hash_seq_init(&status, logTrigCacheHash);
+	while ((entry = (LogTrigCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (relid == InvalidOid || entry->key.reloid == relid)
+		{
+			entry->valid = false;
+			logTrigCacheStale = true;
+		}
 	}
+}
+
+
+/*
+ * logTrigCacheNspCallback -
+ *
+ *	Syscache invalidation callback for pg_namespace. A renamed schema
+ *	does not cause relcache invalidations of the tables in it, but
+ *	the cache holds the namespace name. Since this is rare we simply
+ *	invalidate everything.
+ */
+#ifdef HAVE_SYSCACHECALLBACK_HASHVALUE
+static void
+logTrigCacheNspCallback(Datum arg, int cacheid, uint32 hashvalue)
+#else
+static void
+logTrigCacheNspCallback(Datum arg, int cacheid, ItemPointer tuplePtr)
+#endif
+{
+	logTrigCacheRelCallback(arg, InvalidOid);
+}
 
-/*	elog(NOTICE, "using key=%s nvals=%d", cacheEnt->verifyKey, cmdargsn / 2); */
+
+Datum
+versionFunc(denyAccess) (PG_FUNCTION_ARGS)
+{
+	TriggerData *tg;
 
 	/*
-	 * Execute the query.
+	 * Get the trigger call context
 	 */
-	if ((spi_rc = SPI_execp(cacheEnt->plan, queryvals, querynulls, 0)) < 0)
-		elog(ERROR, "Slony-I: SPI_execp() failed - rc=%d", spi_rc);
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "Slony-I: denyAccess() not called as trigger");
+	tg = (TriggerData *) (fcinfo->context);
 
 	/*
-	 * Count operations
+	 * Check all logTrigger() calling conventions
 	 */
-	switch (cmdtype)
+	if (!TRIGGER_FIRED_BEFORE(tg->tg_event))
+		elog(ERROR, "Slony-I: denyAccess() must be fired BEFORE");
+	if (!TRIGGER_FIRED_FOR_ROW(tg->tg_event))
+		elog(ERROR, "Slony-I: denyAccess() must be fired FOR EACH ROW");
+	if (tg->tg_trigger->tgnargs != 1)
+		elog(ERROR, "Slony-I: denyAccess() must be defined with 1 arg");
+
+	/*
+	 * Connect to the SPI manager
+	 */
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in denyAccess()");
+
+	/*
+	 * If the replication role is: ORIGIN - default role --> FAIL REPLICA -
+	 * this trigger will not fire in --> N/A LOCAL - role when running "local
+	 * updates" --> PERMIT UPDATE
+	 */
+	if (SessionReplicationRole == SESSION_REPLICATION_ROLE_ORIGIN)
+		elog(ERROR,
+			 "Slony-I: Table %s is replicated and cannot be "
+			 "modified on a subscriber node - role=%d",
+		  NameStr(tg->tg_relation->rd_rel->relname), SessionReplicationRole);
+
+	SPI_finish();
+	if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event))
+		return PointerGetDatum(tg->tg_newtuple);
+	else
+		return PointerGetDatum(tg->tg_trigtuple);
+}
+
+
+Datum
+versionFunc(logApply) (PG_FUNCTION_ARGS)
+{
+	TransactionId newXid = GetTopTransactionId();
+	Slony_I_ClusterStatus *cs;
+	TriggerData *tg;
+	HeapTuple	new_row;
+	TupleDesc	tupdesc;
+	Name		cluster_name;
+	int			rc;
+	bool		isnull;
+	Relation	target_rel;
+	ApplyLogAttnums *logatt;
+
+	Datum		dat;
+	char		cmdtype;
+	int32		tableid;
+	char	   *nspname;
+	char	   *relname;
+	int32		cmdupdncols;
+	Datum	   *cmdargs;
+	bool	   *cmdargsnulls;
+	int			cmdargsn;
+	Datum	   *binargs = NULL;
+	bool	   *binargsnulls = NULL;
+	int			binargsn;
+	int			fnum;
+	int			querynvals = 0;
+	Datum	   *queryvals = NULL;
+	Oid		   *querytypes = NULL;
+	char	   *querynulls = NULL;
+	char	  **querycolnames = NULL;
+	int			i;
+	int			spi_rc;
+
+	MemoryContext oldContext;
+	ApplyCacheEntry *cacheEnt;
+	ApplyCacheKey cacheKey;
+	bool		found;
+	instr_time	apply_start;
+	instr_time	prep_end;
+
+	/*
+	 * Get the trigger call context
+	 */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "Slony-I: logApply() not called as trigger");
+	tg = (TriggerData *) (fcinfo->context);
+
+	/*
+	 * Don't do any applying if the current session role isn't Replica.
+	 */
+	if (SessionReplicationRole != SESSION_REPLICATION_ROLE_REPLICA)
+		return PointerGetDatum(tg->tg_trigtuple);
+
+	/*
+	 * Check all logApply() calling conventions
+	 */
+	if (!TRIGGER_FIRED_BEFORE(tg->tg_event))
+		elog(ERROR, "Slony-I: logApply() must be fired BEFORE");
+	if (!TRIGGER_FIRED_FOR_ROW(tg->tg_event))
+		elog(ERROR, "Slony-I: logApply() must be fired FOR EACH ROW");
+	if (tg->tg_trigger->tgnargs != 1)
+		elog(ERROR, "Slony-I: logApply() must be defined with 1 arg");
+
+	/*
+	 * Connect to the SPI manager
+	 */
+	if ((rc = SPI_connect()) < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logApply()");
+
+	/*
+	 * Get or create the cluster status information and make sure it has the
+	 * SPI plans that we need here.
+	 */
+	cluster_name = DatumGetName(DirectFunctionCall1(namein,
+								CStringGetDatum(tg->tg_trigger->tgargs[0])));
+	cs = getClusterStatus(cluster_name, PLAN_APPLY_QUERIES);
+
+	/*
+	 * Do the following only once per transaction.
+	 */
+	bool planInitRequired = false;
+	if(!TransactionIdEquals(cs->currentXid, newXid))
 	{
-		case 'I':
-			apply_num_insert++;
-			break;
-		case 'U':
-			apply_num_update++;
-			break;
-		case 'D':
-			apply_num_delete++;
+		planInitRequired = true;
+		cs->log_init = false;
+		cs->event_txn=false;
+	}
+	else if (!cs->apply_init)
+	{
+		planInitRequired = true;
+	}
+
+	/*
+	 * The prepared apply queries survive the transaction. They are only
+	 * thrown away when a DDL script was applied or the relcache tells
+	 * us that the target table changed.
+	 */
+	if (applyBatchUsed > 0 && (!applyCacheValid || applyCacheStale))
+		applyBatchFlush();
+	if (!applyCacheValid)
+		applyCacheReset();
+	else if (applyCacheStale)
+	{
+		ApplyCacheEntry *nextEnt;
+
+		applyCacheStale = false;
+		for (cacheEnt = applyCacheHead; cacheEnt; cacheEnt = nextEnt)
+		{
+			nextEnt = cacheEnt->next;
+			if (!cacheEnt->valid)
+				applyCacheRemove(cacheEnt);
+		}
+	}
+	
+	if (planInitRequired)
+	{
+		Datum		query_args[1];
+
+		/*
+		 * Reset statistic counters.
+		 */
+		apply_num_insert = 0;
+		apply_num_update = 0;
+		apply_num_delete = 0;
+		apply_num_truncate = 0;
+		apply_num_script = 0;
+		apply_num_prepare = 0;
+		apply_num_hit = 0;
+		apply_num_evict = 0;
+		apply_num_evict_cost = 0;
+		apply_num_resize = 0;
+		applyTableStatsReset();
+		applyCacheAdapt();
+
+		/*
+		 * A node that forwards no set at all never needs to keep the log
+		 * rows it applies, so the per table lookup can be skipped.
+		 */
+		query_args[0] = Int32GetDatum(cs->localNodeId);
+		if (SPI_execp(cs->plan_node_forwards, query_args, NULL, 0) < 0)
+			elog(ERROR, "SPI_execp() failed for node forward lookup");
+		if (SPI_processed != 1)
+			elog(ERROR, "forwarding lookup for node %d failed",
+				 cs->localNodeId);
+		cs->apply_forwarder = DatumGetBool(
+				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+								1, &isnull));
+
+		cs->currentXid = newXid;
+		cs->apply_init = true;
+	}
+
+	/*
+	 * Get the cmdtype first.
+	 */
+	new_row = tg->tg_trigtuple;
+	tupdesc = tg->tg_relation->rd_att;
+	logatt = applyLogAttnumsGet(tg->tg_relation);
+
+	dat = SPI_getbinval(new_row, tupdesc,
+						logatt->log_cmdtype, &isnull);
+	if (isnull)
+		elog(ERROR, "Slony-I: log_cmdtype is NULL");
+	cmdtype = DatumGetChar(dat);
+
+	/*
+	 * Anything but a data row must see the effects of the rows before it.
+	 */
+	if (applyBatchUsed > 0 && cmdtype != 'I' && cmdtype != 'U' &&
+		cmdtype != 'D')
+		applyBatchFlush();
+
+	/*
+	 * Rows coming from sl_log_script are handled different from regular data
+	 * log rows since they don't have all the columns.
+	 */
+	if (cmdtype == 'S')
+	{
+		char	   *ddl_script;
+		bool		localNodeFound = true;
+		Datum		script_insert_args[5];
+		Datum	   *nodeargs;
+		bool	   *nodeargsnulls;
+		int			nodeargsn;
+		Datum	   *seqargs;
+		bool	   *seqargsnulls;
+		int			seqargsn;
+		Datum		array_holder;
+		Datum		delim_text;
+
+		apply_num_script++;
+
+
+		/*
+		 * Turn the log_cmdargs into a plain array of Text Datums.
+		 */
+		dat = SPI_getbinval(new_row, tupdesc,
+							logatt->log_cmdargs, &isnull);
+		if (isnull)
+			elog(ERROR, "Slony-I: log_cmdargs is NULL");
+		deconstruct_array(DatumGetArrayTypeP(dat),
+						  TEXTOID, -1, false, 'i',
+						  &cmdargs, &cmdargsnulls, &cmdargsn);
+
+		nodeargs = NULL;
+		nodeargsn = 0;
+		seqargs = NULL;
+		seqargsn = 0;
+		if (cmdargsn >= 2)
+		{
+			delim_text = DirectFunctionCall1(textin, CStringGetDatum(","));
+			if ((!cmdargsnulls[1]))
+			{
+				char	   *astr = DatumGetCString(DirectFunctionCall1(textout,
+																cmdargs[1]));
+
+				if (strcmp(astr, ""))
+				{
+					array_holder = DirectFunctionCall2(text_to_array, cmdargs[1],
+													   delim_text);
+					deconstruct_array(DatumGetArrayTypeP(array_holder),
+									  TEXTOID, -1, false, 'i',
+									  &nodeargs, &nodeargsnulls, &nodeargsn);
+				}
+			}
+		}
+		if (cmdargsn >= 3)
+		{
+			if ((!cmdargsnulls[2]))
+			{
+				char	   *astr = DatumGetCString(DirectFunctionCall1(textout,
+																cmdargs[2]));
+
+				if (strcmp(astr, ""))
+				{
+					array_holder = DirectFunctionCall2(text_to_array, cmdargs[2],
+													   delim_text);
+					deconstruct_array(DatumGetArrayTypeP(array_holder),
+									  TEXTOID, -1, false, 'i',
+									  &seqargs, &seqargsnulls, &seqargsn);
+				}
+			}
+		}
+
+		/*
+		 * The first element is the DDL statement itself.
+		 */
+		ddl_script = DatumGetCString(DirectFunctionCall1(
+													   textout, cmdargs[0]));
+
+		/*
+		 * If there is an optional node ID list, check that we are in it.
+		 */
+		if (nodeargsn > 0)
+		{
+			localNodeFound = false;
+			for (i = 0; i < nodeargsn; i++)
+			{
+				int32		nodeId = DatumGetInt32(
+												   DirectFunctionCall1(int4in,
+								 DirectFunctionCall1(textout, nodeargs[i])));
+
+				if (nodeId == cs->localNodeId)
+				{
+					localNodeFound = true;
+					break;
+				}
+			}
+		}
+
+		/*
+		 * Execute the DDL statement if the node list is empty or our local
+		 * node ID appears in it.
+		 */
+		if (localNodeFound)
+		{
+
+			char		query[1024];
+			Oid			argtypes[3];
+			void	   *plan = NULL;
+
+			argtypes[0] = INT4OID;
+			argtypes[1] = INT4OID;
+			argtypes[2] = INT8OID;
+
+			snprintf(query, 1023, "select \"%s\".sequenceSetValue($1," \
+					 "$2,NULL,$3,true); ", tg->tg_trigger->tgargs[0]);
+			plan = SPI_prepare(query, 3, argtypes);
+			if (plan == NULL)
+			{
+
+				elog(ERROR, "could not prepare plan to call sequenceSetValue");
+			}
+			/**
+			 * before we execute the DDL we need to update the sequences.
+			 */
+			if (seqargsn > 0)
+			{
+
+				for (i = 0; (i + 2) < seqargsn; i = i + 3)
+				{
+					Datum		call_args[3];
+					bool		call_nulls[3];
+
+					call_args[0] = DirectFunctionCall1(int4in,
+								   DirectFunctionCall1(textout, seqargs[i]));
+					call_args[1] = DirectFunctionCall1(int4in,
+							   DirectFunctionCall1(textout, seqargs[i + 1]));
+					call_args[2] = DirectFunctionCall1(int8in,
+							   DirectFunctionCall1(textout, seqargs[i + 2]));
+
+					call_nulls[0] = 0;
+					call_nulls[1] = 0;
+					call_nulls[2] = 0;
+
+					if (SPI_execp(plan, call_args, call_nulls, 0) < 0)
+					{
+						elog(ERROR, "error executing sequenceSetValue plan");
+
+					}
+
+				}
+
+
+			}
+
+			sprintf(query, "set session_replication_role to local;");
+			if (SPI_exec(query, 0) < 0)
+			{
+				elog(ERROR, "SPI_exec() failed for statement '%s'",
+					 query);
+			}
+
+
+			if (SPI_exec(ddl_script, 0) < 0)
+			{
+				elog(ERROR, "SPI_exec() failed for DDL statement '%s'",
+					 ddl_script);
+			}
+
+			sprintf(query, "set session_replication_role to replica;");
+			if (SPI_exec(query, 0) < 0)
+			{
+				elog(ERROR, "SPI_exec() failed for statement '%s'",
+					 query);
+			}
+
+			/*
+			 * Flush the apply query cache.
+			 */
+			applyCacheValid = false;
+		}
+
+		/*
+		 * Build the parameters for the insert into sl_log_script and execute
+		 * the query.
+		 */
+		script_insert_args[0] = SPI_getbinval(new_row, tupdesc,
+								logatt->log_origin, &isnull);
+		script_insert_args[1] = SPI_getbinval(new_row, tupdesc,
+								  logatt->log_txid, &isnull);
+		script_insert_args[2] = SPI_getbinval(new_row, tupdesc,
+							 logatt->log_actionseq, &isnull);
+		script_insert_args[3] = SPI_getbinval(new_row, tupdesc,
+							   logatt->log_cmdtype, &isnull);
+		script_insert_args[4] = SPI_getbinval(new_row, tupdesc,
+							   logatt->log_cmdargs, &isnull);
+		if (SPI_execp(cs->plan_insert_log_script, script_insert_args, NULL, 0) < 0)
+			elog(ERROR, "Execution of sl_log_script insert plan failed");
+
+		/*
+		 * Return NULL to suppress the insert into the original sl_log_N.
+		 */
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
+
+	/*
+	 * Process the special ddlScript_complete row.
+	 */
+	if (cmdtype == 's')
+	{
+		bool		localNodeFound = true;
+		Datum		script_insert_args[5];
+
+		apply_num_script++;
+
+		/*
+		 * Turn the log_cmdargs into a plain array of Text Datums.
+		 */
+		dat = SPI_getbinval(new_row, tupdesc,
+							logatt->log_cmdargs, &isnull);
+		if (isnull)
+			elog(ERROR, "Slony-I: log_cmdargs is NULL");
+
+		deconstruct_array(DatumGetArrayTypeP(dat),
+						  TEXTOID, -1, false, 'i',
+						  &cmdargs, &cmdargsnulls, &cmdargsn);
+
+		/*
+		 * If there is an optional node ID list, check that we are in it.
+		 */
+		if (cmdargsn > 1)
+		{
+			localNodeFound = false;
+			for (i = 1; i < cmdargsn; i++)
+			{
+				int32		nodeId = DatumGetInt32(
+												   DirectFunctionCall1(int4in,
+								  DirectFunctionCall1(textout, cmdargs[i])));
+
+				if (nodeId == cs->localNodeId)
+				{
+					localNodeFound = true;
+					break;
+				}
+			}
+		}
+
+		/*
+		 * Execute the ddlScript_complete_int() call if we have to.
+		 */
+		if (localNodeFound)
+		{
+			char		query[1024];
+
+			snprintf(query, sizeof(query),
+					 "select %s.ddlScript_complete_int();",
+					 cs->clusterident);
+
+			if (SPI_exec(query, 0) < 0)
+			{
+				elog(ERROR, "SPI_exec() failed for statement '%s'",
+					 query);
+			}
+
+
+			/*
+			 * Flush the apply query cache.
+			 */
+			applyCacheValid = false;
+		}
+
+		/*
+		 * Build the parameters for the insert into sl_log_script and execute
+		 * the query.
+		 */
+		script_insert_args[0] = SPI_getbinval(new_row, tupdesc,
+								logatt->log_origin, &isnull);
+		script_insert_args[1] = SPI_getbinval(new_row, tupdesc,
+								  logatt->log_txid, &isnull);
+		script_insert_args[2] = SPI_getbinval(new_row, tupdesc,
+							 logatt->log_actionseq, &isnull);
+		script_insert_args[3] = SPI_getbinval(new_row, tupdesc,
+							   logatt->log_cmdtype, &isnull);
+		script_insert_args[4] = SPI_getbinval(new_row, tupdesc,
+							   logatt->log_cmdargs, &isnull);
+		if (SPI_execp(cs->plan_insert_log_script, script_insert_args, NULL, 0) < 0)
+			elog(ERROR, "Execution of sl_log_script insert plan failed");
+
+		/*
+		 * Return NULL to suppress the insert into the original sl_log_N.
+		 */
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
+
+	/*
+	 * Normal data log row. Get all the relevant data from the log row.
+	 */
+	INSTR_TIME_SET_CURRENT(apply_start);
+	dat = SPI_getbinval(new_row, tupdesc,
+						logatt->log_tableid, &isnull);
+	if (isnull)
+		elog(ERROR, "Slony-I: log_tableid is NULL");
+	tableid = DatumGetInt32(dat);
+	dat = SPI_getbinval(new_row, tupdesc,
+						logatt->log_cmdupdncols, &isnull);
+	if (isnull && cmdtype == 'U')
+		elog(ERROR, "Slony-I: log_cmdupdncols is NULL on UPDATE");
+	cmdupdncols = DatumGetInt32(dat);
+
+	dat = SPI_getbinval(new_row, tupdesc,
+						logatt->log_cmdargs, &isnull);
+	if (isnull)
+		elog(ERROR, "Slony-I: log_cmdargs is NULL");
+
+	/*
+	 * Turn the log_cmdargs into a plain array of Text Datums.
+	 */
+	deconstruct_array(DatumGetArrayTypeP(dat),
+					  TEXTOID, -1, false, 'i',
+					  &cmdargs, &cmdargsnulls, &cmdargsn);
+
+	/*
+	 * Rows captured in the binary format carry some of the values in
+	 * log_cmdbinargs instead. There is one element per column name/value
+	 * pair in log_cmdargs.
+	 */
+	fnum = logatt->log_cmdformat;
+	if (fnum > 0)
+	{
+		dat = SPI_getbinval(new_row, tupdesc, fnum, &isnull);
+		if (!isnull && DatumGetInt32(dat) == SLON_LOGFORMAT_BINARY)
+		{
+			dat = SPI_getbinval(new_row, tupdesc,
+								logatt->log_cmdbinargs,
+								&isnull);
+			if (isnull)
+				elog(ERROR, "Slony-I: log_cmdbinargs is NULL on binary "
+					 "log row");
+			deconstruct_array(DatumGetArrayTypeP(dat),
+							  BYTEAOID, -1, false, 'i',
+							  &binargs, &binargsnulls, &binargsn);
+			if (binargsn != cmdargsn / 2)
+				elog(ERROR, "Slony-I: log_cmdbinargs has %d elements, "
+					 "expected %d", binargsn, cmdargsn / 2);
+		}
+	}
+
+	/*
+	 * Build the query cache key. This is for insert, update and truncate just
+	 * the operation type and the table ID. For update we also hash the names
+	 * of the updated columns.
+	 */
+	memset(&cacheKey, 0, sizeof(cacheKey));
+	cacheKey.tableid = tableid;
+	cacheKey.cmdtype = cmdtype;
+	if (cmdtype == 'U')
+	{
+		cacheKey.ncols = cmdupdncols;
+		cacheKey.colnames = cmdargs;
+		for (i = 0; i < cmdupdncols * 2; i += 2)
+		{
+			text	   *colname = DatumGetTextPP(cmdargs[i]);
+
+			cacheKey.colhash = (cacheKey.colhash << 1) |
+				(cacheKey.colhash >> 31);
+			cacheKey.colhash ^= DatumGetUInt32(hash_any(
+								  (unsigned char *) VARDATA_ANY(colname),
+											 VARSIZE_ANY_EXHDR(colname)));
+		}
+	}
+
+	cacheEnt = hash_search(applyCacheHash, &cacheKey, HASH_ENTER, &found);
+	if (!found)
+	{
+		/*
+		 * The new entry must not point into the log row.
+		 */
+		if (cacheEnt->key.ncols > 0)
+		{
+			oldContext = MemoryContextSwitchTo(applyCacheContext);
+			cacheEnt->key.colnames = (Datum *)
+				palloc0(sizeof(Datum) * cacheEnt->key.ncols * 2);
+			for (i = 0; i < cacheEnt->key.ncols * 2; i += 2)
+				cacheEnt->key.colnames[i] =
+					PointerGetDatum(DatumGetTextPCopy(cmdargs[i]));
+			MemoryContextSwitchTo(oldContext);
+		}
+		else
+			cacheEnt->key.colnames = NULL;
+
+		memset(((char *) cacheEnt) + sizeof(ApplyCacheKey), 0,
+			   sizeof(ApplyCacheEntry) - sizeof(ApplyCacheKey));
+		cacheEnt->ready = false;
+		cacheEnt->valid = true;
+	}
+	else if (!cacheEnt->ready)
+	{
+		/*
+		 * An earlier transaction failed while preparing this entry. Free
+		 * whatever it got to allocate and start over with it.
+		 */
+		applyCacheRelease(cacheEnt);
+		cacheEnt->valid = true;
+		found = false;
+	}
+
+	/*
+	 * A pending batch for another query goes first. This also makes sure
+	 * that the entry of the batch cannot be evicted below.
+	 */
+	if (applyBatchUsed > 0 && cacheEnt != applyBatchEnt)
+		applyBatchFlush();
+	applyAdaptLookups++;
+	if (found)
+	{
+		apply_num_hit++;
+
+		/*
+		 * We are reusing an existing query plan. Just move it to the end of
+		 * the list.
+		 */
+		if (cacheEnt != applyCacheTail)
+		{
+			/*
+			 * Remove the entry from the list
+			 */
+			if (cacheEnt->prev == NULL)
+				applyCacheHead = cacheEnt->next;
+			else
+				cacheEnt->prev->next = cacheEnt->next;
+			if (cacheEnt->next == NULL)
+				applyCacheTail = cacheEnt->prev;
+			else
+				cacheEnt->next->prev = cacheEnt->prev;
+
+			/*
+			 * Put the entry back at the end of the list.
+			 */
+			if (applyCacheHead == NULL)
+			{
+				cacheEnt->prev = NULL;
+				cacheEnt->next = NULL;
+				applyCacheHead = cacheEnt;
+				applyCacheTail = cacheEnt;
+			}
+			else
+			{
+				cacheEnt->prev = applyCacheTail;
+				cacheEnt->next = NULL;
+				applyCacheTail->next = cacheEnt;
+				applyCacheTail = cacheEnt;
+			}
+		}
+	}
+	else
+	{
+		apply_num_prepare++;
+
+		/*
+		 * The table name is only needed to build the query.
+		 */
+		nspname = SPI_getvalue(new_row, tupdesc, logatt->log_tablenspname);
+		if (nspname == NULL)
+			elog(ERROR, "Slony-I: log_tablenspname is NULL on INSERT/UPDATE/DELETE");
+
+		relname = SPI_getvalue(new_row, tupdesc, logatt->log_tablerelname);
+		if (relname == NULL)
+			elog(ERROR, "Slony-I: log_tablerelname is NULL on INSERT/UPDATE/DELETE");
+
+		/*
+		 * Allocate memory for the function call info to cast all datums from
+		 * TEXT to the required Datum type.
+		 */
+		oldContext = MemoryContextSwitchTo(applyCacheContext);
+		cacheEnt->finfo_input = (FmgrInfo *) palloc(sizeof(FmgrInfo) * (cmdargsn / 2));
+		cacheEnt->typioparam = (Oid *) palloc(sizeof(Oid) * (cmdargsn / 2));
+		cacheEnt->typmod = (int32 *) palloc(sizeof(int32) * (cmdargsn / 2));
+		MemoryContextSwitchTo(oldContext);
+
+		if (cacheEnt->finfo_input == NULL || cacheEnt->typioparam == NULL ||
+			cacheEnt->typmod == NULL)
+			elog(ERROR, "Slony-I: out of memory in logApply()");
+
+		cacheEnt->forwardXid = InvalidTransactionId;
+
+		/*
+		 * Find the target relation in the system cache. We need this to find
+		 * the data types of the target columns for casting.
+		 */
+#ifdef HAS_LOOKUPEXPLICITNAMESPACE_2
+		target_rel = RelationIdGetRelation(
+										   get_relname_relid(relname,
+								   LookupExplicitNamespace(nspname, false)));
+#else
+		target_rel = RelationIdGetRelation(
+			   get_relname_relid(relname, LookupExplicitNamespace(nspname)));
+#endif
+		if (target_rel == NULL)
+			elog(ERROR, "Slony-I: cannot find table %s.%s in logApply()",
+				 slon_quote_identifier(nspname),
+				 slon_quote_identifier(relname));
+		cacheEnt->reloid = RelationGetRelid(target_rel);
+
+		/*
+		 * Create the saved SPI plan for this query
+		 */
+		applyQueryReset();
+
+		/*
+		 * Build the query string and parameter type array for the
+		 * SPI_prepare() call.
+		 */
+		switch (cmdtype)
+		{
+			case 'I':
+
+				/*
+				 * INSERT
+				 */
+				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
+				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+
+				sprintf(applyQueryPos, "INSERT INTO %s.%s (",
+						slon_quote_identifier(nspname),
+						slon_quote_identifier(relname));
+				applyQueryPos += strlen(applyQueryPos);
+
+				/*
+				 * Construct the list of quoted column names.
+				 */
+				for (i = 0; i < cmdargsn; i += 2)
+				{
+					char	   *colname;
+
+					applyQueryIncrease();
+
+					if (i > 0)
+					{
+						strcpy(applyQueryPos, ", ");
+						applyQueryPos += 2;
+					}
+
+					if (cmdargsnulls[i])
+						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
+					querycolnames[i / 2] = DatumGetCString(DirectFunctionCall1(
+													   textout, cmdargs[i]));
+					colname = (char *) slon_quote_identifier(querycolnames[i / 2]);
+					strcpy(applyQueryPos, colname);
+					applyQueryPos += strlen(applyQueryPos);
+				}
+
+				/*
+				 * Add ") VALUES ("
+				 */
+				strcpy(applyQueryPos, ") VALUES (");
+				applyQueryPos += strlen(applyQueryPos);
+
+				/*
+				 * Add $n::<coltype> placeholders for all the values.
+				 */
+				for (i = 0; i < cmdargsn; i += 2)
+				{
+					int			colnum;
+					Oid			coltype;
+					Oid			typinput;
+
+					applyQueryIncrease();
+
+					/*
+					 * Lookup the column data type in the target relation and
+					 * remember everything we need to know later to cast TEXT
+					 * to the correct column Datum.
+					 */
+					colnum = SPI_fnumber(target_rel->rd_att, querycolnames[i / 2]);
+					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
+					if (coltype == InvalidOid)
+						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
+							 querycolnames[i / 2]);
+					getTypeInputInfo(coltype, &typinput,
+									 &(cacheEnt->typioparam[i / 2]));
+					oldContext = MemoryContextSwitchTo(applyCacheContext);
+					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
+					MemoryContextSwitchTo(oldContext);
+					cacheEnt->typmod[i / 2] =
+						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
+
+					/*
+					 * Add the parameter to the query string
+					 */
+					sprintf(applyQueryPos, "%s$%d", (i == 0) ? "" : ", ",
+							i / 2 + 1);
+					applyQueryPos += strlen(applyQueryPos);
+
+					querytypes[i / 2] = coltype;
+				}
+
+				/*
+				 * Finish the query string
+				 */
+				strcpy(applyQueryPos, ");");
+				applyQueryPos += 2;
+				querynvals = cmdargsn / 2;
+
+				break;
+
+			case 'U':
+
+				/*
+				 * UPDATE
+				 */
+				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
+				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+
+				sprintf(applyQueryPos, "UPDATE ONLY %s.%s SET ",
+						slon_quote_identifier(nspname),
+						slon_quote_identifier(relname));
+				applyQueryPos += strlen(applyQueryPos);
+
+				/*
+				 * This can all be done in one pass over the cmdargs array. We
+				 * just have to switch the behavior slightly between the SET
+				 * clause and the WHERE clause.
+				 */
+				for (i = 0; i < cmdargsn; i += 2)
+				{
+					char	   *colname;
+					int			colnum;
+					Oid			coltype;
+					Oid			typinput;
+
+					applyQueryIncrease();
+
+					/*
+					 * Get the column name and data type as well as everything
+					 * needed later to cast TEXT to the correct input Datum.
+					 */
+					if (cmdargsnulls[i])
+						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
+					colname = DatumGetCString(DirectFunctionCall1(
+													   textout, cmdargs[i]));
+					colnum = SPI_fnumber(target_rel->rd_att, colname);
+					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
+					if (coltype == InvalidOid)
+						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
+							 colname);
+					getTypeInputInfo(coltype, &typinput,
+									 &(cacheEnt->typioparam[i / 2]));
+					oldContext = MemoryContextSwitchTo(applyCacheContext);
+					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
+					MemoryContextSwitchTo(oldContext);
+					cacheEnt->typmod[i / 2] =
+						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
+
+					/*
+					 * Special case if there were no columns updated. We tell
+					 * it to set the first PK column to itself.
+					 */
+					if (cmdupdncols == 0 && i == 0)
+					{
+						sprintf(applyQueryPos, "%s = %s",
+								slon_quote_identifier(colname),
+								slon_quote_identifier(colname));
+						applyQueryPos += strlen(applyQueryPos);
+					}
+
+					/*
+					 * If we are at the transition point from SET to WHERE,
+					 * add the WHERE keyword.
+					 */
+					if (i == cmdupdncols * 2)
+					{
+						strcpy(applyQueryPos, " WHERE ");
+						applyQueryPos += 7;
+					}
+
+					if (i < cmdupdncols * 2)
+					{
+						/*
+						 * This is inside the SET clause. Add the <colname> =
+						 * $n::<coltype> separated by comma.
+						 */
+						sprintf(applyQueryPos, "%s%s = $%d",
+								(i > 0) ? ", " : "",
+								slon_quote_identifier(colname),
+								i / 2 + 1);
+					}
+					else
+					{
+						/*
+						 * This is in the WHERE clause. Same as above but
+						 * separated by AND.
+						 */
+						sprintf(applyQueryPos, "%s%s = $%d",
+								(i > cmdupdncols * 2) ? " AND " : "",
+								slon_quote_identifier(colname),
+								i / 2 + 1);
+					}
+					applyQueryPos += strlen(applyQueryPos);
+
+					querytypes[i / 2] = coltype;
+				}
+
+				strcpy(applyQueryPos, ";");
+				applyQueryPos += 1;
+				querynvals = cmdargsn / 2;
+
+				break;
+
+			case 'D':
+
+				/*
+				 * DELETE
+				 */
+				querycolnames = (char **) palloc(sizeof(char *) * cmdargsn / 2);
+				querytypes = (Oid *) palloc(sizeof(Oid) * cmdargsn / 2);
+
+				sprintf(applyQueryPos, "DELETE FROM ONLY %s.%s WHERE ",
+						slon_quote_identifier(nspname),
+						slon_quote_identifier(relname));
+				applyQueryPos += strlen(applyQueryPos);
+
+				for (i = 0; i < cmdargsn; i += 2)
+				{
+					int			colnum;
+					char	   *colname;
+					Oid			coltype;
+					Oid			typinput;
+
+					applyQueryIncrease();
+
+					/*
+					 * Add <colname> = $n separated by comma.
+					 */
+					if (cmdargsnulls[i])
+						elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
+					colname = DatumGetCString(DirectFunctionCall1(
+													   textout, cmdargs[i]));
+					colnum = SPI_fnumber(target_rel->rd_att, colname);
+					coltype = SPI_gettypeid(target_rel->rd_att, colnum);
+					if (coltype == InvalidOid)
+						elog(ERROR, "Slony-I: type lookup for column %s failed in logApply()",
+							 colname);
+					getTypeInputInfo(coltype, &typinput,
+									 &(cacheEnt->typioparam[i / 2]));
+					oldContext = MemoryContextSwitchTo(applyCacheContext);
+					fmgr_info(typinput, &(cacheEnt->finfo_input[i / 2]));
+					MemoryContextSwitchTo(oldContext);
+					cacheEnt->typmod[i / 2] =
+						target_rel->rd_att->attrs[colnum - 1]->atttypmod;
+					sprintf(applyQueryPos, "%s%s = $%d",
+							(i > 0) ? " AND " : "",
+							slon_quote_identifier(colname),
+							i / 2 + 1);
+
+					applyQueryPos += strlen(applyQueryPos);
+
+					querytypes[i / 2] = coltype;
+				}
+
+				strcpy(applyQueryPos, ";");
+				applyQueryPos += 1;
+
+				querynvals = cmdargsn / 2;
+
+				break;
+
+			case 'T':
+
+				/*
+				 * TRUNCATE
+				 */
+				querytypes = (Oid *) palloc(sizeof(Oid) * 2);
+
+				sprintf(applyQueryPos, "TRUNCATE ONLY %s.%s CASCADE ;",
+						slon_quote_identifier(nspname),
+						slon_quote_identifier(relname));
+
+				querynvals = 0;
+
+				break;
+
+			default:
+				elog(ERROR, "Slony-I: unhandled log cmdtype '%c' in logApply()",
+					 cmdtype);
+				break;
+		}
+
+		/*
+		 * Close the target relation.
+		 */
+		RelationClose(target_rel);
+
+		/*
+		 * Remember the column types for decoding binary values.
+		 */
+		oldContext = MemoryContextSwitchTo(applyCacheContext);
+		cacheEnt->coltype = (Oid *) palloc(sizeof(Oid) * (querynvals + 1));
+		cacheEnt->have_recv = (bool *) palloc0(sizeof(bool) * (querynvals + 1));
+		cacheEnt->finfo_recv = (FmgrInfo *) palloc(sizeof(FmgrInfo) * (querynvals + 1));
+		cacheEnt->typioparam_recv = (Oid *) palloc(sizeof(Oid) * (querynvals + 1));
+		MemoryContextSwitchTo(oldContext);
+		if (querynvals > 0)
+			memcpy(cacheEnt->coltype, querytypes, sizeof(Oid) * querynvals);
+
+		/*
+		 * Prepare the saved SPI query plan.
+		 */
+#ifdef CURSOR_OPT_GENERIC_PLAN
+		/*
+		 * The apply queries are all simple key lookups. Planning them
+		 * again for the parameter values of the first executions, which
+		 * the plan cache would do otherwise, gains nothing.
+		 */
+		cacheEnt->plan = SPI_saveplan(
+						SPI_prepare_cursor(applyQuery, querynvals, querytypes,
+										   CURSOR_OPT_GENERIC_PLAN));
+#else
+		cacheEnt->plan = SPI_saveplan(
+							SPI_prepare(applyQuery, querynvals, querytypes));
+#endif
+		if (cacheEnt->plan == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed for query '%s'",
+				 applyQuery);
+
+		applyBatchPrepare(cacheEnt, cmdtype, nspname, relname,
+						  cmdargs, cmdargsn, cmdupdncols);
+
+		/*
+		 * Remember what the preparation cost, see applyCacheEvict().
+		 */
+		INSTR_TIME_SET_CURRENT(prep_end);
+		INSTR_TIME_SUBTRACT(prep_end, apply_start);
+		cacheEnt->prepcost = (int64) INSTR_TIME_GET_MICROSEC(prep_end);
+
+		/*
+		 * Add the plan to the double linked LRU list
+		 */
+		if (applyCacheHead == NULL)
+		{
+			cacheEnt->prev = NULL;
+			cacheEnt->next = NULL;
+			applyCacheHead = cacheEnt;
+			applyCacheTail = cacheEnt;
+		}
+		else
+		{
+			cacheEnt->prev = applyCacheTail;
+			cacheEnt->next = NULL;
+			applyCacheTail->next = cacheEnt;
+			applyCacheTail = cacheEnt;
+		}
+		applyCacheUsed++;
+		cacheEnt->ready = true;
+
+		/*
+		 * If that pushes us over the maximum allowed cached plans, evict
+		 * one of those that weren't used the longest.
+		 */
+		if (applyCacheUsed > applyCacheSize)
+			applyCacheEvict();
+	}
+
+	/*
+	 * We also need to determine if this table belongs to a set, that we
+	 * are a forwarder of. Subscriptions can change between transactions,
+	 * so this is looked up again once per transaction. On a leaf node the
+	 * answer is known without asking.
+	 */
+	if (!cs->apply_forwarder)
+		cacheEnt->forward = false;
+	else if (!TransactionIdEquals(cacheEnt->forwardXid, newXid))
+	{
+		Datum		query_args[2];
+
+		query_args[0] = Int32GetDatum(tableid);
+		query_args[1] = Int32GetDatum(cs->localNodeId);
+
+		if (SPI_execp(cs->plan_table_info, query_args, NULL, 0) < 0)
+			elog(ERROR, "SPI_execp() failed for table forward lookup");
+
+		if (SPI_processed != 1)
+			elog(ERROR, "forwarding lookup for table %d failed",
+				 tableid);
+
+		cacheEnt->forward = DatumGetBool(
+				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
+		cacheEnt->forwardXid = newXid;
+	}
+
+	/*
+	 * We now have a cached SPI plan. Construct the call parameter and null
+	 * flag arrays.
+	 */
+	switch (cmdtype)
+	{
+		case 'I':
+		case 'U':
+		case 'D':
+
+			/*
+			 * INSERT, UPDATE and DELETE
+			 */
+			queryvals = (Datum *) palloc(sizeof(Datum) * cmdargsn / 2);
+			querynulls = (char *) palloc(cmdargsn / 2 + 1);
+
+			for (i = 0; i < cmdargsn; i += 2)
+			{
+				char	   *tmpval;
+
+				if (cmdargsnulls[i + 1] && binargs != NULL &&
+					!binargsnulls[i / 2])
+				{
+					queryvals[i / 2] = applyBinaryValue(cacheEnt, i / 2,
+														binargs[i / 2]);
+					querynulls[i / 2] = ' ';
+				}
+				else if (cmdargsnulls[i + 1])
+				{
+					queryvals[i / 2] = (Datum) 0;
+					querynulls[i / 2] = 'n';
+				}
+				else
+				{
+					tmpval = DatumGetCString(DirectFunctionCall1(textout,
+															cmdargs[i + 1]));
+					queryvals[i / 2] = InputFunctionCall(
+											 &(cacheEnt->finfo_input[i / 2]),
+														 tmpval,
+												 cacheEnt->typioparam[i / 2],
+													cacheEnt->typmod[i / 2]);
+					pfree(tmpval);
+					querynulls[i / 2] = ' ';
+				}
+			}
+			querynulls[cmdargsn / 2] = '\0';
+
+			break;
+
+		case 'T':
+
+			/*
+			 * TRUNCATE
+			 */
+
+			break;
+
+		default:
+			elog(ERROR, "Slony-I: unhandled log cmdtype '%c' in logApply()",
+				 cmdtype);
+			break;
+	}
+
+
+	/*
+	 * Execute the query or add the row to the batch. A batch adds its
+	 * own statement time to the table statistics when it is applied.
+	 */
+	if (applyBatchLimit(cacheEnt) > 1 && cacheEnt->batchQuery != NULL)
+	{
+		uint32		keyhash = 0;
+
+		/*
+		 * An UPDATE batch must not change the same row twice, so hash
+		 * the key values as they appear in the log row.
+		 */
+		if (cmdtype == 'U')
+		{
+			for (i = cmdupdncols * 2; i < cmdargsn; i += 2)
+			{
+				struct varlena *keyval;
+
+				if (!cmdargsnulls[i + 1])
+					keyval = (struct varlena *) DatumGetPointer(cmdargs[i + 1]);
+				else if (binargs != NULL && !binargsnulls[i / 2])
+					keyval = (struct varlena *) DatumGetPointer(binargs[i / 2]);
+				else
+					continue;
+				keyval = pg_detoast_datum_packed(keyval);
+				keyhash = (keyhash << 1) | (keyhash >> 31);
+				keyhash ^= DatumGetUInt32(hash_any(
+									 (unsigned char *) VARDATA_ANY(keyval),
+												 VARSIZE_ANY_EXHDR(keyval)));
+			}
+		}
+		applyTableStatsAdd(tableid, cmdtype, &apply_start);
+		applyBatchAdd(cacheEnt, queryvals, querynulls, binargs != NULL,
+					  keyhash);
+	}
+	else
+	{
+		/*
+		 * The row goes through the executor by way of SPI on purpose.
+		 * Calling the heap and index access methods directly would have
+		 * to follow their incompatible changes across all the server
+		 * versions we support, and would bypass the constraint checks,
+		 * partition routing and replica triggers of the target table.
+		 */
+		if ((spi_rc = SPI_execp(cacheEnt->plan, queryvals, querynulls, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() failed - rc=%d", spi_rc);
+		applyTableStatsAdd(tableid, cmdtype, &apply_start);
+	}
+
+	/*
+	 * Count operations
+	 */
+	switch (cmdtype)
+	{
+		case 'I':
+			apply_num_insert++;
+			break;
+		case 'U':
+			apply_num_update++;
+			break;
+		case 'D':
+			apply_num_delete++;
+			break;
+		case 'T':
+			apply_num_truncate++;
+			break;
+		default:
+			break;
+	}
+
+	/*
+	 * Disconnect from SPI manager and return either the new tuple or NULL
+	 * according to the forwarding of log data.
+	 */
+	SPI_finish();
+	if (cacheEnt->forward)
+		return PointerGetDatum(tg->tg_trigtuple);
+	else
+		return PointerGetDatum(NULL);
+}
+
+
+/*
+ * versionFunc(logApplySetCacheSize)()
+ *
+ *	Called by slon during startup to set the size of the log apply
+ *	query cache according to the config parameter apply_cache_size.
+ */
+Datum
+versionFunc(logApplySetCacheSize) (PG_FUNCTION_ARGS)
+{
+	int32		newSize;
+	int32		oldSize = applyCacheSize;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySetCacheSize");
+
+	newSize = PG_GETARG_INT32(0);
+
+	if (newSize <= 0)
+		PG_RETURN_INT32(oldSize);
+
+	if (newSize < 10 || newSize > 2000)
+		elog(ERROR, "Slony-I: logApplySetCacheSize(): illegal size");
+
+	applyCacheSize = newSize;
+	applyCacheSizeBase = newSize;
+	PG_RETURN_INT32(oldSize);
+}
+
+
+/*
+ * versionFunc(logApplySetCacheMaxSize)()
+ *
+ *	Called by slon during startup to set the size up to which the log
+ *	apply query cache may grow on its own. 0 keeps the size fixed.
+ */
+Datum
+versionFunc(logApplySetCacheMaxSize) (PG_FUNCTION_ARGS)
+{
+	int32		newSize;
+	int32		oldSize = applyCacheSizeMax;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySetCacheMaxSize");
+
+	newSize = PG_GETARG_INT32(0);
+
+	if (newSize < 0)
+		PG_RETURN_INT32(oldSize);
+
+	if (newSize > 20000)
+		elog(ERROR, "Slony-I: logApplySetCacheMaxSize(): illegal size");
+
+	applyCacheSizeMax = newSize;
+	if (applyCacheSize > applyCacheSizeBase &&
+		applyCacheSize > applyCacheSizeMax)
+		applyCacheSize = Max(applyCacheSizeBase, applyCacheSizeMax);
+	applyAdaptLookups = 0;
+	applyAdaptEvicts = 0;
+	PG_RETURN_INT32(oldSize);
+}
+
+
+/*
+ * versionFunc(logApplySetBatchSize)()
+ *
+ *	Called by slon to set the number of rows logApply() applies with
+ *	one set-based statement. 0 or 1 apply every row by itself.
+ */
+Datum
+versionFunc(logApplySetBatchSize) (PG_FUNCTION_ARGS)
+{
+	int32		newSize;
+	int32		oldSize = applyBatchSize;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySetBatchSize");
+
+	newSize = PG_GETARG_INT32(0);
+
+	if (newSize < 0)
+		PG_RETURN_INT32(oldSize);
+
+	if (newSize > 10000)
+		elog(ERROR, "Slony-I: logApplySetBatchSize(): illegal size");
+
+#ifndef HAVE_XACT_EVENT_PRE_COMMIT
+	/*
+	 * Without a pre-commit callback the last batch could not be applied.
+	 */
+	newSize = 0;
+#endif
+
+	/*
+	 * The arrays of a pending batch are sized for the old batch size.
+	 */
+	if (newSize != applyBatchSize)
+		applyBatchFlush();
+	applyBatchSize = newSize;
+	PG_RETURN_INT32(oldSize);
+}
+
+
+/*
+ * versionFunc(logApplySetInsertBatchSize)()
+ *
+ *	Called by slon to set the number of consecutive INSERT rows
+ *	logApply() applies with one statement while catching up. Values
+ *	not above the normal batch size leave INSERTs alone.
+ */
+Datum
+versionFunc(logApplySetInsertBatchSize) (PG_FUNCTION_ARGS)
+{
+	int32		newSize;
+	int32		oldSize = applyInsertBatchSize;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySetInsertBatchSize");
+
+	newSize = PG_GETARG_INT32(0);
+
+	if (newSize < 0)
+		PG_RETURN_INT32(oldSize);
+
+	if (newSize > 100000)
+		elog(ERROR, "Slony-I: logApplySetInsertBatchSize(): illegal size");
+
+#ifndef HAVE_XACT_EVENT_PRE_COMMIT
+	newSize = 0;
+#endif
+
+	if (newSize != applyInsertBatchSize)
+		applyBatchFlush();
+	applyInsertBatchSize = newSize;
+	PG_RETURN_INT32(oldSize);
+}
+
+
+/*
+ * versionFunc(logApplyFlush)()
+ *
+ *	AFTER INSERT ... FOR EACH STATEMENT trigger on sl_log_1/2 that
+ *	applies the pending logApply() batch once the rows of the COPY
+ *	are all in. Doing this at commit instead would be after deferred
+ *	triggers have fired, and errors would only show up as a failing
+ *	COMMIT.
+ */
+Datum
+versionFunc(logApplyFlush) (PG_FUNCTION_ARGS)
+{
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "Slony-I: logApplyFlush() not called as trigger");
+
+	applyBatchFlush();
+
+	return PointerGetDatum(NULL);
+}
+
+
+/*
+ * versionFunc(logApplySaveStats)()
+ *
+ *	Save statistics at the end of SYNC processing.
+ */
+Datum
+versionFunc(logApplySaveStats) (PG_FUNCTION_ARGS)
+{
+	Slony_I_ClusterStatus *cs;
+	Datum		params[14];
+	char	   *nulls = "              ";
+	int32		rc = 0;
+	int			spi_rc;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySetCacheSize");
+
+	/*
+	 * A pending batch must be applied before its table statistics are
+	 * saved.
+	 */
+	applyBatchFlush();
+
+	/*
+	 * Connect to the SPI manager
+	 */
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logApply()");
+
+	/*
+	 * Get or create the cluster status information and make sure it has the
+	 * SPI plans that we need here.
+	 */
+	cs = getClusterStatus(PG_GETARG_NAME(0), PLAN_APPLY_QUERIES);
+
+	/*
+	 * Setup the parameter array. Note that both queries use the same
+	 * parameters in exactly the same order.
+	 */
+	params[0] = Int32GetDatum(PG_GETARG_INT32(1));
+
+	params[1] = Int64GetDatum(apply_num_insert);
+	params[2] = Int64GetDatum(apply_num_update);
+	params[3] = Int64GetDatum(apply_num_delete);
+	params[4] = Int64GetDatum(apply_num_truncate);
+	params[5] = Int64GetDatum(apply_num_script);
+	params[6] = Int64GetDatum(apply_num_insert + apply_num_update +
+				   apply_num_delete + apply_num_truncate * apply_num_script);
+	params[7] = PointerGetDatum(PG_GETARG_INTERVAL_P(2));
+	params[8] = Int64GetDatum(apply_num_prepare);
+	params[9] = Int64GetDatum(apply_num_hit);
+	params[10] = Int64GetDatum(apply_num_evict);
+	params[11] = Int32GetDatum(applyCacheSize);
+	params[12] = Int64GetDatum(apply_num_resize);
+	params[13] = Int64GetDatum(apply_num_evict_cost);
+	applyTableStatsSave(cs, PG_GETARG_INT32(1));
+
+	/*
+	 * Perform the UPDATE of sl_apply_stats. If that doesn't update any
+	 * row(s), try to INSERT one.
+	 */
+	if ((spi_rc = SPI_execp(cs->plan_apply_stats_update, params, nulls, 0)) < 0)
+		elog(ERROR, "Slony-I: SPI_execp() to update apply stats failed"
+			 " - rc=%d", spi_rc);
+	if (SPI_processed > 0)
+	{
+		rc = 2;
+	}
+	else
+	{
+		if ((spi_rc = SPI_execp(cs->plan_apply_stats_insert, params, nulls, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() to insert apply stats failed"
+				 " - rc=%d", spi_rc);
+		if (SPI_processed > 0)
+			rc = 1;
+	}
+
+	/*
+	 * Reset statistic counters.
+	 */
+	apply_num_insert = 0;
+	apply_num_update = 0;
+	apply_num_delete = 0;
+	apply_num_truncate = 0;
+	apply_num_script = 0;
+	apply_num_prepare = 0;
+	apply_num_hit = 0;
+	apply_num_evict = 0;
+	apply_num_evict_cost = 0;
+	apply_num_resize = 0;
+
+	/*
+	 * That's it.
+	 */
+	SPI_finish();
+	PG_RETURN_INT32(rc);
+}
+
+
+/*
+ * versionFunc(logApplySaveTableStats)()
+ *
+ *	Like logApplySaveStats(), but only saves the per table statistics.
+ *	Used by the additional connections of a parallel apply, which must
+ *	not touch the sl_apply_stats row of the origin.
+ */
+Datum
+versionFunc(logApplySaveTableStats) (PG_FUNCTION_ARGS)
+{
+	Slony_I_ClusterStatus *cs;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySaveTableStats");
+
+	applyBatchFlush();
+
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logApplySaveTableStats()");
+
+	cs = getClusterStatus(PG_GETARG_NAME(0), PLAN_APPLY_QUERIES);
+
+	applyTableStatsSave(cs, PG_GETARG_INT32(1));
+
+	SPI_finish();
+	PG_RETURN_INT32(0);
+}
+
+
+/*
+ * applyTableStatsAdd -
+ *
+ *	Count one applied row of the given cmdtype for a table and add the
+ *	time since start. A cmdtype of '\0' only adds the time.
+ */
+static void
+applyTableStatsAdd(int32 tableid, char cmdtype, instr_time *start)
+{
+	ApplyTableStats *stats;
+	instr_time	elapsed;
+	int64		usec;
+	bool		found;
+
+	if (applyTableStatsHash == NULL)
+	{
+		HASHCTL		hctl;
+
+		memset(&hctl, 0, sizeof(hctl));
+		hctl.keysize = sizeof(int32);
+		hctl.entrysize = sizeof(ApplyTableStats);
+		hctl.hash = tag_hash;
+		applyTableStatsHash = hash_create("Slony-I apply table stats",
+										  64, &hctl,
+										  HASH_ELEM | HASH_FUNCTION);
+	}
+
+	stats = (ApplyTableStats *) hash_search(applyTableStatsHash, &tableid,
+											HASH_ENTER, &found);
+	if (!found)
+	{
+		stats->num_insert = 0;
+		stats->num_update = 0;
+		stats->num_delete = 0;
+		stats->num_truncate = 0;
+		stats->apply_time = 0;
+		stats->max_latency = 0;
+	}
+
+	switch (cmdtype)
+	{
+		case 'I':
+			stats->num_insert++;
+			break;
+		case 'U':
+			stats->num_update++;
+			break;
+		case 'D':
+			stats->num_delete++;
 			break;
 		case 'T':
-			apply_num_truncate++;
+			stats->num_truncate++;
 			break;
 		default:
 			break;
 	}
 
-	/*
-	 * Disconnect from SPI manager and return either the new tuple or NULL
-	 * according to the forwarding of log data.
-	 */
-	SPI_finish();
-	if (cacheEnt->forward)
-		return PointerGetDatum(tg->tg_trigtuple);
-	else
-		return PointerGetDatum(NULL);
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, *start);
+	usec = (int64) INSTR_TIME_GET_MICROSEC(elapsed);
+	stats->apply_time += usec;
+	if (usec > stats->max_latency)
+		stats->max_latency = usec;
+}
+
+
+/*
+ * applyTableStatsSave -
+ *
+ *	Add the per table counters to sl_apply_table_stats and reset them.
+ *	The caller must be connected to SPI.
+ */
+static void
+applyTableStatsSave(Slony_I_ClusterStatus * cs, int32 origin)
+{
+	HASH_SEQ_STATUS status;
+	ApplyTableStats *stats;
+	Datum		params[8];
+	int			spi_rc;
+
+	if (applyTableStatsHash == NULL)
+		return;
+
+	hash_seq_init(&status, applyTableStatsHash);
+	while ((stats = (ApplyTableStats *) hash_seq_search(&status)) != NULL)
+	{
+		params[0] = Int32GetDatum(origin);
+		params[1] = Int32GetDatum(stats->tableid);
+		params[2] = Int64GetDatum(stats->num_insert);
+		params[3] = Int64GetDatum(stats->num_update);
+		params[4] = Int64GetDatum(stats->num_delete);
+		params[5] = Int64GetDatum(stats->num_truncate);
+		params[6] = Int64GetDatum(stats->apply_time);
+		params[7] = Int64GetDatum(stats->max_latency);
+
+		if ((spi_rc = SPI_execp(cs->plan_apply_table_stats_update,
+								params, NULL, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() to update apply table stats "
+				 "failed - rc=%d", spi_rc);
+		if (SPI_processed == 0 &&
+			(spi_rc = SPI_execp(cs->plan_apply_table_stats_insert,
+								params, NULL, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() to insert apply table stats "
+				 "failed - rc=%d", spi_rc);
+	}
+
+	applyTableStatsReset();
+}
+
+
+/*
+ * applyTableStatsReset -
+ *
+ *	Forget the per table counters.
+ */
+static void
+applyTableStatsReset(void)
+{
+	if (applyTableStatsHash != NULL)
+		hash_destroy(applyTableStatsHash);
+	applyTableStatsHash = NULL;
+}
+
+
+static uint32
+applyCache_hash(const void *kp, Size ksize)
+{
+	const ApplyCacheKey *key = (const ApplyCacheKey *) kp;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) key,
+								   offsetof(ApplyCacheKey, colnames)));
+}
+
+
+static int
+applyCache_cmp(const void *kp1, const void *kp2, Size ksize)
+{
+	const ApplyCacheKey *key1 = (const ApplyCacheKey *) kp1;
+	const ApplyCacheKey *key2 = (const ApplyCacheKey *) kp2;
+	int			i;
+
+	if (memcmp(key1, key2, offsetof(ApplyCacheKey, colnames)) != 0)
+		return 1;
+
+	for (i = 0; i < key1->ncols * 2; i += 2)
+	{
+		text	   *name1 = DatumGetTextPP(key1->colnames[i]);
+		text	   *name2 = DatumGetTextPP(key2->colnames[i]);
+
+		if (VARSIZE_ANY_EXHDR(name1) != VARSIZE_ANY_EXHDR(name2) ||
+			memcmp(VARDATA_ANY(name1), VARDATA_ANY(name2),
+				   VARSIZE_ANY_EXHDR(name1)) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * applyLogAttnumsGet -
+ *
+ *	Return the attribute numbers of the log table logApply() fires on.
+ */
+static ApplyLogAttnums *
+applyLogAttnumsGet(Relation rel)
+{
+	TupleDesc	tupdesc = rel->rd_att;
+	ApplyLogAttnums *logatt;
+	int			i;
+
+	for (i = 0; i < lengthof(applyLogAttnums); i++)
+	{
+		if (applyLogAttnums[i].reloid == RelationGetRelid(rel))
+			return &(applyLogAttnums[i]);
+	}
+
+	logatt = &(applyLogAttnums[applyLogAttnumsNext]);
+	applyLogAttnumsNext = (applyLogAttnumsNext + 1) % lengthof(applyLogAttnums);
+
+	logatt->log_origin = SPI_fnumber(tupdesc, "log_origin");
+	logatt->log_txid = SPI_fnumber(tupdesc, "log_txid");
+	logatt->log_tableid = SPI_fnumber(tupdesc, "log_tableid");
+	logatt->log_actionseq = SPI_fnumber(tupdesc, "log_actionseq");
+	logatt->log_tablenspname = SPI_fnumber(tupdesc, "log_tablenspname");
+	logatt->log_tablerelname = SPI_fnumber(tupdesc, "log_tablerelname");
+	logatt->log_cmdtype = SPI_fnumber(tupdesc, "log_cmdtype");
+	logatt->log_cmdupdncols = SPI_fnumber(tupdesc, "log_cmdupdncols");
+	logatt->log_cmdformat = SPI_fnumber(tupdesc, "log_cmdformat");
+	logatt->log_cmdargs = SPI_fnumber(tupdesc, "log_cmdargs");
+	logatt->log_cmdbinargs = SPI_fnumber(tupdesc, "log_cmdbinargs");
+	logatt->reloid = RelationGetRelid(rel);
+
+	return logatt;
+}
+
+
+/*
+ * applyBatchUpdateOk -
+ *
+ *	Check if the UPDATEs of a table can be applied as a batch. The
+ *	planner picks the order in which the rows of the batched UPDATE
+ *	are changed, not log_actionseq. Unique and exclusion constraints
+ *	are checked row by row, so a batch could run into a conflict the
+ *	origin never had, e.g. when one row takes over the unique value
+ *	another row gave up later in the batch. Only the unique index on
+ *	the replication key, whose columns are never changed by a batched
+ *	UPDATE, is safe.
+ */
+static bool
+applyBatchUpdateOk(Oid reloid, char **keynames, int nkeys)
+{
+	Relation	rel;
+	List	   *indexlist;
+	ListCell   *lc;
+	bool		result = true;
+
+	rel = RelationIdGetRelation(reloid);
+	if (rel == NULL)
+		return false;
+	indexlist = RelationGetIndexList(rel);
+	foreach(lc, indexlist)
+	{
+		Relation	indexrel = RelationIdGetRelation(lfirst_oid(lc));
+		Form_pg_index index;
+		bool		iskey;
+		int			i;
+		int			j;
+
+		if (indexrel == NULL)
+		{
+			result = false;
+			break;
+		}
+		index = indexrel->rd_index;
+#if PG_VERSION_NUM >= 90100
+		if (!index->indisunique && !index->indisexclusion)
+#else
+		if (!index->indisunique)
+#endif
+		{
+			RelationClose(indexrel);
+			continue;
+		}
+
+		/*
+		 * The replication key is a unique index on exactly the key
+		 * columns, without expressions.
+		 */
+		iskey = (index->indisunique && index->indnatts == nkeys &&
+				 RelationGetIndexExpressions(indexrel) == NIL);
+		for (i = 0; iskey && i < index->indnatts; i++)
+		{
+			AttrNumber	attnum = index->indkey.values[i];
+
+			iskey = false;
+			for (j = 0; attnum > 0 && j < nkeys; j++)
+			{
+				if (strcmp(NameStr(rel->rd_att->attrs[attnum - 1]->attname),
+						   keynames[j]) == 0)
+					iskey = true;
+			}
+		}
+		RelationClose(indexrel);
+		if (!iskey)
+		{
+			result = false;
+			break;
+		}
+	}
+	list_free(indexlist);
+	RelationClose(rel);
+
+	return result;
+}
+
+
+/*
+ * applyBatchPrepare -
+ *
+ *	Build the set-based form of a newly prepared INSERT, UPDATE or
+ *	DELETE apply query. Every parameter becomes an array, and the rows
+ *	are taken out of them with
+ *
+ *		SELECT ($1)[g] AS p1, ... FROM generate_series(1, n) AS g
+ *
+ *	The query is only prepared when a batch of more than one row is
+ *	applied for the first time.
+ */
+static void
+applyBatchPrepare(ApplyCacheEntry * cacheEnt, char cmdtype,
+				  char *nspname, char *relname, Datum *cmdargs,
+				  int cmdargsn, int cmdupdncols)
+{
+	MemoryContext oldContext;
+	StringInfoData query;
+	char	  **colnames;
+	int			nvals = cmdargsn / 2;
+	int			i;
+	int			j;
+
+	cacheEnt->nvals = nvals;
+	cacheEnt->batchQuery = NULL;
+	cacheEnt->batchPlan = NULL;
+	if (nvals == 0 || (cmdtype != 'I' && cmdtype != 'U' && cmdtype != 'D'))
+		return;
+
+	colnames = (char **) palloc(sizeof(char *) * nvals);
+	for (i = 0; i < nvals; i++)
+	{
+		colnames[i] = DatumGetCString(DirectFunctionCall1(textout,
+														  cmdargs[i * 2]));
+		if (get_array_type(cacheEnt->coltype[i]) == InvalidOid)
+			return;
+	}
+
+	/*
+	 * An UPDATE that changes a key column could make one row of the batch
+	 * see a key that another row of the same statement just created.
+	 */
+	if (cmdtype == 'U')
+	{
+		for (i = 0; i < cmdupdncols; i++)
+		{
+			for (j = cmdupdncols; j < nvals; j++)
+			{
+				if (strcmp(colnames[i], colnames[j]) == 0)
+					return;
+			}
+		}
+		if (!applyBatchUpdateOk(cacheEnt->reloid, colnames + cmdupdncols,
+								nvals - cmdupdncols))
+			return;
+	}
+
+	oldContext = MemoryContextSwitchTo(applyCacheContext);
+	initStringInfo(&query);
+	switch (cmdtype)
+	{
+		case 'I':
+			appendStringInfo(&query, "INSERT INTO %s.%s (",
+							 slon_quote_identifier(nspname),
+							 slon_quote_identifier(relname));
+			for (i = 0; i < nvals; i++)
+				appendStringInfo(&query, "%s%s", (i > 0) ? ", " : "",
+								 slon_quote_identifier(colnames[i]));
+			appendStringInfo(&query, ") SELECT ");
+			for (i = 0; i < nvals; i++)
+				appendStringInfo(&query, "%sV.p%d", (i > 0) ? ", " : "",
+								 i + 1);
+			appendStringInfo(&query, " FROM ");
+			break;
+
+		case 'U':
+			appendStringInfo(&query, "UPDATE ONLY %s.%s AS T SET ",
+							 slon_quote_identifier(nspname),
+							 slon_quote_identifier(relname));
+			if (cmdupdncols == 0)
+				appendStringInfo(&query, "%s = T.%s",
+								 slon_quote_identifier(colnames[0]),
+								 slon_quote_identifier(colnames[0]));
+			for (i = 0; i < cmdupdncols; i++)
+				appendStringInfo(&query, "%s%s = V.p%d", (i > 0) ? ", " : "",
+								 slon_quote_identifier(colnames[i]), i + 1);
+			appendStringInfo(&query, " FROM ");
+			break;
+
+		case 'D':
+			appendStringInfo(&query, "DELETE FROM ONLY %s.%s AS T USING ",
+							 slon_quote_identifier(nspname),
+							 slon_quote_identifier(relname));
+			break;
+	}
+
+	appendStringInfo(&query, "(SELECT ");
+	for (i = 0; i < nvals; i++)
+		appendStringInfo(&query, "%s($%d)[g] AS p%d", (i > 0) ? ", " : "",
+						 i + 1, i + 1);
+	appendStringInfo(&query, " FROM pg_catalog.generate_series(1, "
+					 "pg_catalog.array_upper($1, 1)) AS g) AS V");
+
+	if (cmdtype != 'I')
+	{
+		for (i = (cmdtype == 'U') ? cmdupdncols : 0; i < nvals; i++)
+			appendStringInfo(&query, "%sT.%s = V.p%d",
+							 (i == ((cmdtype == 'U') ? cmdupdncols : 0)) ?
+							 " WHERE " : " AND ",
+							 slon_quote_identifier(colnames[i]), i + 1);
+	}
+
+	cacheEnt->batchQuery = query.data;
+	cacheEnt->typlen = (int16 *) palloc(sizeof(int16) * nvals);
+	cacheEnt->typbyval = (bool *) palloc(sizeof(bool) * nvals);
+	cacheEnt->typalign = (char *) palloc(sizeof(char) * nvals);
+	MemoryContextSwitchTo(oldContext);
+
+	for (i = 0; i < nvals; i++)
+		get_typlenbyvalalign(cacheEnt->coltype[i], &(cacheEnt->typlen[i]),
+							 &(cacheEnt->typbyval[i]),
+							 &(cacheEnt->typalign[i]));
+}
+
+
+/*
+ * applyBatchLimit -
+ *
+ *	The number of rows a batch for this apply query may hold.
+ */
+static int
+applyBatchLimit(ApplyCacheEntry * cacheEnt)
+{
+	if (cacheEnt->key.cmdtype == 'I' && applyInsertBatchSize > applyBatchSize)
+		return applyInsertBatchSize;
+	return applyBatchSize;
+}
+
+
+/*
+ * applyBatchAdd -
+ *
+ *	Add the converted values of one log row to the batch, applying
+ *	the batch first if the row cannot be part of it and afterwards if
+ *	it is full.
+ */
+static void
+applyBatchAdd(ApplyCacheEntry * cacheEnt, Datum *queryvals,
+			  char *querynulls, bool binary, uint32 keyhash)
+{
+	Datum	   *values;
+	bool	   *nulls;
+	int			i;
+
+	if (applyBatchUsed > 0 && applyBatchBinary != binary)
+		applyBatchFlush();
+	if (applyBatchUsed > 0 && cacheEnt->key.cmdtype == 'U' &&
+		applyBatchKeyFind(keyhash, false))
+		applyBatchFlush();
+
+	if (applyBatchUsed == 0)
+	{
+		MemoryContext oldContext;
+
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+		logTrigCallbacksInit();
+#endif
+		if (applyBatchContext == NULL)
+			applyBatchContext = AllocSetContextCreate(TopTransactionContext,
+													  "Slony-I apply batch",
+													ALLOCSET_DEFAULT_MINSIZE,
+												   ALLOCSET_DEFAULT_INITSIZE,
+												   ALLOCSET_DEFAULT_MAXSIZE);
+		oldContext = MemoryContextSwitchTo(applyBatchContext);
+		applyBatchValues = (Datum *)
+			palloc(sizeof(Datum) * applyBatchLimit(cacheEnt) * cacheEnt->nvals);
+		applyBatchNulls = (bool *)
+			palloc(sizeof(bool) * applyBatchLimit(cacheEnt) * cacheEnt->nvals);
+		if (cacheEnt->key.cmdtype == 'U')
+		{
+			/*
+			 * At least twice as many slots as keys, so probe sequences
+			 * stay short.
+			 */
+			applyBatchKeyMask = 1;
+			while (applyBatchKeyMask < (uint32) applyBatchLimit(cacheEnt) * 2)
+				applyBatchKeyMask <<= 1;
+			applyBatchKeys = (uint32 *)
+				palloc(sizeof(uint32) * applyBatchKeyMask);
+			applyBatchKeyUsed = (bool *)
+				palloc0(sizeof(bool) * applyBatchKeyMask);
+			applyBatchKeyMask--;
+		}
+		MemoryContextSwitchTo(oldContext);
+
+		applyBatchEnt = cacheEnt;
+		applyBatchBinary = binary;
+	}
+
+	values = &(applyBatchValues[applyBatchUsed * cacheEnt->nvals]);
+	nulls = &(applyBatchNulls[applyBatchUsed * cacheEnt->nvals]);
+	for (i = 0; i < cacheEnt->nvals; i++)
+	{
+		nulls[i] = (querynulls[i] == 'n');
+		if (nulls[i])
+			values[i] = (Datum) 0;
+		else
+		{
+			MemoryContext oldContext;
+
+			oldContext = MemoryContextSwitchTo(applyBatchContext);
+			values[i] = datumCopy(queryvals[i], cacheEnt->typbyval[i],
+								  cacheEnt->typlen[i]);
+			MemoryContextSwitchTo(oldContext);
+		}
+	}
+	if (cacheEnt->key.cmdtype == 'U')
+		applyBatchKeyFind(keyhash, true);
+	applyBatchUsed++;
+
+	if (applyBatchUsed >= applyBatchLimit(cacheEnt))
+		applyBatchFlush();
+}
+
+
+/*
+ * applyBatchKeyFind -
+ *
+ *	Tell if the key hash of an UPDATE is in the pending batch already.
+ *	If not and enter is true, add it.
+ */
+static bool
+applyBatchKeyFind(uint32 keyhash, bool enter)
+{
+	uint32		slot = keyhash & applyBatchKeyMask;
+
+	while (applyBatchKeyUsed[slot])
+	{
+		if (applyBatchKeys[slot] == keyhash)
+			return true;
+		slot = (slot + 1) & applyBatchKeyMask;
+	}
+	if (enter)
+	{
+		applyBatchKeys[slot] = keyhash;
+		applyBatchKeyUsed[slot] = true;
+	}
+	return false;
+}
+
+
+/*
+ * applyBatchFlush -
+ *
+ *	Apply the pending batch.
+ */
+static void
+applyBatchFlush(void)
+{
+	ApplyCacheEntry *cacheEnt = applyBatchEnt;
+	int			nvals;
+	int			spi_rc;
+	int			i;
+	int			j;
+	instr_time	flush_start;
+
+	if (applyBatchUsed == 0)
+		return;
+	nvals = cacheEnt->nvals;
+	INSTR_TIME_SET_CURRENT(flush_start);
+
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in applyBatchFlush()");
+
+	if (applyBatchUsed == 1)
+	{
+		char	   *querynulls = (char *) palloc(nvals + 1);
+
+		for (j = 0; j < nvals; j++)
+			querynulls[j] = applyBatchNulls[j] ? 'n' : ' ';
+		querynulls[nvals] = '\0';
+		if ((spi_rc = SPI_execp(cacheEnt->plan, applyBatchValues,
+								querynulls, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() failed - rc=%d", spi_rc);
+	}
+	else
+	{
+		Datum	   *arrays = (Datum *) palloc(sizeof(Datum) * nvals);
+		Datum	   *elems = (Datum *) palloc(sizeof(Datum) * applyBatchUsed);
+		bool	   *elemnulls = (bool *) palloc(sizeof(bool) * applyBatchUsed);
+		int			dims[1];
+		int			lbs[1];
+
+		if (cacheEnt->batchPlan == NULL)
+		{
+			Oid		   *argtypes = (Oid *) palloc(sizeof(Oid) * nvals);
+
+			for (j = 0; j < nvals; j++)
+				argtypes[j] = get_array_type(cacheEnt->coltype[j]);
+			cacheEnt->batchPlan = SPI_saveplan(
+					 SPI_prepare(cacheEnt->batchQuery, nvals, argtypes));
+			if (cacheEnt->batchPlan == NULL)
+				elog(ERROR, "Slony-I: SPI_prepare() failed for query '%s'",
+					 cacheEnt->batchQuery);
+		}
+
+		dims[0] = applyBatchUsed;
+		lbs[0] = 1;
+		for (j = 0; j < nvals; j++)
+		{
+			for (i = 0; i < applyBatchUsed; i++)
+			{
+				elems[i] = applyBatchValues[i * nvals + j];
+				elemnulls[i] = applyBatchNulls[i * nvals + j];
+			}
+			arrays[j] = PointerGetDatum(construct_md_array(elems, elemnulls,
+											   1, dims, lbs,
+											   cacheEnt->coltype[j],
+											   cacheEnt->typlen[j],
+											   cacheEnt->typbyval[j],
+											   cacheEnt->typalign[j]));
+		}
+
+		if ((spi_rc = SPI_execp(cacheEnt->batchPlan, arrays, NULL, 0)) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() failed for batch - rc=%d",
+				 spi_rc);
+	}
+
+	SPI_finish();
+	applyTableStatsAdd(cacheEnt->key.tableid, '\0', &flush_start);
+
+	MemoryContextReset(applyBatchContext);
+	applyBatchValues = NULL;
+	applyBatchNulls = NULL;
+	applyBatchKeys = NULL;
+	applyBatchKeyUsed = NULL;
+	applyBatchKeyMask = 0;
+	applyBatchEnt = NULL;
+	applyBatchUsed = 0;
+}
+
+
+/*
+ * applyBatchReset -
+ *
+ *	Forget the batch at the end of the transaction. Its memory goes
+ *	away with TopTransactionContext.
+ */
+static void
+applyBatchReset(void)
+{
+	applyBatchContext = NULL;
+	applyBatchValues = NULL;
+	applyBatchNulls = NULL;
+	applyBatchKeys = NULL;
+	applyBatchKeyUsed = NULL;
+	applyBatchKeyMask = 0;
+	applyBatchEnt = NULL;
+	applyBatchUsed = 0;
+}
+
+
+/*
+ * applyCacheReset -
+ *
+ *	Throw away all prepared apply queries and start over with an empty
+ *	apply cache.
+ */
+static void
+applyCacheReset(void)
+{
+	static bool callback_registered = false;
+	ApplyCacheEntry *cacheEnt;
+	HASHCTL		hctl;
+
+	/*
+	 * Free all prepared apply queries.
+	 */
+	for (cacheEnt = applyCacheHead; cacheEnt; cacheEnt = cacheEnt->next)
+	{
+		if (cacheEnt->plan != NULL)
+			SPI_freeplan(cacheEnt->plan);
+		if (cacheEnt->batchPlan != NULL)
+			SPI_freeplan(cacheEnt->batchPlan);
+		cacheEnt->plan = NULL;
+		cacheEnt->batchPlan = NULL;
+	}
+	applyCacheHead = NULL;
+	applyCacheTail = NULL;
+	applyCacheUsed = 0;
+
+	/*
+	 * Destroy and recreate the hashtable for the apply cache
+	 */
+	if (applyCacheHash != NULL)
+		hash_destroy(applyCacheHash);
+	memset(&hctl, 0, sizeof(hctl));
+	hctl.keysize = sizeof(ApplyCacheKey);
+	hctl.entrysize = sizeof(ApplyCacheEntry);
+	hctl.hash = applyCache_hash;
+	hctl.match = applyCache_cmp;
+	applyCacheHash = hash_create("Slony-I apply cache",
+								 50, &hctl,
+								 HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+
+	/*
+	 * Reset or create the apply cache key memory context.
+	 */
+	if (applyCacheContext == NULL)
+	{
+		applyCacheContext = AllocSetContextCreate(
+												  TopMemoryContext,
+												  "Slony-I apply query keys",
+												  ALLOCSET_DEFAULT_MINSIZE,
+												  ALLOCSET_DEFAULT_INITSIZE,
+												  ALLOCSET_DEFAULT_MAXSIZE);
+	}
+	else
+	{
+		MemoryContextReset(applyCacheContext);
+	}
+
+	if (!callback_registered)
+	{
+		CacheRegisterRelcacheCallback(applyCacheRelCallback, (Datum) 0);
+		callback_registered = true;
+	}
+
+	applyCacheValid = true;
+	applyCacheStale = false;
+}
+
+
+/*
+ * applyCacheRemove -
+ *
+ *	Remove one entry from the apply cache and free its plan.
+ */
+static void
+applyCacheRemove(ApplyCacheEntry * cacheEnt)
+{
+	ApplyCacheKey key = cacheEnt->key;
+	bool		found;
+	int			i;
+
+	applyCacheRelease(cacheEnt);
+
+	if (cacheEnt->prev == NULL)
+		applyCacheHead = cacheEnt->next;
+	else
+		cacheEnt->prev->next = cacheEnt->next;
+	if (cacheEnt->next == NULL)
+		applyCacheTail = cacheEnt->prev;
+	else
+		cacheEnt->next->prev = cacheEnt->prev;
+
+	hash_search(applyCacheHash, &key, HASH_REMOVE, &found);
+	if (!found)
+		elog(ERROR, "Slony-I: cached queries hash entry not found "
+			 "on evict");
+	if (key.colnames != NULL)
+	{
+		for (i = 0; i < key.ncols * 2; i += 2)
+			pfree(DatumGetPointer(key.colnames[i]));
+		pfree(key.colnames);
+	}
+
+	applyCacheUsed--;
+}
+
+
+/*
+ * applyCacheRelease -
+ *
+ *	Free the plans and arrays of an apply cache entry. Pointers not
+ *	allocated yet are NULL, so this also works on an entry whose
+ *	preparation failed half way.
+ */
+static void
+applyCacheRelease(ApplyCacheEntry * cacheEnt)
+{
+	MemoryContext oldContext;
+
+	if (cacheEnt->plan != NULL)
+		SPI_freeplan(cacheEnt->plan);
+	if (cacheEnt->batchPlan != NULL)
+		SPI_freeplan(cacheEnt->batchPlan);
+
+	oldContext = MemoryContextSwitchTo(applyCacheContext);
+	if (cacheEnt->finfo_input != NULL)
+		pfree(cacheEnt->finfo_input);
+	if (cacheEnt->typioparam != NULL)
+		pfree(cacheEnt->typioparam);
+	if (cacheEnt->typmod != NULL)
+		pfree(cacheEnt->typmod);
+	if (cacheEnt->coltype != NULL)
+		pfree(cacheEnt->coltype);
+	if (cacheEnt->have_recv != NULL)
+		pfree(cacheEnt->have_recv);
+	if (cacheEnt->finfo_recv != NULL)
+		pfree(cacheEnt->finfo_recv);
+	if (cacheEnt->typioparam_recv != NULL)
+		pfree(cacheEnt->typioparam_recv);
+	if (cacheEnt->batchQuery != NULL)
+		pfree(cacheEnt->batchQuery);
+	if (cacheEnt->typlen != NULL)
+		pfree(cacheEnt->typlen);
+	if (cacheEnt->typbyval != NULL)
+		pfree(cacheEnt->typbyval);
+	if (cacheEnt->typalign != NULL)
+		pfree(cacheEnt->typalign);
+	MemoryContextSwitchTo(oldContext);
+
+	cacheEnt->plan = NULL;
+	cacheEnt->batchPlan = NULL;
+	cacheEnt->finfo_input = NULL;
+	cacheEnt->typioparam = NULL;
+	cacheEnt->typmod = NULL;
+	cacheEnt->coltype = NULL;
+	cacheEnt->have_recv = NULL;
+	cacheEnt->finfo_recv = NULL;
+	cacheEnt->typioparam_recv = NULL;
+	cacheEnt->batchQuery = NULL;
+	cacheEnt->typlen = NULL;
+	cacheEnt->typbyval = NULL;
+	cacheEnt->typalign = NULL;
+	cacheEnt->ready = false;
+}
+
+
+/*
+ * applyCacheEvict -
+ *
+ *	Evict the entry that is cheapest to prepare again among the least
+ *	recently used ones. The most recently used entry is never evicted.
+ */
+static void
+applyCacheEvict(void)
+{
+	ApplyCacheEntry *victim = applyCacheHead;
+	ApplyCacheEntry *cacheEnt;
+	int			n = 0;
+
+	for (cacheEnt = applyCacheHead;
+		 cacheEnt != NULL && cacheEnt != applyCacheTail &&
+		 n < APPLY_CACHE_EVICT_CANDIDATES;
+		 cacheEnt = cacheEnt->next, n++)
+	{
+		if (cacheEnt->prepcost < victim->prepcost)
+			victim = cacheEnt;
+	}
+
+	if (victim != applyCacheHead)
+		apply_num_evict_cost++;
+	apply_num_evict++;
+	applyAdaptEvicts++;
+	applyCacheRemove(victim);
+}
+
+
+/*
+ * applyCacheAdapt -
+ *
+ *	Adjust the cache size to the hit and evict rates seen since the
+ *	last adjustment. Called at the start of a transaction.
+ */
+static void
+applyCacheAdapt(void)
+{
+	int			newSize = applyCacheSize;
+
+	if (applyCacheSizeMax <= applyCacheSizeBase ||
+		applyAdaptLookups < APPLY_CACHE_ADAPT_LOOKUPS)
+		return;
+
+	if (applyAdaptEvicts * APPLY_CACHE_EVICT_RATE > applyAdaptLookups)
+		newSize = Min(applyCacheSizeMax, applyCacheSize + applyCacheSize / 2);
+	else if (applyAdaptEvicts == 0 && applyCacheUsed < applyCacheSize / 2)
+		newSize = Max(applyCacheSizeBase, applyCacheUsed + applyCacheUsed / 2);
+
+	if (newSize != applyCacheSize)
+	{
+		elog(DEBUG1, "Slony-I: apply cache size changed from %d to %d "
+			 "after " INT64_FORMAT " lookups with " INT64_FORMAT " evictions",
+			 applyCacheSize, newSize, applyAdaptLookups, applyAdaptEvicts);
+		apply_num_resize++;
+		applyCacheSize = newSize;
+	}
+	applyAdaptLookups = 0;
+	applyAdaptEvicts = 0;
+}
+
+
+/*
+ * applyCacheRelCallback -
+ *
+ *	Relcache invalidation callback. Marks the apply cache entries of
+ *	the relation as invalid. They are removed by the next logApply()
+ *	call, since the callback can fire while an entry is in use.
+ */
+static void
+applyCacheRelCallback(Datum arg, Oid relid)
+{
+	ApplyCacheEntry *cacheEnt;
+	int			i;
+
+	for (i = 0; i < lengthof(applyLogAttnums); i++)
+	{
+		if (relid == InvalidOid || applyLogAttnums[i].reloid == relid)
+			applyLogAttnums[i].reloid = InvalidOid;
+	}
+
+	if (relid == InvalidOid)
+	{
+		applyCacheValid = false;
+		return;
+	}
+
+	for (cacheEnt = applyCacheHead; cacheEnt; cacheEnt = cacheEnt->next)
+	{
+		if (cacheEnt->reloid == relid)
+		{
+			cacheEnt->valid = false;
+			applyCacheStale = true;
+		}
+	}
+}
+
+
+static void
+applyQueryReset(void)
+{
+	if (applyQuery == NULL)
+	{
+		applyQuery = malloc(applyQuerySize);
+		if (applyQuery == NULL)
+			elog(ERROR, "Slony-I: applyQueryReset(): out of memory");
+	}
+
+	applyQueryPos = applyQuery;
+}
+
+
+static void
+applyQueryIncrease(void)
+{
+	if (applyQueryPos - applyQuery + 1024 > applyQuerySize)
+	{
+		size_t		offset = applyQueryPos - applyQuery;
+
+		applyQuerySize *= 2;
+		applyQuery = realloc(applyQuery, applyQuerySize);
+		if (applyQuery == NULL)
+			elog(ERROR, "Slony-I: applyQueryIncrease(): out of memory");
+		applyQueryPos = applyQuery + offset;
+	}
+}
+
+
+/*
+ * applyBinaryValue -
+ *
+ *	Convert a value captured in the binary log format into a Datum
+ *	of the target column type. If the column has the same type as on
+ *	the origin, the value is fed straight into the type's receive
+ *	function. Otherwise we go through the text representation.
+ */
+static Datum
+applyBinaryValue(ApplyCacheEntry * cacheEnt, int idx, Datum binval)
+{
+	StringInfoData buf;
+	Oid			typid;
+	Datum		result;
+	char	   *tmpval;
+
+	typid = slon_binary_header(binval, &buf);
+	if (typid != cacheEnt->coltype[idx])
+	{
+		pfree(buf.data);
+		tmpval = slon_binary_to_cstring(binval);
+		result = InputFunctionCall(&(cacheEnt->finfo_input[idx]), tmpval,
+								   cacheEnt->typioparam[idx],
+								   cacheEnt->typmod[idx]);
+		pfree(tmpval);
+		return result;
+	}
+
+	if (!cacheEnt->have_recv[idx])
+	{
+		Oid			typreceive;
+
+		getTypeBinaryInputInfo(typid, &typreceive,
+							   &(cacheEnt->typioparam_recv[idx]));
+		fmgr_info_cxt(typreceive, &(cacheEnt->finfo_recv[idx]),
+					  applyCacheContext);
+		cacheEnt->have_recv[idx] = true;
+	}
+
+	result = ReceiveFunctionCall(&(cacheEnt->finfo_recv[idx]), &buf,
+								 cacheEnt->typioparam_recv[idx],
+								 cacheEnt->typmod[idx]);
+	if (buf.cursor != buf.len)
+		elog(ERROR, "Slony-I: incorrect binary data format in "
+			 "log_cmdbinargs");
+	pfree(buf.data);
+
+	return result;
+}
+
+
+/*
+ * slon_binary_header -
+ *
+ *	Split a log_cmdbinargs element into the type OID it was sent as
+ *	and a StringInfo holding the send function output.
+ */
+static Oid
+slon_binary_header(Datum binval, StringInfo buf)
+{
+	bytea	   *val = DatumGetByteaP(binval);
+	unsigned char *p = (unsigned char *) VARDATA(val);
+	int			len = VARSIZE(val) - VARHDRSZ;
+
+	if (len < 4)
+		elog(ERROR, "Slony-I: invalid log_cmdbinargs element");
+
+	initStringInfo(buf);
+	appendBinaryStringInfo(buf, (char *) (p + 4), len - 4);
+
+	return ((Oid) p[0] << 24) | ((Oid) p[1] << 16) |
+		((Oid) p[2] << 8) | (Oid) p[3];
+}
+
+
+/*
+ * slon_binary_to_cstring -
+ *
+ *	Return the text representation of a log_cmdbinargs element.
+ *	Like the log trigger does for text values, date values are
+ *	always formatted in ISO style, whatever the session DateStyle.
+ */
+static char *
+slon_binary_to_cstring(Datum binval)
+{
+	StringInfoData buf;
+	Oid			typid;
+	Oid			typreceive;
+	Oid			typioparam;
+	Oid			typoutput;
+	bool		typisvarlena;
+	Datum		value;
+	char	   *result = NULL;
+	int			save_datestyle = DateStyle;
+
+	typid = slon_binary_header(binval, &buf);
+
+	getTypeBinaryInputInfo(typid, &typreceive, &typioparam);
+	value = OidReceiveFunctionCall(typreceive, &buf, typioparam, -1);
+	if (buf.cursor != buf.len)
+		elog(ERROR, "Slony-I: incorrect binary data format in "
+			 "log_cmdbinargs");
+	pfree(buf.data);
+
+	getTypeOutputInfo(typid, &typoutput, &typisvarlena);
+	if (DateStyle == USE_ISO_DATES || !slon_datestyle_type(typid))
+		return OidOutputFunctionCall(typoutput, value);
+
+	DateStyle = USE_ISO_DATES;
+	PG_TRY();
+	{
+		result = OidOutputFunctionCall(typoutput, value);
+	}
+	PG_CATCH();
+	{
+		DateStyle = save_datestyle;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	DateStyle = save_datestyle;
+
+	return result;
+}
+
+
+/*
+ * versionFunc(logCmdArgsText) -
+ *
+ *	Return the log_cmdargs of a log row with all values captured in
+ *	the binary format converted to text. This is used for archive
+ *	logs and anything else that needs the classic log row layout.
+ */
+Datum
+versionFunc(logCmdArgsText) (PG_FUNCTION_ARGS)
+{
+	ArrayType  *cmdargs_arr;
+	ArrayType  *binargs_arr;
+	Datum	   *cmdargs;
+	bool	   *cmdargsnulls;
+	int			cmdargsn;
+	Datum	   *binargs;
+	bool	   *binargsnulls;
+	int			binargsn;
+	int			dims[1];
+	int			lbs[1];
+	int			i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+	cmdargs_arr = PG_GETARG_ARRAYTYPE_P(0);
+	if (PG_ARGISNULL(1))
+		PG_RETURN_ARRAYTYPE_P(cmdargs_arr);
+	binargs_arr = PG_GETARG_ARRAYTYPE_P(1);
+
+	deconstruct_array(cmdargs_arr, TEXTOID, -1, false, 'i',
+					  &cmdargs, &cmdargsnulls, &cmdargsn);
+	deconstruct_array(binargs_arr, BYTEAOID, -1, false, 'i',
+					  &binargs, &binargsnulls, &binargsn);
+	if (binargsn != cmdargsn / 2)
+		elog(ERROR, "Slony-I: log_cmdbinargs has %d elements, expected %d",
+			 binargsn, cmdargsn / 2);
+
+	for (i = 0; i < binargsn; i++)
+	{
+		if (binargsnulls[i])
+			continue;
+		cmdargs[i * 2 + 1] = DirectFunctionCall1(textin,
+						CStringGetDatum(slon_binary_to_cstring(binargs[i])));
+		cmdargsnulls[i * 2 + 1] = false;
+	}
+
+	if (cmdargsn == 0)
+		PG_RETURN_ARRAYTYPE_P(cmdargs_arr);
+
+	dims[0] = cmdargsn;
+	lbs[0] = 1;
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(cmdargs, cmdargsnulls, 1,
+								dims, lbs, TEXTOID, -1, false, 'i'));
+}
+
+
+/*
+ * Sorted and merged action sequence ranges of logActionseqInRanges(),
+ * kept in fn_extra. Unless the ranges argument is a constant or a
+ * parameter, the array they were built from is kept as well.
+ */
+typedef struct ActionseqRanges
+{
+	bool		stable;
+	ArrayType  *source;
+	int			nranges;
+	int64	   *ranges;			/* lo, hi pairs */
+} ActionseqRanges;
+
+
+static int
+actionseqRangeCmp(const void *a, const void *b)
+{
+	int64		lo_a = ((const int64 *) a)[0];
+	int64		lo_b = ((const int64 *) b)[0];
+
+	if (lo_a < lo_b)
+		return -1;
+	if (lo_a > lo_b)
+		return 1;
+	return 0;
+}
+
+
+/*
+ * versionFunc(logActionseqInRanges) -
+ *
+ *	Check if a log_actionseq falls into one of the ranges given as an
+ *	array of lo, hi pairs. slon uses this to skip the log rows that
+ *	were already contained in the copy of a set. The ranges are
+ *	sorted once per query, so every row costs a binary search no
+ *	matter how long the action list grew. slon passes the ranges as a
+ *	constant, in which case the array is not even looked at again.
+ */
+Datum
+versionFunc(logActionseqInRanges) (PG_FUNCTION_ARGS)
+{
+	int64		actionseq = PG_GETARG_INT64(0);
+	ArrayType  *ranges_arr = NULL;
+	ActionseqRanges *ar = (ActionseqRanges *) fcinfo->flinfo->fn_extra;
+	int			lo;
+	int			hi;
+
+	if (ar == NULL || !ar->stable)
+	{
+		ranges_arr = PG_GETARG_ARRAYTYPE_P(1);
+		if (ar != NULL && (VARSIZE(ar->source) != VARSIZE(ranges_arr) ||
+				 memcmp(ar->source, ranges_arr, VARSIZE(ranges_arr)) != 0))
+		{
+			pfree(ar->source);
+			pfree(ar->ranges);
+			pfree(ar);
+			ar = NULL;
+			fcinfo->flinfo->fn_extra = NULL;
+		}
+	}
+
+	if (ar == NULL)
+	{
+		MemoryContext oldcxt;
+		Datum	   *elems;
+		bool	   *nulls;
+		int			nelems;
+		int16		typlen;
+		bool		typbyval;
+		char		typalign;
+		int			i;
+		int			n;
+
+		get_typlenbyvalalign(INT8OID, &typlen, &typbyval, &typalign);
+		deconstruct_array(ranges_arr, INT8OID, typlen, typbyval, typalign,
+						  &elems, &nulls, &nelems);
+		if (nelems % 2 != 0)
+			elog(ERROR, "Slony-I: action sequence ranges need lo, hi pairs");
+
+		oldcxt = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+		ar = (ActionseqRanges *) palloc0(sizeof(ActionseqRanges));
+		ar->stable = get_fn_expr_arg_stable(fcinfo->flinfo, 1);
+		if (!ar->stable)
+		{
+			ar->source = (ArrayType *) palloc(VARSIZE(ranges_arr));
+			memcpy(ar->source, ranges_arr, VARSIZE(ranges_arr));
+		}
+		ar->ranges = (int64 *) palloc(sizeof(int64) * (nelems + 2));
+		MemoryContextSwitchTo(oldcxt);
+
+		for (i = 0; i < nelems; i++)
+		{
+			if (nulls[i])
+				elog(ERROR, "Slony-I: action sequence ranges cannot be NULL");
+			ar->ranges[i] = DatumGetInt64(elems[i]);
+		}
+		qsort(ar->ranges, nelems / 2, sizeof(int64) * 2, actionseqRangeCmp);
+
+		/*
+		 * Merge overlapping ranges so the search below only has to look
+		 * at the last range starting at or before the actionseq.
+		 */
+		n = 0;
+		for (i = 0; i < nelems / 2; i++)
+		{
+			if (n > 0 && ar->ranges[i * 2] <= ar->ranges[n * 2 - 1])
+			{
+				if (ar->ranges[i * 2 + 1] > ar->ranges[n * 2 - 1])
+					ar->ranges[n * 2 - 1] = ar->ranges[i * 2 + 1];
+				continue;
+			}
+			ar->ranges[n * 2] = ar->ranges[i * 2];
+			ar->ranges[n * 2 + 1] = ar->ranges[i * 2 + 1];
+			n++;
+		}
+		ar->nranges = n;
+		fcinfo->flinfo->fn_extra = ar;
+	}
+
+	lo = 0;
+	hi = ar->nranges - 1;
+	while (lo <= hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (actionseq < ar->ranges[mid * 2])
+			hi = mid - 1;
+		else if (actionseq > ar->ranges[mid * 2 + 1])
+			lo = mid + 1;
+		else
+			PG_RETURN_BOOL(true);
+	}
+	PG_RETURN_BOOL(false);
 }
 
 
+
 /*
- * versionFunc(logApplySetCacheSize)()
+ * syncRowsPlan -
  *
- *	Called by slon during startup to set the size of the log apply
- *	query cache according to the config parameter apply_cache_size.
+ *	Return the saved plan logSyncRows() uses to select the log rows
+ *	of a SYNC from sl_log_1 or sl_log_2, preparing it on first use.
+ *	The first half finds the transactions committed between the two
+ *	snapshots by a range scan on sl_log_N_idx1, the second half the
+ *	ones that were still in progress at the first snapshot.
  */
-Datum
-versionFunc(logApplySetCacheSize) (PG_FUNCTION_ARGS)
+static void *
+syncRowsPlan(Slony_I_ClusterStatus * cs, FunctionCallInfo fcinfo,
+			 int sl_log_no)
 {
-	int32		newSize;
-	int32		oldSize = applyCacheSize;
+	void	  **planp;
+	StringInfoData query;
+	Oid			plan_types[5];
+	int			i;
 
-	if (!superuser())
-		elog(ERROR, "Slony-I: insufficient privilege logApplySetCacheSize");
+	planp = (sl_log_no == 1) ? &cs->plan_sync_rows_1 : &cs->plan_sync_rows_2;
+	if (*planp != NULL)
+		return *planp;
 
-	newSize = PG_GETARG_INT32(0);
+	initStringInfo(&query);
+	for (i = 0; i < 2; i++)
+	{
+		appendStringInfo(&query,
+						 "%sselect log_origin, log_txid, log_tableid, "
+						 "log_actionseq, log_tablenspname, "
+						 "log_tablerelname, log_cmdtype, log_cmdupdncols, "
+						 "log_cmdargs, log_cmdformat, log_cmdbinargs "
+						 "from %s.sl_log_%d "
+						 "where log_origin = $1 "
+						 "and log_tableid = any ($2) ",
+						 (i == 0) ? "" : " union all ",
+						 cs->clusterident, sl_log_no);
+		if (i == 0)
+			appendStringInfo(&query,
+				  "and log_txid >= \"pg_catalog\".txid_snapshot_xmax($3) "
+				   "and log_txid < \"pg_catalog\".txid_snapshot_xmax($4) "
+				 "and \"pg_catalog\".txid_visible_in_snapshot(log_txid, $4) ");
+		else
+			appendStringInfo(&query,
+							 "and log_txid in (select * from "
+							 "\"pg_catalog\".txid_snapshot_xip($3) "
+							 "except select * from "
+							 "\"pg_catalog\".txid_snapshot_xip($4)) ");
+		appendStringInfo(&query,
+						 "and not %s.logActionseqInRanges(log_actionseq, $5)",
+						 cs->clusterident);
+	}
 
-	if (newSize <= 0)
-		PG_RETURN_INT32(oldSize);
+	plan_types[0] = INT4OID;
+	plan_types[1] = INT4ARRAYOID;
+	plan_types[2] = get_fn_expr_argtype(fcinfo->flinfo, 4);
+	plan_types[3] = get_fn_expr_argtype(fcinfo->flinfo, 5);
+	plan_types[4] = INT8ARRAYOID;
 
-	if (newSize < 10 || newSize > 2000)
-		elog(ERROR, "Slony-I: logApplySetCacheSize(): illegal size");
+	*planp = SPI_saveplan(SPI_prepare(query.data, 5, plan_types));
+	if (*planp == NULL)
+		elog(ERROR, "Slony-I: SPI_prepare() failed");
+	pfree(query.data);
 
-	applyCacheSize = newSize;
-	PG_RETURN_INT32(oldSize);
+	return *planp;
 }
 
 
 /*
- * versionFunc(logApplySaveStats)()
+ * versionFunc(logSyncRows) -
  *
- *	Save statistics at the end of SYNC processing.
+ *	Return the log rows of the given tables that a SYNC moving from the
+ *	first to the second snapshot has to replicate, skipping the action
+ *	sequences already contained in a set copy. slon calls this on the
+ *	provider once per set instead of sending the whole selection as
+ *	query text, so the provider plans it only once per session.
  */
 Datum
-versionFunc(logApplySaveStats) (PG_FUNCTION_ARGS)
+versionFunc(logSyncRows) (PG_FUNCTION_ARGS)
 {
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	Slony_I_ClusterStatus *cs;
-	Datum		params[11];
-	char	   *nulls = "           ";
-	int32		rc = 0;
-	int			spi_rc;
-
-	if (!superuser())
-		elog(ERROR, "Slony-I: insufficient privilege logApplySetCacheSize");
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcxt;
+	Datum		argv[5];
+	int32		log_status;
+	int			sl_log_no;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		(rsinfo->allowedModes & SFRM_Materialize) == 0)
+		elog(ERROR, "Slony-I: logSyncRows() called in a context "
+			 "that cannot accept a set");
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "Slony-I: logSyncRows() return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcxt = MemoryContextSwitchTo(per_query_ctx);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	MemoryContextSwitchTo(oldcxt);
 
-	/*
-	 * Connect to the SPI manager
-	 */
 	if (SPI_connect() < 0)
-		elog(ERROR, "Slony-I: SPI_connect() failed in logApply()");
-
-	/*
-	 * Get or create the cluster status information and make sure it has the
-	 * SPI plans that we need here.
-	 */
-	cs = getClusterStatus(PG_GETARG_NAME(0), PLAN_APPLY_QUERIES);
+		elog(ERROR, "Slony-I: SPI_connect() failed in logSyncRows()");
 
-	/*
-	 * Setup the parameter array. Note that both queries use the same
-	 * parameters in exactly the same order.
-	 */
-	params[0] = Int32GetDatum(PG_GETARG_INT32(1));
+	cs = getClusterStatus(PG_GETARG_NAME(0), PLAN_NONE);
 
-	params[1] = Int64GetDatum(apply_num_insert);
-	params[2] = Int64GetDatum(apply_num_update);
-	params[3] = Int64GetDatum(apply_num_delete);
-	params[4] = Int64GetDatum(apply_num_truncate);
-	params[5] = Int64GetDatum(apply_num_script);
-	params[6] = Int64GetDatum(apply_num_insert + apply_num_update +
-				   apply_num_delete + apply_num_truncate * apply_num_script);
-	params[7] = PointerGetDatum(PG_GETARG_INTERVAL_P(2));
-	params[8] = Int64GetDatum(apply_num_prepare);
-	params[9] = Int64GetDatum(apply_num_hit);
-	params[10] = Int64GetDatum(apply_num_evict);
+	argv[0] = PG_GETARG_DATUM(1);
+	log_status = PG_GETARG_INT32(2);
+	argv[1] = PG_GETARG_DATUM(3);
+	argv[2] = PG_GETARG_DATUM(4);
+	argv[3] = PG_GETARG_DATUM(5);
+	argv[4] = PG_GETARG_DATUM(6);
 
-	/*
-	 * Perform the UPDATE of sl_apply_stats. If that doesn't update any
-	 * row(s), try to INSERT one.
-	 */
-	if ((spi_rc = SPI_execp(cs->plan_apply_stats_update, params, nulls, 0)) < 0)
-		elog(ERROR, "Slony-I: SPI_execp() to update apply stats failed"
-			 " - rc=%d", spi_rc);
-	if (SPI_processed > 0)
-	{
-		rc = 2;
-	}
-	else
+	for (sl_log_no = 1; sl_log_no <= 2; sl_log_no++)
 	{
-		if ((spi_rc = SPI_execp(cs->plan_apply_stats_insert, params, nulls, 0)) < 0)
-			elog(ERROR, "Slony-I: SPI_execp() to insert apply stats failed"
-				 " - rc=%d", spi_rc);
-		if (SPI_processed > 0)
-			rc = 1;
-	}
+		Portal		portal;
+		int			i;
 
-	/*
-	 * Reset statistic counters.
-	 */
-	apply_num_insert = 0;
-	apply_num_update = 0;
-	apply_num_delete = 0;
-	apply_num_truncate = 0;
-	apply_num_script = 0;
-	apply_num_prepare = 0;
-	apply_num_hit = 0;
-	apply_num_evict = 0;
+		/*
+		 * sl_log_1 is only used with log_status 0, 2 and 3, sl_log_2
+		 * with 1, 2 and 3.
+		 */
+		if (sl_log_no == 1 && log_status == 1)
+			continue;
+		if (sl_log_no == 2 && log_status == 0)
+			continue;
+
+		portal = SPI_cursor_open(NULL, syncRowsPlan(cs, fcinfo, sl_log_no),
+								 argv, NULL, true);
+		for (;;)
+		{
+			SPI_cursor_fetch(portal, true, SYNC_ROWS_FETCH);
+			if (SPI_processed == 0)
+				break;
 
-	/*
-	 * That's it.
-	 */
-	SPI_finish();
-	PG_RETURN_INT32(rc);
-}
+			oldcxt = MemoryContextSwitchTo(per_query_ctx);
+			for (i = 0; i < SPI_processed; i++)
+				tuplestore_puttuple(tupstore, SPI_tuptable->vals[i]);
+			MemoryContextSwitchTo(oldcxt);
+			SPI_freetuptable(SPI_tuptable);
+		}
+		SPI_cursor_close(portal);
+	}
 
+	SPI_finish();
 
-static uint32
-applyCache_hash(const void *kp, Size ksize)
-{
-	char	   *key = *((char **) kp);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
 
-	return hash_any((void *) key, strlen(key));
+	return (Datum) 0;
 }
 
 
-static int
-applyCache_cmp(const void *kp1, const void *kp2, Size ksize)
+/*
+ * versionFunc(logCoalesceFlush) -
+ *
+ *	Log the coalesced rows of the current transaction now. This is
+ *	called before a DDL script is logged, so that the changes made
+ *	before the script are applied before it.
+ */
+Datum
+versionFunc(logCoalesceFlush) (PG_FUNCTION_ARGS)
 {
-	char	   *key1 = *((char **) kp1);
-	char	   *key2 = *((char **) kp2);
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	if (!logTrigCoalesceSafe())
+		elog(ERROR, "Slony-I: cannot log a DDL script in a subtransaction "
+			 "while changes to coalesced tables of its parent are pending");
+	logTrigCoalesceEmit();
+#endif
 
-	return strcmp(key1, key2);
+	PG_RETURN_NULL();
 }
 
 
-static void
-applyQueryReset(void)
+/*
+ * versionFunc(logCoalesceTruncate) -
+ *
+ *	Forget the coalesced rows of a table that is being truncated. The
+ *	TRUNCATE itself is logged right away, so the rows inserted before
+ *	it must not be logged at commit. Rows that existed before the
+ *	transaction are gone as well.
+ */
+Datum
+versionFunc(logCoalesceTruncate) (PG_FUNCTION_ARGS)
 {
-	if (applyQuery == NULL)
-	{
-		applyQuery = malloc(applyQuerySize);
-		if (applyQuery == NULL)
-			elog(ERROR, "Slony-I: applyQueryReset(): out of memory");
-	}
-
-	applyQueryPos = applyQuery;
-}
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	Oid			reloid = PG_GETARG_OID(0);
+	CoalesceRow *crow;
 
-
-static void
-applyQueryIncrease(void)
-{
-	if (applyQueryPos - applyQuery + 1024 > applyQuerySize)
+	for (crow = coalesceFirst; crow != NULL; crow = crow->next)
 	{
-		size_t		offset = applyQueryPos - applyQuery;
-
-		applyQuerySize *= 2;
-		applyQuery = realloc(applyQuery, applyQuerySize);
-		if (applyQuery == NULL)
-			elog(ERROR, "Slony-I: applyQueryIncrease(): out of memory");
-		applyQueryPos = applyQuery + offset;
+		if (crow->tbl->reloid == reloid)
+			logTrigCoalesceSet(crow, false, NULL, NULL);
 	}
+#endif
+
+	PG_RETURN_NULL();
 }
 
 
@@ -2229,53 +6014,110 @@ versionFunc(killBackend) (PG_FUNCTION_ARGS)
 }
 
 
+/* ----
+ * SeqTrack_elem -
+ *
+ *	The last value of a sequence recorded in sl_seqlog by this backend,
+ *	kept in a hash table that lives for the whole session.
+ * ----
+ */
 typedef struct
 {
 	int32		seqid;
 	int64		seqval;
 }	SeqTrack_elem;
 
-static int
-seqtrack_cmp(void *seq1, void *seq2)
+static HTAB *seqtrackHash = NULL;
+
+static SeqTrack_elem *
+seqtrackEnter(int32 seqid, bool *found)
 {
-	return (((SeqTrack_elem *) seq1)->seqid - ((SeqTrack_elem *) seq2)->seqid);
+	if (seqtrackHash == NULL)
+	{
+		HASHCTL		hctl;
+
+		memset(&hctl, 0, sizeof(hctl));
+		hctl.keysize = sizeof(int32);
+		hctl.entrysize = sizeof(SeqTrack_elem);
+		hctl.hash = tag_hash;
+		hctl.hcxt = TopMemoryContext;
+		seqtrackHash = hash_create("Slony-I seqtrack", 1024, &hctl,
+								   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+	}
+
+	return (SeqTrack_elem *) hash_search(seqtrackHash, &seqid,
+										 HASH_ENTER, found);
 }
 
+
+/*
+ * seqtrackSeed -
+ *
+ *	Preload the sequence tracker with the last values this node has
+ *	recorded in sl_seqlog. Without this, the first SYNC of every new
+ *	connection records all sequences of the node again, changed or
+ *	not. Sequences whose values have already been cleaned out of
+ *	sl_seqlog are recorded again as before. Must be called while
+ *	connected to the SPI manager.
+ */
 static void
-seqtrack_free(void *seq)
+seqtrackSeed(Slony_I_ClusterStatus * cs)
 {
-	free(seq);
+	char		query[1024];
+	int			i;
+
+	if (cs->seqtrack_seeded)
+		return;
+
+	snprintf(query, sizeof(query),
+			 "select distinct on (seql_seqid) seql_seqid, seql_last_value "
+			 "from %s.sl_seqlog where seql_origin = '%d' "
+			 "order by seql_seqid, seql_ev_seqno desc",
+			 cs->clusterident, cs->localNodeId);
+	if (SPI_exec(query, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Slony-I: cannot read last sequence values from sl_seqlog");
+
+	for (i = 0; i < SPI_processed; i++)
+	{
+		SeqTrack_elem *elem;
+		int32		seqid;
+		bool		isnull;
+		bool		found;
+
+		seqid = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[i],
+											SPI_tuptable->tupdesc, 1,
+											&isnull));
+		elem = seqtrackEnter(seqid, &found);
+		if (!found)
+			elem->seqval = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[i],
+												  SPI_tuptable->tupdesc, 2,
+													   &isnull));
+	}
+	SPI_freetuptable(SPI_tuptable);
+
+	cs->seqtrack_seeded = true;
 }
 
+
 Datum
 versionFunc(seqtrack) (PG_FUNCTION_ARGS)
 {
-	static AVLtree seqmem = AVL_INITIALIZER(seqtrack_cmp, seqtrack_free);
-	AVLnode    *node;
 	SeqTrack_elem *elem;
 	int32		seqid;
 	int64		seqval;
+	bool		found;
 
 	seqid = PG_GETARG_INT32(0);
 	seqval = PG_GETARG_INT64(1);
 
-	/*
-	 * Try to insert the sequence id into the AVL tree.
-	 */
-	if ((node = avl_insert(&seqmem, &seqid)) == NULL)
-		elog(ERROR, "Slony-I: unexpected NULL return from avl_insert()");
-
-	if (AVL_DATA(node) == NULL)
+	elem = seqtrackEnter(seqid, &found);
+	if (!found)
 	{
 		/*
-		 * This is a new (not seen before) sequence. Create the element,
-		 * remember the current lastval and return it to the caller.
+		 * This is a new (not seen before) sequence. Remember the current
+		 * lastval and return it to the caller.
 		 */
-		elem = (SeqTrack_elem *) malloc(sizeof(SeqTrack_elem));
-		elem->seqid = seqid;
 		elem->seqval = seqval;
-		AVL_SETDATA(node, elem);
-
 		PG_RETURN_INT64(seqval);
 	}
 
@@ -2283,8 +6125,6 @@ versionFunc(seqtrack) (PG_FUNCTION_ARGS)
 	 * This is a sequence seen before. If the value has changed remember and
 	 * return it. If it did not, return NULL.
 	 */
-	elem = AVL_DATA(node);
-
 	if (elem->seqval == seqval)
 		PG_RETURN_NULL();
 	else
@@ -2589,12 +6429,30 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		/*
 		 * And the plan to read the current log_status.
 		 */
-		sprintf(query, "SELECT last_value::int4 FROM %s.sl_log_status",
-				cs->clusterident);
+		sprintf(query, "SELECT last_value::int4, "
+				"(SELECT reg_int4 FROM %s.sl_registry "
+				" WHERE reg_key = 'logtrigger.format'), "
+				"(SELECT reg_int4 FROM %s.sl_registry "
+				" WHERE reg_key = 'logtrigger.buffer') "
+				"FROM %s.sl_log_status",
+				cs->clusterident, cs->clusterident, cs->clusterident);
 		cs->plan_get_logstatus = SPI_saveplan(SPI_prepare(query, 0, NULL));
 		if (cs->plan_get_logstatus == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 
+		/*
+		 * Buffered log rows get their log_actionseq directly from the
+		 * sequence.
+		 */
+		sprintf(query, "SELECT '%s.sl_action_seq'::regclass::oid",
+				cs->clusterident);
+		rc = SPI_exec(query, 0);
+		if (rc < 0 || SPI_processed != 1)
+			elog(ERROR, "Slony-I: failed to look up sl_action_seq");
+		cs->action_seq_oid = DatumGetObjectId(
+										SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull));
+		SPI_freetuptable(SPI_tuptable);
+
 		cs->have_plan |= PLAN_INSERT_LOG_STATUS;
 	}
 
@@ -2643,6 +6501,21 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		if (cs->plan_table_info == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 
+		/*
+		 * The plan to check if the local node forwards any set at all
+		 */
+		sprintf(query,
+				"select exists (select 1 from %s.sl_subscribe "
+				" where sub_receiver = $1 and sub_forward);",
+				slon_quote_identifier(NameStr(*cluster_name)));
+
+		plan_types[0] = INT4OID;
+
+		cs->plan_node_forwards = SPI_saveplan(
+										   SPI_prepare(query, 1, plan_types));
+		if (cs->plan_node_forwards == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
 		/*
 		 * The plan to update the apply stats
 		 */
@@ -2661,7 +6534,11 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 				" as_cache_evict = as_cache_evict + $11, "
 				" as_cache_prepare_max = case "
 				"     when $9 > as_cache_prepare_max then $9 "
-				"     else as_cache_prepare_max end "
+				"     else as_cache_prepare_max end, "
+				" as_cache_size = $12, "
+				" as_cache_resize = coalesce(as_cache_resize, 0) + $13, "
+				" as_cache_evict_cost = "
+				"     coalesce(as_cache_evict_cost, 0) + $14 "
 				" where as_origin = $1;",
 				slon_quote_identifier(NameStr(*cluster_name)));
 
@@ -2676,9 +6553,12 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		plan_types[8] = INT8OID;
 		plan_types[9] = INT8OID;
 		plan_types[10] = INT8OID;
+		plan_types[11] = INT4OID;
+		plan_types[12] = INT8OID;
+		plan_types[13] = INT8OID;
 
 		cs->plan_apply_stats_update = SPI_saveplan(
-										 SPI_prepare(query, 11, plan_types));
+										 SPI_prepare(query, 14, plan_types));
 		if (cs->plan_apply_stats_update == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 
@@ -2691,12 +6571,13 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 				" as_num_truncate, as_num_script, as_num_total, "
 				" as_duration, as_apply_first, as_apply_last, "
 				" as_cache_prepare, as_cache_hit, as_cache_evict, "
-				" as_cache_prepare_max) "
+				" as_cache_prepare_max, as_cache_size, as_cache_resize, "
+				" as_cache_evict_cost) "
 				"values "
 				"($1, $2, $3, $4, $5, $6, $7, $8, "
 				"\"pg_catalog\".timeofday()::timestamptz, "
 				"\"pg_catalog\".timeofday()::timestamptz, "
-				"$9, $10, $11, $9);",
+				"$9, $10, $11, $9, $12, $13, $14);",
 				slon_quote_identifier(NameStr(*cluster_name)));
 
 		plan_types[0] = INT4OID;
@@ -2710,12 +6591,64 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		plan_types[8] = INT8OID;
 		plan_types[9] = INT8OID;
 		plan_types[10] = INT8OID;
+		plan_types[11] = INT4OID;
+		plan_types[12] = INT8OID;
+		plan_types[13] = INT8OID;
 
 		cs->plan_apply_stats_insert = SPI_saveplan(
-										 SPI_prepare(query, 11, plan_types));
+										 SPI_prepare(query, 14, plan_types));
 		if (cs->plan_apply_stats_insert == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 
+		/*
+		 * The plans to update the per table apply stats or to insert
+		 * them, if update misses
+		 */
+		sprintf(query,
+				"update %s.sl_apply_table_stats set "
+				" ats_num_insert = ats_num_insert + $3, "
+				" ats_num_update = ats_num_update + $4, "
+				" ats_num_delete = ats_num_delete + $5, "
+				" ats_num_truncate = ats_num_truncate + $6, "
+				" ats_duration = ats_duration + "
+				"     $7 * '1 microsecond'::interval, "
+				" ats_max_latency = \"pg_catalog\".greatest(ats_max_latency, "
+				"     $8 * '1 microsecond'::interval), "
+				" ats_apply_last = \"pg_catalog\".timeofday()::timestamptz "
+				" where ats_origin = $1 and ats_tableid = $2;",
+				slon_quote_identifier(NameStr(*cluster_name)));
+
+		plan_types[0] = INT4OID;
+		plan_types[1] = INT4OID;
+		plan_types[2] = INT8OID;
+		plan_types[3] = INT8OID;
+		plan_types[4] = INT8OID;
+		plan_types[5] = INT8OID;
+		plan_types[6] = INT8OID;
+		plan_types[7] = INT8OID;
+
+		cs->plan_apply_table_stats_update = SPI_saveplan(
+										  SPI_prepare(query, 8, plan_types));
+		if (cs->plan_apply_table_stats_update == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+		sprintf(query,
+				"insert into %s.sl_apply_table_stats ("
+				" ats_origin, ats_tableid, ats_num_insert, ats_num_update, "
+				" ats_num_delete, ats_num_truncate, ats_duration, "
+				" ats_max_latency, ats_apply_first, ats_apply_last) "
+				"values "
+				"($1, $2, $3, $4, $5, $6, $7 * '1 microsecond'::interval, "
+				"$8 * '1 microsecond'::interval, "
+				"\"pg_catalog\".timeofday()::timestamptz, "
+				"\"pg_catalog\".timeofday()::timestamptz);",
+				slon_quote_identifier(NameStr(*cluster_name)));
+
+		cs->plan_apply_table_stats_insert = SPI_saveplan(
+										  SPI_prepare(query, 8, plan_types));
+		if (cs->plan_apply_table_stats_insert == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
 		cs->have_plan |= PLAN_APPLY_QUERIES;
 	}
 
@@ -2745,9 +6678,11 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 		sprintf(query, "INSERT INTO %s.sl_log_1 "
 				"(log_origin, log_txid, log_tableid, log_actionseq,"
 				" log_tablenspname, log_tablerelname, "
-				" log_cmdtype, log_cmdupdncols, log_cmdargs) "
+				" log_cmdtype, log_cmdupdncols, log_cmdargs, "
+				" log_cmdformat, log_cmdbinargs) "
 				"VALUES (%d, \"pg_catalog\".txid_current(), $1, "
-				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6); ",
+				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6, "
+				"$7, $8); ",
 				cs->clusterident, cs->localNodeId, cs->clusterident);
 		plan_types[0] = INT4OID;
 		plan_types[1] = TEXTOID;
@@ -2755,10 +6690,18 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 		plan_types[3] = TEXTOID;
 		plan_types[4] = INT4OID;
 		plan_types[5] = TEXTARRAYOID;
+		plan_types[6] = INT4OID;
+		plan_types[7] = BYTEAARRAYOID;
 
-		cs->plan_insert_log_1 = SPI_saveplan(SPI_prepare(query, 6, plan_types));
+		cs->plan_insert_log_1 = SPI_saveplan(SPI_prepare(query, 8, plan_types));
 		if (cs->plan_insert_log_1 == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+		cs->plan_buffer_log_1 = prepareLogBufferPlan(cs, 1, 1);
+		cs->plan_buffer_batch_1 = prepareLogBufferPlan(cs, 1,
+													  LOG_BUFFER_BATCH);
+#endif
 	}
 	else if ((log_status == 1 ||
 			  log_status == 3) &&
@@ -2767,9 +6710,11 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 		sprintf(query, "INSERT INTO %s.sl_log_2 "
 				"(log_origin, log_txid, log_tableid, log_actionseq,"
 				" log_tablenspname, log_tablerelname, "
-				" log_cmdtype, log_cmdupdncols, log_cmdargs) "
+				" log_cmdtype, log_cmdupdncols, log_cmdargs, "
+				" log_cmdformat, log_cmdbinargs) "
 				"VALUES (%d, \"pg_catalog\".txid_current(), $1, "
-				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6); ",
+				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6, "
+				"$7, $8); ",
 				cs->clusterident, cs->localNodeId, cs->clusterident);
 		plan_types[0] = INT4OID;
 		plan_types[1] = TEXTOID;
@@ -2777,15 +6722,82 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 		plan_types[3] = TEXTOID;
 		plan_types[4] = INT4OID;
 		plan_types[5] = TEXTARRAYOID;
+		plan_types[6] = INT4OID;
+		plan_types[7] = BYTEAARRAYOID;
 
-		cs->plan_insert_log_2 = SPI_saveplan(SPI_prepare(query, 6, plan_types));
+		cs->plan_insert_log_2 = SPI_saveplan(SPI_prepare(query, 8, plan_types));
 		if (cs->plan_insert_log_2 == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+		cs->plan_buffer_log_2 = prepareLogBufferPlan(cs, 2, 1);
+		cs->plan_buffer_batch_2 = prepareLogBufferPlan(cs, 2,
+													  LOG_BUFFER_BATCH);
+#endif
 	}
 
 	return 0;
 }
 
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+/*
+ * prepareLogBufferPlan -
+ *
+ *	Prepare the plan that writes nrows buffered log rows into
+ *	sl_log_<log_no>. Unlike the plans of prepareLogPlan() the
+ *	log_actionseq is a parameter, since the rows got it assigned
+ *	when they were captured.
+ */
+static void *
+prepareLogBufferPlan(Slony_I_ClusterStatus * cs, int log_no, int nrows)
+{
+	StringInfoData query;
+	Oid		   *plan_types;
+	void	   *plan;
+	int			i;
+
+	initStringInfo(&query);
+	plan_types = (Oid *) palloc(sizeof(Oid) * nrows * LOG_BUFFER_NPARAMS);
+
+	appendStringInfo(&query, "INSERT INTO %s.sl_log_%d "
+					 "(log_origin, log_txid, log_tableid, log_actionseq,"
+					 " log_tablenspname, log_tablerelname, "
+					 " log_cmdtype, log_cmdupdncols, log_cmdargs, "
+					 " log_cmdformat, log_cmdbinargs) VALUES ",
+					 cs->clusterident, log_no);
+	for (i = 0; i < nrows; i++)
+	{
+		int			p = i * LOG_BUFFER_NPARAMS;
+
+		appendStringInfo(&query, "%s(%d, \"pg_catalog\".txid_current(), "
+						 "$%d, $%d, $%d, $%d, $%d, $%d, $%d, $%d, $%d)",
+						 (i > 0) ? ", " : "", cs->localNodeId,
+						 p + 1, p + 9, p + 2, p + 3, p + 4, p + 5,
+						 p + 6, p + 7, p + 8);
+		plan_types[p + 0] = INT4OID;
+		plan_types[p + 1] = TEXTOID;
+		plan_types[p + 2] = TEXTOID;
+		plan_types[p + 3] = TEXTOID;
+		plan_types[p + 4] = INT4OID;
+		plan_types[p + 5] = TEXTARRAYOID;
+		plan_types[p + 6] = INT4OID;
+		plan_types[p + 7] = BYTEAARRAYOID;
+		plan_types[p + 8] = INT8OID;
+	}
+
+	plan = SPI_saveplan(SPI_prepare(query.data, nrows * LOG_BUFFER_NPARAMS,
+									plan_types));
+	if (plan == NULL)
+		elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+	pfree(query.data);
+	pfree(plan_types);
+
+	return plan;
+}
+#endif   /* HAVE_XACT_EVENT_PRE_COMMIT */
+
+
 /* Provide a way to reset the per-session data structure that stores
    the cluster status in the C functions.
 
@@ -2798,6 +6810,20 @@ versionFunc(resetSession) (PG_FUNCTION_ARGS)
 {
 	Slony_I_ClusterStatus *cs;
 
+	/*
+	 * The logTrigger() cache entries, coalesced rows and buffered log
+	 * rows point into the cluster status list.
+	 */
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	logTrigCoalesceEmit();
+#endif
+	logTrigCacheFlush();
+#ifdef HAVE_XACT_EVENT_PRE_COMMIT
+	logTrigBufferFlush();
+	logBufferCS = NULL;
+#endif
+	applyCacheValid = false;
+
 	cs = clusterStatusList;
 	while (cs != NULL)
 	{
@@ -2816,6 +6842,14 @@ versionFunc(resetSession) (PG_FUNCTION_ARGS)
 			SPI_freeplan(cs->plan_insert_log_1);
 		if (cs->plan_insert_log_2)
 			SPI_freeplan(cs->plan_insert_log_2);
+		if (cs->plan_buffer_log_1)
+			SPI_freeplan(cs->plan_buffer_log_1);
+		if (cs->plan_buffer_log_2)
+			SPI_freeplan(cs->plan_buffer_log_2);
+		if (cs->plan_buffer_batch_1)
+			SPI_freeplan(cs->plan_buffer_batch_1);
+		if (cs->plan_buffer_batch_2)
+			SPI_freeplan(cs->plan_buffer_batch_2);
 		if (cs->plan_record_sequences)
 			SPI_freeplan(cs->plan_record_sequences);
 		if (cs->plan_get_logstatus)
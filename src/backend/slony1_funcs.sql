@@ -195,6 +195,17 @@ create or replace function @NAMESPACE@.logApply () returns trigger
 	language C
 	security definer;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplyFlush ()
+--
+--	A statement level trigger function on sl_log_1/2 that applies the
+--	rows logApply() collected into a batch at the end of the statement.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplyFlush () returns trigger
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplyFlush'
+	language C
+	security definer;
+
 -- ----------------------------------------------------------------------
 -- FUNCTION logApplySetCacheSize ()
 --
@@ -206,6 +217,87 @@ returns int4
     as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySetCacheSize'
 	language C;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplySetCacheMaxSize ()
+--
+--	A control function for the size up to which the logApply() query
+--	cache may grow on its own.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplySetCacheMaxSize (p_size int4) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySetCacheMaxSize'
+	language C;
+
+comment on function @NAMESPACE@.logApplySetCacheMaxSize(p_size int4) is
+'Set the size up to which the logApply() query cache grows when it evicts too often. Values not above the logApplySetCacheSize() setting keep the size fixed. Returns the previous setting; a negative argument only returns it.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplySetBatchSize ()
+--
+--	A control function for the number of log rows the logApply()
+--	trigger applies with one set-based statement.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplySetBatchSize (p_size int4) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySetBatchSize'
+	language C;
+
+comment on function @NAMESPACE@.logApplySetBatchSize(p_size int4) is
+'Set the number of consecutive log rows of one table that logApply() applies with a single set-based statement. 0 or 1 disable batching. Returns the previous setting; a negative argument only returns it.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplySetInsertBatchSize ()
+--
+--	A control function for the number of consecutive INSERT log rows
+--	the logApply() trigger applies with one statement.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplySetInsertBatchSize (p_size int4) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySetInsertBatchSize'
+	language C;
+
+comment on function @NAMESPACE@.logApplySetInsertBatchSize(p_size int4) is
+'Set the number of consecutive INSERT log rows of one table that logApply() applies with a single statement. It only has an effect when larger than the logApplySetBatchSize() setting. Returns the previous setting; a negative argument only returns it.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplySaveTableStats ()
+--
+--	Saves only the per table apply statistics. Used by the additional
+--	connections of a parallel apply.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplySaveTableStats (p_cluster name, p_origin int4) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySaveTableStats'
+	language C;
+
+comment on function @NAMESPACE@.logApplySaveTableStats(p_cluster name, p_origin int4) is
+'Add the per table apply statistics of the current transaction to sl_apply_table_stats.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION applyTableStats (origin)
+--
+--	Returns the per table apply statistics, the tables that cost the
+--	most apply time first. The result columns are spelled out because
+--	the view does not exist yet when an upgrade loads this file.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.applyTableStats (p_origin int4,
+	out ats_origin int4, out ats_tableid int4, out ats_tab_fqname text,
+	out ats_num_insert int8, out ats_num_update int8,
+	out ats_num_delete int8, out ats_num_truncate int8,
+	out ats_num_total int8, out ats_duration interval,
+	out ats_avg_latency interval, out ats_max_latency interval,
+	out ats_apply_first timestamptz, out ats_apply_last timestamptz)
+returns setof record as $$
+begin
+	return query select * from @NAMESPACE@.sl_apply_table_status S
+		where p_origin is null or S.ats_origin = p_origin
+		order by S.ats_duration desc;
+end;
+$$ language plpgsql;
+
+comment on function @NAMESPACE@.applyTableStats(p_origin int4) is
+'Return the per table apply statistics for the given origin, or for all origins if it is NULL, the tables that took the most apply time first.';
+
 -- ----------------------------------------------------------------------
 -- FUNCTION logApplySaveStats ()
 --
@@ -217,6 +309,80 @@ returns int4
     as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySaveStats'
 	language C;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logCmdArgsText (p_cmdargs, p_cmdbinargs)
+--
+--	Returns the log_cmdargs of a log row with all values captured in
+--	the binary log format (log_cmdbinargs) converted to text.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCmdArgsText (p_cmdargs text[], p_cmdbinargs bytea[]) 
+returns text[]
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logCmdArgsText'
+	language C;
+
+comment on function @NAMESPACE@.logCmdArgsText (p_cmdargs text[], p_cmdbinargs bytea[]) is
+'Return log_cmdargs with the values of log_cmdbinargs converted to text.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logActionseqInRanges (p_actionseq, p_ranges)
+--
+--	Check if an action sequence falls into one of the lo, hi pairs of
+--	p_ranges. Used by slon to skip log rows already in a set copy.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logActionseqInRanges (p_actionseq int8, p_ranges int8[]) 
+returns bool
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logActionseqInRanges'
+	language C strict immutable;
+
+comment on function @NAMESPACE@.logActionseqInRanges (p_actionseq int8, p_ranges int8[]) is
+'Return true if p_actionseq is in one of the lo, hi ranges of p_ranges.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logSyncRows (p_cluster, p_origin, p_log_status, p_tables,
+--		p_last_snapshot, p_this_snapshot, p_actionseq_ranges)
+--
+--	Return the sl_log_1/sl_log_2 rows of the given tables that a SYNC
+--	from p_last_snapshot to p_this_snapshot has to replicate.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logSyncRows (p_cluster name, p_origin int4, p_log_status int4, p_tables int4[], p_last_snapshot "pg_catalog".txid_snapshot, p_this_snapshot "pg_catalog".txid_snapshot, p_actionseq_ranges int8[],
+	OUT log_origin int4, OUT log_txid bigint, OUT log_tableid int4,
+	OUT log_actionseq int8, OUT log_tablenspname text,
+	OUT log_tablerelname text, OUT log_cmdtype "char",
+	OUT log_cmdupdncols int4, OUT log_cmdargs text[],
+	OUT log_cmdformat int4, OUT log_cmdbinargs bytea[])
+returns setof record
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logSyncRows'
+	language C strict;
+
+comment on function @NAMESPACE@.logSyncRows (p_cluster name, p_origin int4, p_log_status int4, p_tables int4[], p_last_snapshot "pg_catalog".txid_snapshot, p_this_snapshot "pg_catalog".txid_snapshot, p_actionseq_ranges int8[]) is
+'Return the log rows of the tables p_tables a SYNC from p_last_snapshot to p_this_snapshot replicates, skipping the action sequences in p_actionseq_ranges.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logCoalesceFlush ()
+--
+--	Log the pending coalesced row changes of the current transaction.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCoalesceFlush () 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logCoalesceFlush'
+	language C;
+
+comment on function @NAMESPACE@.logCoalesceFlush () is
+'Log the pending changes to tables with tab_coalesce set now instead of at commit.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logCoalesceTruncate (p_reloid)
+--
+--	Discard the pending coalesced row changes of a truncated table.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCoalesceTruncate (p_reloid oid) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logCoalesceTruncate'
+	language C;
+
+comment on function @NAMESPACE@.logCoalesceTruncate (p_reloid oid) is
+'Discard the pending coalesced changes to a table that is being truncated.';
+
 
 create or replace function @NAMESPACE@.checkmoduleversion () returns text as $$
 declare
@@ -287,6 +453,23 @@ updates to be recorded in sl_log_1/sl_log_2.';
 
 grant execute on function @NAMESPACE@.logTrigger () to public;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logTriggerStmt ()
+--
+--	Statement level variant of logTrigger() using transition tables.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logTriggerStmt () returns trigger
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logTriggerStmt'
+	language C
+	security definer;
+
+comment on function @NAMESPACE@.logTriggerStmt () is 
+  'Statement level trigger, used instead of logTrigger() on PostgreSQL 10
+and later when the logtrigger.statement registry key is set to 1.  It
+records all rows changed by a statement in sl_log_1/sl_log_2 at once.';
+
+grant execute on function @NAMESPACE@.logTriggerStmt () to public;
+
 -- ----------------------------------------------------------------------
 -- FUNCTION terminateNodeConnections (failed_node)
 --
@@ -717,6 +900,42 @@ comment on function @NAMESPACE@.registerNodeConnection (p_nodeid int4) is
 'Register (uniquely) the node connection so that only one slon can service the node';
 
 
+-- ----------------------------------------------------------------------
+-- FUNCTION add_apply_flush_triggers ()
+--
+--	Put the statement level trigger that applies pending logApply()
+--	batches onto sl_log_1 and sl_log_2, unless it is there already.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.add_apply_flush_triggers ()
+returns integer
+as $$
+begin
+	if not exists (select 1 from "pg_catalog".pg_trigger
+			where tgrelid = '@NAMESPACE@.sl_log_1'::regclass
+			and tgname = 'apply_flush_trigger') then
+		create trigger apply_flush_trigger
+			after INSERT on @NAMESPACE@.sl_log_1
+			for each statement execute procedure @NAMESPACE@.logApplyFlush();
+		alter table @NAMESPACE@.sl_log_1
+			enable replica trigger apply_flush_trigger;
+	end if;
+	if not exists (select 1 from "pg_catalog".pg_trigger
+			where tgrelid = '@NAMESPACE@.sl_log_2'::regclass
+			and tgname = 'apply_flush_trigger') then
+		create trigger apply_flush_trigger
+			after INSERT on @NAMESPACE@.sl_log_2
+			for each statement execute procedure @NAMESPACE@.logApplyFlush();
+		alter table @NAMESPACE@.sl_log_2
+			enable replica trigger apply_flush_trigger;
+	end if;
+	return 0;
+end;
+$$ language plpgsql;
+
+comment on function @NAMESPACE@.add_apply_flush_triggers () is
+'Create the apply_flush_trigger on sl_log_1 and sl_log_2 if missing';
+
+
 -- ----------------------------------------------------------------------
 -- FUNCTION initializeLocalNode (no_id, no_comment)
 --
@@ -764,6 +983,7 @@ begin
 		for each row execute procedure @NAMESPACE@.logApply('_@CLUSTERNAME@');
 	alter table @NAMESPACE@.sl_log_2
 			enable replica trigger apply_trigger;
+	perform @NAMESPACE@.add_apply_flush_triggers();
 
 	return p_local_node_id;
 end;
@@ -2793,6 +3013,27 @@ set add_id into set set_id.';
 create or replace function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text)
 returns bigint
 as $$
+begin
+	return @NAMESPACE@.setAddTable(p_set_id, p_tab_id, p_fqname,
+			p_tab_idxname, p_tab_comment, NULL::text[], NULL::text);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
+'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+
+Add table tab_fqname with all its rows and columns to replication set
+on origin node, and generate SET_ADD_TABLE event to allow this to
+propagate to other nodes.
+
+Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setAddTable (set_id, tab_id, tab_fqname, tab_idxname,
+--					tab_comment, tab_columns, tab_filter)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[], p_tab_filter text)
+returns bigint
+as $$
 declare
 	v_set_origin		int4;
 begin
@@ -2825,18 +3066,24 @@ begin
 	-- Add the table to the set and generate the SET_ADD_TABLE event
 	-- ----
 	perform @NAMESPACE@.setAddTable_int(p_set_id, p_tab_id, p_fqname,
-			p_tab_idxname, p_tab_comment);
+			p_tab_idxname, p_tab_comment, p_tab_columns, p_tab_filter);
 	return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_ADD_TABLE',
 			p_set_id::text, p_tab_id::text, p_fqname::text,
-			p_tab_idxname::text, p_tab_comment::text);
+			p_tab_idxname::text, p_tab_comment::text,
+			p_tab_columns::text, p_tab_filter);
 end;
 $$ language plpgsql;
-comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
-'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[], p_tab_filter text) is
+'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment, tab_columns, tab_filter)
 
 Add table tab_fqname to replication set on origin node, and generate
 SET_ADD_TABLE event to allow this to propagate to other nodes.
 
+If tab_columns is not NULL, only the named columns plus the columns of
+the unique key are captured by the log trigger and copied to the
+subscribers.  If tab_filter is not NULL, only rows for which this
+boolean expression over the table''s columns is true are replicated.
+
 Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
 
 -- ----------------------------------------------------------------------
@@ -2846,6 +3093,24 @@ Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
 create or replace function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) 
 returns int4
 as $$
+begin
+	return @NAMESPACE@.setAddTable_int(p_set_id, p_tab_id, p_fqname,
+			p_tab_idxname, p_tab_comment, NULL::text[], NULL::text);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
+'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+
+Add a table with all its rows and columns to replication; see the
+seven argument form.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname,
+--						tab_comment, tab_columns, tab_filter)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[], p_tab_filter text) 
+returns int4
+as $$
 declare
 	v_tab_relname		name;
 	v_tab_nspname		name;
@@ -2856,6 +3121,8 @@ declare
 	v_tab_reloid		oid;
 	v_pkcand_nn		boolean;
 	v_prec			record;
+	v_tab_columns	text[];
+	v_i				integer;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -2939,26 +3206,132 @@ begin
 		raise exception 'Slony-I: setAddTable_int: table id % has already been assigned!', p_tab_id;
 	end if;
 
+	-- ----
+	-- If only some columns are to be replicated, check that they
+	-- all exist and add the columns of the unique key, which the
+	-- subscribers need to apply UPDATE and DELETE.
+	-- ----
+	if p_tab_columns is not null then
+		for v_i in coalesce(array_lower(p_tab_columns, 1), 1) ..
+				coalesce(array_upper(p_tab_columns, 1), 0)
+		loop
+			if not exists (select 1 from "pg_catalog".pg_attribute PGA
+					where PGA.attrelid = v_tab_reloid
+					and PGA.attname = p_tab_columns[v_i]
+					and PGA.attnum > 0
+					and not PGA.attisdropped)
+			then
+				raise exception 'Slony-I: setAddTable_int(): table % has no column %',
+						p_fqname, p_tab_columns[v_i];
+			end if;
+		end loop;
+
+		v_tab_columns := array(select PGA.attname::text
+				from "pg_catalog".pg_attribute PGA
+				where PGA.attrelid = v_tab_reloid
+				and PGA.attnum > 0
+				and not PGA.attisdropped
+				and (PGA.attname::text = any (p_tab_columns)
+					or exists (select 1
+						from "pg_catalog".pg_index PGX,
+							"pg_catalog".pg_class PGC
+						where PGX.indrelid = v_tab_reloid
+						and PGX.indexrelid = PGC.oid
+						and PGC.relname = p_tab_idxname
+						and PGA.attnum = any (PGX.indkey::int2[])))
+				order by PGA.attnum);
+	end if;
+
+	-- ----
+	-- Make sure that a row filter is a valid boolean expression over
+	-- the table's columns.
+	-- ----
+	if p_tab_filter is not null then
+		execute 'select (' || p_tab_filter || ')::boolean from only ' ||
+				@NAMESPACE@.slon_quote_brute(v_tab_nspname) || '.' ||
+				@NAMESPACE@.slon_quote_brute(v_tab_relname) || ' where false';
+	end if;
+
 	-- ----
 	-- Add the table to sl_table and create the trigger on it.
 	-- ----
 	insert into @NAMESPACE@.sl_table
 			(tab_id, tab_reloid, tab_relname, tab_nspname, 
-			tab_set, tab_idxname, tab_altered, tab_comment) 
+			tab_set, tab_idxname, tab_altered, tab_comment,
+			tab_columns, tab_filter) 
 			values
 			(p_tab_id, v_tab_reloid, v_tab_relname, v_tab_nspname,
-			p_set_id, p_tab_idxname, false, p_tab_comment);
+			p_set_id, p_tab_idxname, false, p_tab_comment,
+			v_tab_columns, p_tab_filter);
 	perform @NAMESPACE@.alterTableAddTriggers(p_tab_id);
 
 	return p_tab_id;
 end;
 $$ language plpgsql;
-comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
-'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[], p_tab_filter text) is
+'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment, tab_columns, tab_filter)
 
 This function processes the SET_ADD_TABLE event on remote nodes,
 adding a table to replication if the remote node is subscribing to its
-replication set.';
+replication set.  A non NULL tab_columns limits replication to those
+columns plus the columns of the unique key, a non NULL tab_filter to
+the rows for which the expression is true.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setTableCoalesce (tab_id, coalesce)
+--
+--	Turn coalescing of the changes to a table within a transaction on
+--	or off. This only affects the local node and is meant to be run
+--	on all nodes through EXECUTE SCRIPT.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setTableCoalesce(p_tab_id int4, p_coalesce boolean)
+returns int4
+as $$
+declare
+	v_tab_row		record;
+	v_tab_fqname	text;
+begin
+	-- ----
+	-- Grab the central configuration lock
+	-- ----
+	lock table @NAMESPACE@.sl_config_lock;
+
+	select T.tab_nspname, T.tab_relname, T.tab_idxname, T.tab_columns,
+			S.set_origin into v_tab_row
+			from @NAMESPACE@.sl_table T, @NAMESPACE@.sl_set S
+			where T.tab_id = p_tab_id
+			and S.set_id = T.tab_set;
+	if not found then
+		raise exception 'Slony-I: setTableCoalesce(): table % not found',
+				p_tab_id;
+	end if;
+
+	update @NAMESPACE@.sl_table
+			set tab_coalesce = p_coalesce
+			where tab_id = p_tab_id;
+
+	-- ----
+	-- On the origin, recreate the log trigger so that sessions pick
+	-- up the new setting.
+	-- ----
+	if v_tab_row.set_origin = @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@') then
+		v_tab_fqname := @NAMESPACE@.slon_quote_brute(v_tab_row.tab_nspname) ||
+				'.' || @NAMESPACE@.slon_quote_brute(v_tab_row.tab_relname);
+		perform @NAMESPACE@.recreate_log_trigger(v_tab_fqname, p_tab_id,
+				@NAMESPACE@.determineAttKindUnique(v_tab_fqname,
+					v_tab_row.tab_idxname, v_tab_row.tab_columns));
+	end if;
+
+	return p_tab_id;
+end;
+$$ language plpgsql;
+
+comment on function @NAMESPACE@.setTableCoalesce(p_tab_id int4, p_coalesce boolean) is
+'setTableCoalesce (tab_id, coalesce)
+
+If coalesce is true, the log trigger of the table keeps only the net
+change of every row within a transaction and logs it at commit.  Only
+affects the local node; use EXECUTE SCRIPT to change it on all nodes.';
 
 -- ----------------------------------------------------------------------
 -- FUNCTION setDropTable (tab_id)
@@ -3709,6 +4082,12 @@ begin
            	   seq_last_value from @NAMESPACE@.sl_seqlastvalue
            	   where seq_origin = c_local_node) as FOO
 			where NOT @NAMESPACE@.seqtrack(seq_id,seq_last_value) is NULL));
+
+	-- ----
+	-- Changes to coalesced tables made so far must be applied
+	-- before the script.
+	-- ----
+	perform @NAMESPACE@.logCoalesceFlush();
 	insert into @NAMESPACE@.sl_log_script
 			(log_origin, log_txid, log_actionseq, log_cmdtype, log_cmdargs)
 		values 
@@ -3836,7 +4215,7 @@ begin
 	-- ----
 	-- Get the sl_table row and the current origin of the table. 
 	-- ----
-	select T.tab_reloid, T.tab_set, T.tab_idxname, 
+	select T.tab_reloid, T.tab_set, T.tab_idxname, T.tab_columns,
 			S.set_origin, PGX.indexrelid,
 			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
 			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname
@@ -3858,19 +4237,15 @@ begin
 	v_tab_fqname = v_tab_row.tab_fqname;
 
 	v_tab_attkind := @NAMESPACE@.determineAttKindUnique(v_tab_row.tab_fqname, 
-						v_tab_row.tab_idxname);
+						v_tab_row.tab_idxname, v_tab_row.tab_columns);
 
 	execute 'lock table ' || v_tab_fqname || ' in access exclusive mode';
 
 	-- ----
 	-- Create the log and the deny access triggers
 	-- ----
-	execute 'create trigger "_@CLUSTERNAME@_logtrigger"' || 
-			' after insert or update or delete on ' ||
-			v_tab_fqname || ' for each row execute procedure @NAMESPACE@.logTrigger (' ||
-                               pg_catalog.quote_literal('_@CLUSTERNAME@') || ',' || 
-				pg_catalog.quote_literal(p_tab_id::text) || ',' || 
-				pg_catalog.quote_literal(v_tab_attkind) || ');';
+	perform @NAMESPACE@.create_log_trigger(v_tab_fqname, p_tab_id,
+			v_tab_attkind);
 
 	execute 'create trigger "_@CLUSTERNAME@_denyaccess" ' || 
 			'before insert or update or delete on ' ||
@@ -3939,8 +4314,7 @@ begin
 	-- ----
 	-- Drop both triggers
 	-- ----
-	execute 'drop trigger "_@CLUSTERNAME@_logtrigger" on ' || 
-			v_tab_fqname;
+	perform @NAMESPACE@.drop_log_trigger(v_tab_fqname);
 
 	execute 'drop trigger "_@CLUSTERNAME@_denyaccess" on ' || 
 			v_tab_fqname;
@@ -3966,6 +4340,7 @@ declare
 	v_tab_row			record;
 	v_tab_fqname		text;
 	v_n					int4;
+	v_trigname			name;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -4009,8 +4384,16 @@ begin
 		-- On the origin the log trigger is configured like a default
 		-- user trigger and the deny access trigger is disabled.
 		-- ----
-		execute 'alter table ' || v_tab_fqname ||
-				' enable trigger "_@CLUSTERNAME@_logtrigger"';
+		for v_trigname in select tgname from "pg_catalog".pg_trigger
+				where tgrelid = v_tab_row.tab_reloid
+				and tgname in ('_@CLUSTERNAME@_logtrigger',
+						'_@CLUSTERNAME@_logtrigger_ins',
+						'_@CLUSTERNAME@_logtrigger_upd',
+						'_@CLUSTERNAME@_logtrigger_del')
+		loop
+			execute 'alter table ' || v_tab_fqname ||
+					' enable trigger ' || @NAMESPACE@.slon_quote_brute(v_trigname);
+		end loop;
 		execute 'alter table ' || v_tab_fqname ||
 				' disable trigger "_@CLUSTERNAME@_denyaccess"';
         perform @NAMESPACE@.alterTableConfigureTruncateTrigger(v_tab_fqname,
@@ -4020,8 +4403,16 @@ begin
 		-- On a replica the log trigger is disabled and the
 		-- deny access trigger fires in origin session role.
 		-- ----
-		execute 'alter table ' || v_tab_fqname ||
-				' disable trigger "_@CLUSTERNAME@_logtrigger"';
+		for v_trigname in select tgname from "pg_catalog".pg_trigger
+				where tgrelid = v_tab_row.tab_reloid
+				and tgname in ('_@CLUSTERNAME@_logtrigger',
+						'_@CLUSTERNAME@_logtrigger_ins',
+						'_@CLUSTERNAME@_logtrigger_upd',
+						'_@CLUSTERNAME@_logtrigger_del')
+		loop
+			execute 'alter table ' || v_tab_fqname ||
+					' disable trigger ' || @NAMESPACE@.slon_quote_brute(v_trigname);
+		end loop;
 		execute 'alter table ' || v_tab_fqname ||
 				' enable trigger "_@CLUSTERNAME@_denyaccess"';
         perform @NAMESPACE@.alterTableConfigureTruncateTrigger(v_tab_fqname,
@@ -4888,6 +5279,28 @@ is no unique index, it raises an exception.';
 -- ----------------------------------------------------------------------
 create or replace function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) returns text
 as $$
+begin
+	return @NAMESPACE@.determineAttkindUnique(p_tab_fqname, p_idx_name,
+			NULL::text[]);
+end;
+$$ language plpgsql called on null input;
+
+comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) is
+'determineAttKindUnique (tab_fqname, indexname)
+
+Given a tablename, return the Slony-I specific attkind (used for the
+log trigger) of the table. Use the specified unique index or the
+primary key (if indexname is NULL).';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION determineAttKindUnique (tab_fqname, indexname, tab_columns)
+--
+--	Same as above, but columns that are neither key columns nor listed
+--	in tab_columns are marked with an "x" so that the log trigger
+--	does not capture them.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name, p_tab_columns text[]) returns text
+as $$
 declare
 	v_tab_fqname_quoted	text default '';
 	v_idx_name_quoted	text;
@@ -4972,6 +5385,9 @@ begin
 
 		if v_attfound then
 			v_attkind := v_attkind || 'k';
+		elsif p_tab_columns is not null and
+				not v_attrow.attname::text = any (p_tab_columns) then
+			v_attkind := v_attkind || 'x';
 		else
 			v_attkind := v_attkind || 'v';
 		end if;
@@ -4987,12 +5403,13 @@ begin
 end;
 $$ language plpgsql called on null input;
 
-comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) is
-'determineAttKindUnique (tab_fqname, indexname)
+comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name, p_tab_columns text[]) is
+'determineAttKindUnique (tab_fqname, indexname, tab_columns)
 
 Given a tablename, return the Slony-I specific attkind (used for the
 log trigger) of the table. Use the specified unique index or the
-primary key (if indexname is NULL).';
+primary key (if indexname is NULL). Columns not in tab_columns (unless
+NULL) are marked x for exclusion.';
 
 
 -- ----------------------------------------------------------------------
@@ -5876,6 +6293,63 @@ create table @NAMESPACE@.sl_components (
 	   alter table @NAMESPACE@.sl_node add column no_failed bool;
 	   update @NAMESPACE@.sl_node set no_failed=false;
 	end if;
+
+	-- ----
+	-- Columns for the binary log capture format
+	-- ----
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_log_1', 'log_cmdformat', 'int4');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_log_1', 'log_cmdbinargs', 'bytea[]');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_log_2', 'log_cmdformat', 'int4');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_log_2', 'log_cmdbinargs', 'bytea[]');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_table', 'tab_columns', 'text[]');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_table', 'tab_filter', 'text');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_table', 'tab_coalesce', 'boolean');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_apply_stats', 'as_cache_size', 'int4');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_apply_stats', 'as_cache_resize', 'int8');
+	perform @NAMESPACE@.add_missing_table_field('_@CLUSTERNAME@', 'sl_apply_stats', 'as_cache_evict_cost', 'int8');
+	perform @NAMESPACE@.add_apply_flush_triggers();
+
+	if not exists (select 1 from information_schema.tables t 
+			where table_schema = '_@CLUSTERNAME@' 
+			and table_name = 'sl_apply_table_stats') then
+		v_query := '
+			create table @NAMESPACE@.sl_apply_table_stats (
+				ats_origin			int4,
+				ats_tableid			int4,
+				ats_num_insert		int8,
+				ats_num_update		int8,
+				ats_num_delete		int8,
+				ats_num_truncate	int8,
+				ats_duration		interval,
+				ats_max_latency		interval,
+				ats_apply_first		timestamptz,
+				ats_apply_last		timestamptz
+			) WITHOUT OIDS;';
+		execute v_query;
+		v_query := '
+			create index sl_apply_table_stats_idx1
+				on @NAMESPACE@.sl_apply_table_stats
+				(ats_origin, ats_tableid);';
+		execute v_query;
+	end if;
+	if not exists (select 1 from information_schema.views where table_schema='_@CLUSTERNAME@' and table_name='sl_apply_table_status') then
+		create view @NAMESPACE@.sl_apply_table_status as
+		select ATS.ats_origin, ATS.ats_tableid,
+				"pg_catalog".quote_ident(T.tab_nspname) || '.' ||
+				"pg_catalog".quote_ident(T.tab_relname) as ats_tab_fqname,
+				ATS.ats_num_insert, ATS.ats_num_update,
+				ATS.ats_num_delete, ATS.ats_num_truncate,
+				ATS.ats_num_insert + ATS.ats_num_update +
+				ATS.ats_num_delete + ATS.ats_num_truncate as ats_num_total,
+				ATS.ats_duration,
+				ATS.ats_duration / "pg_catalog".greatest(ATS.ats_num_insert +
+					ATS.ats_num_update + ATS.ats_num_delete +
+					ATS.ats_num_truncate, 1) as ats_avg_latency,
+				ATS.ats_max_latency,
+				ATS.ats_apply_first, ATS.ats_apply_last
+			from @NAMESPACE@.sl_apply_table_stats ATS
+				left join @NAMESPACE@.sl_table T on T.tab_id = ATS.ats_tableid;
+	end if;
 	return p_old;
 end;
 $$ language plpgsql;
@@ -6031,7 +6505,7 @@ begin
 	result := '';
 	prefix := '(';   -- Initially, prefix is the opening paren
 
-	for prec in select @NAMESPACE@.slon_quote_input(a.attname) as column from @NAMESPACE@.sl_table t, pg_catalog.pg_attribute a where t.tab_id = p_tab_id and t.tab_reloid = a.attrelid and a.attnum > 0 and a.attisdropped = false order by attnum
+	for prec in select @NAMESPACE@.slon_quote_input(a.attname) as column from @NAMESPACE@.sl_table t, pg_catalog.pg_attribute a where t.tab_id = p_tab_id and t.tab_reloid = a.attrelid and a.attnum > 0 and a.attisdropped = false and (t.tab_columns is null or a.attname::text = any (t.tab_columns)) order by attnum
 	loop
 		result := result || prefix || prec.column;
 		prefix := ',';   -- Subsequently, prepend columns with commas
@@ -6043,10 +6517,50 @@ $$ language plpgsql;
 
 comment on function @NAMESPACE@.copyFields(p_tab_id integer) is
 'Return a string consisting of what should be appended to a COPY statement
-to specify fields for the passed-in tab_id.  
+to specify fields for the passed-in tab_id.  If the table is replicated
+with a column list (sl_table.tab_columns), only those columns are returned.
 
 In PG versions > 7.3, this looks like (field1,field2,...fieldn)';
 
+create or replace function @NAMESPACE@.copySource(p_tab_id integer) 
+returns text
+as $$
+declare
+	v_fqname	text;
+	v_filter	text;
+	v_fields	text;
+begin
+	select @NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(PGC.relname), T.tab_filter
+			into v_fqname, v_filter
+			from @NAMESPACE@.sl_table T,
+				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN
+			where T.tab_id = p_tab_id
+				and T.tab_reloid = PGC.oid
+				and PGC.relnamespace = PGN.oid;
+	if not found then
+		raise exception 'Slony-I: copySource(): table % not found', p_tab_id;
+	end if;
+
+	v_fields := @NAMESPACE@.copyFields(p_tab_id);
+	if v_filter is null then
+		return v_fqname || ' ' || v_fields;
+	end if;
+
+	-- ----
+	-- Strip the parentheses of the field list to use it as a select list
+	-- ----
+	return '(select ' || substr(v_fields, 2, length(v_fields) - 2) ||
+			' from only ' || v_fqname || ' where (' || v_filter || '))';
+end;
+$$ language plpgsql;
+
+comment on function @NAMESPACE@.copySource(p_tab_id integer) is
+'Return what should follow COPY in the COPY TO statement that reads
+the passed-in tab_id on the provider during the initial copy.  This is
+either the table name followed by copyFields() or, for a table with a
+row filter (sl_table.tab_filter), a query applying the filter.';
+
 -- ----------------------------------------------------------------------
 -- FUNCTION prepareTableForCopy(tab_id)
 --
@@ -6438,6 +6952,7 @@ $$
 	    c_node := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
 		select tab_nspname, tab_relname into c_nspname, c_relname
 				  from @NAMESPACE@.sl_table where tab_id = c_tabid;
+		perform @NAMESPACE@.logCoalesceTruncate(tg_relid);
 		select last_value into c_log from @NAMESPACE@.sl_log_status;
 		if c_log in (0, 2) then
 			insert into @NAMESPACE@.sl_log_1 (
@@ -6543,19 +7058,76 @@ language plpgsql;
 comment on function @NAMESPACE@.component_state (i_actor text, i_pid integer, i_node integer, i_conn_pid integer, i_activity text, i_starttime timestamptz, i_event bigint, i_eventtype text) is
 'Store state of a Slony component.  Useful for monitoring';
 
+create or replace function @NAMESPACE@.create_log_trigger(p_fq_table_name text,
+       p_tab_id int4, p_tab_attkind text) returns integer as $$
+declare
+	v_tgargs		text;
+begin
+	v_tgargs := pg_catalog.quote_literal('_@CLUSTERNAME@') || ',' || 
+			pg_catalog.quote_literal(p_tab_id::text) || ',' || 
+			pg_catalog.quote_literal(p_tab_attkind);
+
+	-- ----
+	-- Transition tables need one trigger per event.
+	-- ----
+	if coalesce(@NAMESPACE@.registry_get_int4('logtrigger.statement', NULL), 0) = 1
+			and current_setting('server_version_num')::int4 >= 100000 then
+		execute 'create trigger "_@CLUSTERNAME@_logtrigger_ins"' || 
+				' after insert on ' || p_fq_table_name ||
+				' referencing new table as slony_new' ||
+				' for each statement execute procedure' ||
+				' @NAMESPACE@.logTriggerStmt (' || v_tgargs || ');';
+		execute 'create trigger "_@CLUSTERNAME@_logtrigger_upd"' || 
+				' after update on ' || p_fq_table_name ||
+				' referencing old table as slony_old new table as slony_new' ||
+				' for each statement execute procedure' ||
+				' @NAMESPACE@.logTriggerStmt (' || v_tgargs || ');';
+		execute 'create trigger "_@CLUSTERNAME@_logtrigger_del"' || 
+				' after delete on ' || p_fq_table_name ||
+				' referencing old table as slony_old' ||
+				' for each statement execute procedure' ||
+				' @NAMESPACE@.logTriggerStmt (' || v_tgargs || ');';
+	else
+		execute 'create trigger "_@CLUSTERNAME@_logtrigger"' || 
+				' after insert or update or delete on ' ||
+				p_fq_table_name 
+				|| ' for each row execute procedure @NAMESPACE@.logTrigger (' ||
+				v_tgargs || ');';
+	end if;
+	return 0;
+end
+$$ language plpgsql;
+
+comment on function  @NAMESPACE@.create_log_trigger(p_fq_table_name text,
+       p_tab_id int4, p_tab_attkind text) is
+'Create the log trigger on a table. If the registry key logtrigger.statement
+is 1 and the server supports transition tables, three statement level
+triggers are created instead of the row level trigger.';
+
+create or replace function @NAMESPACE@.drop_log_trigger(p_fq_table_name text)
+returns integer as $$
+begin
+	execute 'drop trigger if exists "_@CLUSTERNAME@_logtrigger" on ' ||
+		p_fq_table_name;
+	execute 'drop trigger if exists "_@CLUSTERNAME@_logtrigger_ins" on ' ||
+		p_fq_table_name;
+	execute 'drop trigger if exists "_@CLUSTERNAME@_logtrigger_upd" on ' ||
+		p_fq_table_name;
+	execute 'drop trigger if exists "_@CLUSTERNAME@_logtrigger_del" on ' ||
+		p_fq_table_name;
+	return 0;
+end
+$$ language plpgsql;
+
+comment on function  @NAMESPACE@.drop_log_trigger(p_fq_table_name text) is
+'Drop the row or statement level log trigger(s) of a table.';
+
 create or replace function @NAMESPACE@.recreate_log_trigger(p_fq_table_name text,
        p_tab_id oid, p_tab_attkind text) returns integer as $$
 begin
-	execute 'drop trigger "_@CLUSTERNAME@_logtrigger" on ' ||
-		p_fq_table_name	;
-		-- ----
-	execute 'create trigger "_@CLUSTERNAME@_logtrigger"' || 
-			' after insert or update or delete on ' ||
-			p_fq_table_name 
-			|| ' for each row execute procedure @NAMESPACE@.logTrigger (' ||
-                               pg_catalog.quote_literal('_@CLUSTERNAME@') || ',' || 
-				pg_catalog.quote_literal(p_tab_id::text) || ',' || 
-				pg_catalog.quote_literal(p_tab_attkind) || ');';
+	perform @NAMESPACE@.drop_log_trigger(p_fq_table_name);
+	perform @NAMESPACE@.create_log_trigger(p_fq_table_name,
+			p_tab_id::int4, p_tab_attkind);
 	return 0;
 end
 $$ language plpgsql;
@@ -6576,7 +7148,7 @@ begin
 		select  tab_nspname,tab_relname,
 				tab_idxname, tab_id, mode,
 				@NAMESPACE@.determineAttKindUnique(tab_nspname||
-					'.'||tab_relname,tab_idxname) as attkind
+					'.'||tab_relname,tab_idxname,tab_columns) as attkind
 		from
 				@NAMESPACE@.sl_table
 				left join 
@@ -6585,10 +7157,10 @@ begin
 				,pg_trigger
 		where tab_reloid=tgrelid and 
 		@NAMESPACE@.determineAttKindUnique(tab_nspname||'.'
-						||tab_relname,tab_idxname)
+						||tab_relname,tab_idxname,tab_columns)
 			!=(@NAMESPACE@.decode_tgargs(tgargs))[2]
-			and tgname =  '_@CLUSTERNAME@'
-			|| '_logtrigger'
+			and tgname in ('_@CLUSTERNAME@_logtrigger',
+					'_@CLUSTERNAME@_logtrigger_upd')
 		LOOP
 				if (only_locked=false) or table_row.mode='AccessExclusiveLock' then
 					 perform @NAMESPACE@.recreate_log_trigger
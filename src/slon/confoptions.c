@@ -89,6 +89,30 @@ static struct config_int ConfigureNamesInt[] =
 		0,
 		10000
 	},
+	{
+		{
+			(const char *) "sync_group_maxdata",
+			gettext_noop("maximum MB of log data to be grouped together into one transaction"),
+			gettext_noop("estimated from the log data per SYNC of the last group, 0 disables"),
+			SLON_C_INT
+		},
+		&sync_group_maxdata,
+		0,
+		0,
+		1048576
+	},
+	{
+		{
+			(const char *) "desired_sync_time",
+			gettext_noop("maximum time planned for grouped SYNCs in ms"),
+			gettext_noop("estimated from the time per SYNC of the last group, 0 disables"),
+			SLON_C_INT
+		},
+		&desired_sync_time,
+		60000,
+		0,
+		600000
+	},
 #ifdef HAVE_SYSLOG
 	{
 		{
@@ -214,6 +238,72 @@ static struct config_int ConfigureNamesInt[] =
 		10,
 		2000
 	},
+	{
+		{
+			(const char *) "apply_cache_max_size",
+			gettext_noop("apply cache maximum size"),
+			gettext_noop("size up to which the apply query cache grows "
+						 "when it evicts too often, 0 keeps it fixed"),
+			SLON_C_INT
+		},
+		&apply_cache_max_size,
+		0,
+		0,
+		20000
+	},
+	{
+		{
+			(const char *) "apply_batch_size",
+			gettext_noop("apply batch size"),
+			gettext_noop("number of log rows of one table applied with "
+						 "a single set-based statement, 0 disables"),
+			SLON_C_INT
+		},
+		&apply_batch_size,
+		0,
+		0,
+		10000
+	},
+	{
+		{
+			(const char *) "apply_catchup_batch_size",
+			gettext_noop("apply catch-up batch size"),
+			gettext_noop("number of consecutive INSERT log rows of one "
+						 "table applied with a single statement while "
+						 "the subscriber is behind, 0 disables"),
+			SLON_C_INT
+		},
+		&apply_catchup_batch_size,
+		0,
+		0,
+		100000
+	},
+	{
+		{
+			(const char *) "apply_parallel_conns",
+			gettext_noop("parallel apply connections"),
+			gettext_noop("number of local connections a remote worker "
+						 "uses to apply a SYNC group, 1 applies serially"),
+			SLON_C_INT
+		},
+		&apply_parallel_conns,
+		1,
+		1,
+		32
+	},
+	{
+		{
+			(const char *) "sync_prefetch_buffer",
+			gettext_noop("SYNC prefetch buffer size in kB"),
+			gettext_noop("amount of log data read ahead from the provider "
+						 "while the local connection applies, 0 disables"),
+			SLON_C_INT
+		},
+		&sync_prefetch_buffer,
+		0,
+		0,
+		1048576
+	},
 	{{0}}
 };
 
@@ -262,6 +352,18 @@ static struct config_bool ConfigureNamesBool[] =
 		&monitor_threads,
 		true
 	},
+	{
+		{
+			(const char *) "sync_copy_binary",
+			gettext_noop("Stream SYNC log data from the provider in binary COPY format"),
+			gettext_noop("Only used when both databases use the same "
+						 "server encoding, and never with log archiving "
+						 "or parallel apply"),
+			SLON_C_BOOL,
+		},
+		&sync_copy_binary,
+		false
+	},
 	{{0}}
 };
 
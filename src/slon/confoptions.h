@@ -21,6 +21,7 @@ extern int	sync_interval_timeout;
 extern int	remote_listen_timeout;
 
 extern int	sync_group_maxsize;
+extern int	sync_group_maxdata;
 extern int	desired_sync_time;
 
 extern int	quit_sync_provider;
@@ -31,6 +32,12 @@ extern int	keep_alive_interval;
 extern int	keep_alive_count;
 
 extern int	apply_cache_size;
+extern int	apply_cache_max_size;
+extern int	apply_batch_size;
+extern int	apply_catchup_batch_size;
+extern int	apply_parallel_conns;
+extern bool sync_copy_binary;
+extern int	sync_prefetch_buffer;
 
 /*
  * ----------
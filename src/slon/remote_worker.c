@@ -177,6 +177,15 @@ struct ProviderInfo_s
 	SlonDString helper_query;
 	int			log_status;
 
+	/*
+	 * State of the log selection between sync_helper_start() and
+	 * sync_helper().
+	 */
+	bool		xact_started;
+	bool		copy_binary;
+	bool		copy_sent;
+	struct timeval copy_start;
+
 	ProviderSet *set_head;
 	ProviderSet *set_tail;
 
@@ -195,6 +204,27 @@ struct WorkerGroupData_s
 	ProviderInfo *provider_tail;
 
 	char		duration_buf[64];
+
+	/*
+	 * Local connections used to apply a SYNC group in parallel. Each one
+	 * gets the log rows of a fixed subset of the tables, see
+	 * apply_parallel_route().
+	 */
+	SlonConn  **apply_conn;
+	int			apply_nconn;
+	int			apply_active;	/* connections used by the current SYNC */
+	int			apply_nprepared;	/* ... of which are prepared */
+	bool		apply_serial;	/* retry the SYNC group serially */
+	bool		apply_catchup;	/* SYNC group applied in catch-up mode */
+	char		apply_seqbuf[64];
+
+	/*
+	 * Log rows, bytes and time of the last SYNC group, used by
+	 * sync_group_limit() to size the next one.
+	 */
+	int64		sync_rows;
+	int64		sync_bytes;
+	double		sync_seconds;
 };
 
 
@@ -217,6 +247,8 @@ static struct node_confirm_status *node_confirm_tail = NULL;
 static pthread_mutex_t node_confirm_lock = PTHREAD_MUTEX_INITIALIZER;
 
 int			sync_group_maxsize;
+int			sync_group_maxdata;
+int			desired_sync_time;
 int			explain_interval;
 time_t		explain_lastsec;
 int			explain_thistime;
@@ -258,8 +290,30 @@ static int copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 		 SlonWorkMsg_event * event);
 static int sync_event(SlonNode * node, SlonConn * local_conn,
 		   WorkerGroupData * wd, SlonWorkMsg_event * event);
+static int sync_group_limit(SlonNode * node, WorkerGroupData * wd,
+				 int last_grouping, int proposed);
+static int	sync_helper_start(ProviderInfo * provider);
+static int	sync_helper_send(ProviderInfo * provider, PGconn *local_dbconn);
+static void sync_helper_abort(ProviderInfo * provider);
 static int	sync_helper(void *cdata, PGconn *local_dbconn);
 
+static void apply_parallel_init(SlonNode * node, WorkerGroupData * wd,
+					PGconn *local_dbconn);
+static int	apply_parallel_begin(SlonNode * node, WorkerGroupData * wd);
+static int	apply_parallel_prepare(SlonNode * node, WorkerGroupData * wd,
+					   char *seqbuf);
+static void apply_parallel_finish(SlonNode * node, WorkerGroupData * wd,
+					  bool commit);
+static PGconn *apply_parallel_conn(WorkerGroupData * wd, PGconn *local_dbconn,
+					int part);
+static int	apply_parallel_route(const char *buffer, int len, int nparts);
+static void apply_parallel_gid(char *buf, int origin, char *seqbuf,
+				   int part);
+static bool sync_copy_binary_ok(ProviderInfo * provider,
+					PGconn *local_dbconn);
+static int	sync_prefetch_wait(PGconn *dbconn, WorkerGroupData * wd,
+				   PGconn *local_dbconn, int nparts, int *pending);
+
 
 static int archive_open(SlonNode * node, char *seqbuf,
 			 PGconn *dbconn);
@@ -299,6 +353,8 @@ remoteWorkerThread_main(void *cdata)
 	bool		check_config = true;
 	int64		curr_config = -1;
 	char		seqbuf[64];
+	char		main_gid[256];
+	bool		main_prepared;
 	bool		event_ok;
 	bool		need_reloadListen = false;
 	bool		need_reloadSets = false;
@@ -357,14 +413,32 @@ remoteWorkerThread_main(void *cdata)
 		slon_retry();
 
 	/*
-	 * Tell the logApply() trigger the query cache size to use.
+	 * Tell the logApply() trigger the query cache size to use and how
+	 * far it may grow on its own.
+	 */
+	(void) slon_mkquery(&query1,
+						"select %s.logApplySetCacheSize(%d); "
+						"select %s.logApplySetCacheMaxSize(%d);",
+						rtcfg_namespace, apply_cache_size,
+						rtcfg_namespace, apply_cache_max_size);
+	if (query_execute(node, local_dbconn, &query1) < 0)
+		slon_retry();
+
+	/*
+	 * And the number of rows it may apply with one statement.
 	 */
 	(void) slon_mkquery(&query1,
-						"select %s.logApplySetCacheSize(%d);",
-						rtcfg_namespace, apply_cache_size);
+						"select %s.logApplySetBatchSize(%d);",
+						rtcfg_namespace, apply_batch_size);
 	if (query_execute(node, local_dbconn, &query1) < 0)
 		slon_retry();
 
+	/*
+	 * Resolve what a previous parallel apply left behind and check
+	 * whether we can do it at all.
+	 */
+	apply_parallel_init(node, wd, local_dbconn);
+
 	/*
 	 * Work until shutdown or node destruction
 	 */
@@ -555,7 +629,8 @@ remoteWorkerThread_main(void *cdata)
 				int			initial_proposed = sg_proposed;
 
 				if (sync_status == SYNC_SUCCESS)
-					sg_proposed = sg_last_grouping * 2;
+					sg_proposed = sync_group_limit(node, wd, sg_last_grouping,
+												   sg_last_grouping * 2);
 				else
 					sg_proposed /= 2;	/* This case, at this point, amounts
 										 * to "reset to 1", since when there
@@ -614,6 +689,19 @@ remoteWorkerThread_main(void *cdata)
 				sg_last_grouping = sync_group_size;
 				pthread_mutex_unlock(&(node->message_lock));
 			}
+
+			/*
+			 * More than one queued SYNC means we are behind. Let the
+			 * apply trigger use longer INSERT batches while catching up.
+			 */
+			if (apply_catchup_batch_size > 0)
+			{
+				wd->apply_catchup = (sync_group_size > 1);
+				slon_appendquery(&query1,
+								 "select %s.logApplySetInsertBatchSize(%d); ",
+								 rtcfg_namespace, wd->apply_catchup ?
+								 apply_catchup_batch_size : 0);
+			}
 			while (true)
 			{
 				/*
@@ -638,11 +726,20 @@ remoteWorkerThread_main(void *cdata)
 
 				/*
 				 * Something went wrong. Rollback and try again after the
-				 * specified timeout.
+				 * specified timeout. A group that failed to apply in
+				 * parallel is retried serially.
 				 */
 				archive_terminate(node);
 				slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: rollback SYNC"
 						 " transaction\n", node->no_id);
+				if (wd->apply_active > 0)
+				{
+					slon_log(SLON_INFO, "remoteWorkerThread_%d: "
+							 "retrying SYNC group serially\n",
+							 node->no_id);
+					wd->apply_serial = true;
+				}
+				apply_parallel_finish(node, wd, false);
 				(void) slon_mkquery(&query2, "rollback transaction");
 				if (query_execute(node, local_dbconn, &query2) < 0)
 					slon_retry();
@@ -678,13 +775,45 @@ remoteWorkerThread_main(void *cdata)
 			}
 			strcpy(wd->duration_buf, "0 s");
 
-			slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: committing SYNC"
-					 " transaction\n", node->no_id);
-			slon_appendquery(&query1, "commit transaction;");
+			/*
+			 * With parallel apply the SYNC transaction is prepared as
+			 * well and committed last. Otherwise a cascaded subscriber
+			 * or a local reader could see the new sl_event and
+			 * sl_setsync before the data of the other connections.
+			 */
+			main_prepared = (wd->apply_active > 0);
+			if (main_prepared)
+			{
+				slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: preparing SYNC"
+						 " transaction\n", node->no_id);
+				apply_parallel_gid(main_gid, node->no_id, wd->apply_seqbuf, 0);
+				slon_appendquery(&query1, "prepare transaction '%s';",
+								 main_gid);
+			}
+			else
+			{
+				slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: committing SYNC"
+						 " transaction\n", node->no_id);
+				slon_appendquery(&query1, "commit transaction;");
+			}
 
 			if (query_execute(node, local_dbconn, &query1) < 0)
 				slon_retry();
 
+			/*
+			 * Commit the data applied by the parallel apply connections,
+			 * then the SYNC itself.
+			 */
+			apply_parallel_finish(node, wd, true);
+			wd->apply_serial = false;
+			if (main_prepared)
+			{
+				(void) slon_mkquery(&query1, "commit prepared '%s';",
+									main_gid);
+				if (query_execute(node, local_dbconn, &query1) < 0)
+					slon_retry();
+			}
+
 			/*
 			 * Remember the sync snapshot in the in memory node structure
 			 */
@@ -1543,6 +1672,17 @@ remoteWorkerThread_main(void *cdata)
 	 */
 	adjust_provider_info(node, wd, true, -1);
 
+	if (wd->apply_conn != NULL)
+	{
+		int			part;
+
+		for (part = 0; part < wd->apply_nconn; part++)
+		{
+			if (wd->apply_conn[part] != NULL)
+				slon_disconnectdb(wd->apply_conn[part]);
+		}
+		free(wd->apply_conn);
+	}
 	slon_disconnectdb(local_conn);
 	dstring_free(&query1);
 	dstring_free(&query2);
@@ -2842,7 +2982,8 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 						"select T.tab_id, "
 						"    %s.slon_quote_brute(PGN.nspname) || '.' || "
 						"    %s.slon_quote_brute(PGC.relname) as tab_fqname, "
-						"    T.tab_idxname, T.tab_comment "
+						"    T.tab_idxname, T.tab_comment, T.tab_columns, "
+						"    T.tab_filter "
 						"from %s.sl_table T, "
 						"    \"pg_catalog\".pg_class PGC, "
 						"    \"pg_catalog\".pg_namespace PGN "
@@ -2881,8 +3022,15 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 		char	   *tab_fqname = PQgetvalue(res1, tupno1, 1);
 		char	   *tab_idxname = PQgetvalue(res1, tupno1, 2);
 		char	   *tab_comment = PQgetvalue(res1, tupno1, 3);
+		char	   *tab_columns = NULL;
+		char	   *tab_filter = NULL;
 		int64		copysize = 0;
 
+		if (!PQgetisnull(res1, tupno1, 4))
+			tab_columns = PQgetvalue(res1, tupno1, 4);
+		if (!PQgetisnull(res1, tupno1, 5))
+			tab_filter = PQgetvalue(res1, tupno1, 5);
+
 		gettimeofday(&tv_start2, NULL);
 		slon_log(SLON_CONFIG, "remoteWorkerThread_%d: "
 				 "copy table %s\n",
@@ -2891,14 +3039,35 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 		/*
 		 * Call the setAddTable_int() stored procedure. Up to now, while we
 		 * have not been subscribed to the set, this should have been
-		 * suppressed.
+		 * suppressed. A table replicated with a column list or a row
+		 * filter gets the same here.
 		 */
-		(void) slon_mkquery(&query1,
-							"lock table %s.sl_config_lock;"
+		if (tab_columns == NULL && tab_filter == NULL)
+			(void) slon_mkquery(&query1,
+								"lock table %s.sl_config_lock;"
 					 "select %s.setAddTable_int(%d, %d, '%q', '%q', '%q'); ",
-							rtcfg_namespace,
-							rtcfg_namespace,
+								rtcfg_namespace,
+								rtcfg_namespace,
 					   set_id, tab_id, tab_fqname, tab_idxname, tab_comment);
+		else
+		{
+			(void) slon_mkquery(&query1,
+								"lock table %s.sl_config_lock;"
+								"select %s.setAddTable_int(%d, %d, '%q', '%q', "
+								"'%q', ",
+								rtcfg_namespace,
+								rtcfg_namespace,
+								set_id, tab_id, tab_fqname, tab_idxname,
+								tab_comment);
+			if (tab_columns == NULL)
+				slon_appendquery(&query1, "NULL::text[], ");
+			else
+				slon_appendquery(&query1, "'%q'::text[], ", tab_columns);
+			if (tab_filter == NULL)
+				slon_appendquery(&query1, "NULL::text); ");
+			else
+				slon_appendquery(&query1, "'%q'); ", tab_filter);
+		}
 		if (query_execute(node, loc_dbconn, &query1) < 0)
 		{
 			PQclear(res1);
@@ -2927,7 +3096,9 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 					 "Begin COPY of table %s\n",
 					 node->no_id, tab_fqname);
 
-			(void) slon_mkquery(&query2, "select %s.copyFields(%d);",
+			(void) slon_mkquery(&query2, "select %s.copyFields(%d), "
+								"%s.copySource(%d);",
+								rtcfg_namespace, tab_id,
 								rtcfg_namespace, tab_id);
 
 			res3 = PQexec(pro_dbconn, dstring_data(&query2));
@@ -2998,10 +3169,11 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 			}
 
 			/*
-			 * Begin a COPY to stdout for the table on the provider DB
+			 * Begin a COPY to stdout for the table on the provider DB.
+			 * copySource() applies the row filter of the table, if any.
 			 */
 			(void) slon_mkquery(&query1,
-			   "copy %s %s to stdout; ", tab_fqname, PQgetvalue(res3, 0, 0));
+							"copy %s to stdout; ", PQgetvalue(res3, 0, 1));
 			PQclear(res3);
 			res3 = PQexec(pro_dbconn, dstring_data(&query1));
 			if (PQresultStatus(res3) != PGRES_COPY_OUT)
@@ -3636,7 +3808,11 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 	ProviderSet *pset;
 	char		conn_symname[64];
 
-	/* TODO: tab_forward array to know if we need to store the log */
+	/*
+	 * Whether the log rows are kept in sl_log_N after they have been
+	 * applied is decided by the logApply() trigger, which knows which
+	 * tables we forward.
+	 */
 	PGconn	   *local_dbconn = local_conn->dbconn;
 	PGresult   *res1;
 	int			ntuples1;
@@ -3657,8 +3833,12 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 	int			actionlist_len;
 	int64		min_ssy_seqno;
 	PerfMon		pm;
+	char		log_args_cols[256];
+	char	   *script_args_cols;
 
 	gettimeofday(&tv_start, NULL);
+	wd->sync_rows = 0;
+	wd->sync_bytes = 0;
 
 	slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: SYNC " INT64_FORMAT
 			 " processing\n",
@@ -3670,6 +3850,26 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 
 	init_perfmon(&pm);
 
+	/*
+	 * The log rows carry log_cmdformat and log_cmdbinargs for values
+	 * captured in the binary format. The archive only knows the classic
+	 * layout, so in log archiving mode we let the provider convert those
+	 * values back into log_cmdargs and drop the extra columns.
+	 */
+	if (archive_dir)
+	{
+		snprintf(log_args_cols, sizeof(log_args_cols),
+				 "%s.logCmdArgsText(log_cmdargs, log_cmdbinargs) ",
+				 rtcfg_namespace);
+		script_args_cols = "log_cmdargs ";
+	}
+	else
+	{
+		snprintf(log_args_cols, sizeof(log_args_cols),
+				 "log_cmdargs, log_cmdformat, log_cmdbinargs ");
+		script_args_cols = "log_cmdargs, NULL::integer, NULL::bytea[] ";
+	}
+
 	/*
 	 * If this slon is running in log archiving mode, open a temporary file
 	 * for it.
@@ -3832,7 +4032,6 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 		int			ntables_total = 0;
 		int			rc;
 		int			need_union;
-		int			sl_log_no;
 
 		/**
 		 * ONLY use the event_provider.
@@ -3913,10 +4112,10 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 							 "select log_origin, log_txid, "
 							 "NULL::integer, log_actionseq, "
 							 "NULL::text, NULL::text, log_cmdtype, "
-							 "NULL::integer, log_cmdargs "
+							 "NULL::integer, %s"
 							 "from %s.sl_log_script "
 							 "where log_origin = %d ",
-							 rtcfg_namespace, node->no_id);
+							 script_args_cols, rtcfg_namespace, node->no_id);
 			slon_appendquery(provider_query,
 				   "and log_txid >= \"pg_catalog\".txid_snapshot_xmax('%s') "
 							 "and log_txid < '%s' "
@@ -3930,10 +4129,10 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 							 "select log_origin, log_txid, "
 							 "NULL::integer, log_actionseq, "
 							 "NULL::text, NULL::text, log_cmdtype, "
-							 "NULL::integer, log_cmdargs "
+							 "NULL::integer, %s"
 							 "from %s.sl_log_script "
 							 "where log_origin = %d ",
-							 rtcfg_namespace, node->no_id);
+							 script_args_cols, rtcfg_namespace, node->no_id);
 			slon_appendquery(provider_query,
 							 "and log_txid in (select * from "
 							 "\"pg_catalog\".txid_snapshot_xip('%s') "
@@ -4009,10 +4208,10 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 								 "select log_origin, log_txid, log_tableid, "
 								 "log_actionseq, log_tablenspname, "
 								 "log_tablerelname, log_cmdtype, "
-								 "log_cmdupdncols, log_cmdargs "
+								 "log_cmdupdncols, %s"
 								 "from %s.sl_log_1 "
 								 "where false) TO STDOUT",
-								 rtcfg_namespace);
+								 log_args_cols, rtcfg_namespace);
 				}
 
 				continue;
@@ -4025,7 +4224,6 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 			for (tupno1 = 0; tupno1 < ntuples1; tupno1++)
 			{
 				int			sub_set = strtol(PQgetvalue(res1, tupno1, 0), NULL, 10);
-				char	   *ssy_maxxid = PQgetvalue(res1, tupno1, 2);
 				char	   *ssy_snapshot = PQgetvalue(res1, tupno1, 3);
 				char	   *ssy_action_list = PQgetvalue(res1, tupno1, 4);
 				int64		ssy_seqno;
@@ -4095,148 +4293,54 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 				ntables_total += ntuples2;
 
 				/*
-				 * ... and build up the log selection query
+				 * ... and add the selection of their log rows, which is
+				 * done by logSyncRows() on the provider:
+				 *
+				 * select ... from logSyncRows(<cluster>, X, <log_status>,
+				 * '{<this set's tables>}', '<last_snapshot>',
+				 * '<this_snapshot>', '{<actionseq_ranges_on_first_sync>}')
 				 */
-				for (sl_log_no = 1; sl_log_no <= 2; sl_log_no++)
+				if (need_union)
 				{
-					/*
-					 * We only need to query sl_log_1 when log_status is 0 or
-					 * during log switching (log_status 2 and 3).
-					 */
-					if (sl_log_no == 1 && provider->log_status == 1)
-						continue;
-
-					/*
-					 * Likewise we only query sl_log_2 when log_status is 1, 2
-					 * or 3.
-					 */
-					if (sl_log_no == 2 && provider->log_status == 0)
-						continue;
-
-					if (need_union)
-					{
-						slon_appendquery(provider_query, " union all ");
-					}
-					need_union = 1;
-
-					/*
-					 * First for the big chunk that does the index scan with
-					 * upper and lower bounds:
-					 *
-					 * select ... from sl_log_N where log_origin = X and
-					 * log_tableid in (<this set's tables>)
-					 */
-					slon_appendquery(provider_query,
-								 "select log_origin, log_txid, log_tableid, "
-									 "log_actionseq, log_tablenspname, "
-									 "log_tablerelname, log_cmdtype, "
-									 "log_cmdupdncols, log_cmdargs "
-									 "from %s.sl_log_%d "
-									 "where log_origin = %d "
-									 "and log_tableid in (",
-									 rtcfg_namespace, sl_log_no,
-									 node->no_id);
-					for (tupno2 = 0; tupno2 < ntuples2; tupno2++)
-					{
-						if (tupno2 > 0)
-							dstring_addchar(provider_query, ',');
-						dstring_append(provider_query,
-									   PQgetvalue(res2, tupno2, 0));
-					}
-					dstring_append(provider_query, ") ");
-
-					/*
-					 * and log_txid >= '<maxxid_last_snapshot>' and log_txid <
-					 * '<maxxid_this_snapshot>' and
-					 * txit_visible_in_snapshot(log_txid, '<this_snapshot>')
-					 */
-					slon_appendquery(provider_query,
-									 "and log_txid >= '%s' "
-									 "and log_txid < '%s' "
-									 "and \"pg_catalog\".txid_visible_in_snapshot(log_txid, '%s') ",
-									 ssy_maxxid,
-									 event->ev_maxtxid_c,
-									 event->ev_snapshot_c);
-
-					/*
-					 * and (<actionseq_qual_on_first_sync>)
-					 */
-					actionlist_len = strlen(ssy_action_list);
-					slon_log(SLON_DEBUG2, "remoteWorkerThread_%d_%d: "
-							 "ssy_action_list length: %d\n",
-							 node->no_id, provider->no_id,
-							 actionlist_len);
-					slon_log(SLON_DEBUG4, "remoteWorkerThread_%d_%d: "
-							 "ssy_action_list value: %s\n",
-							 node->no_id, provider->no_id,
-							 ssy_action_list);
-					if (actionlist_len > 0)
-					{
-						dstring_init(&actionseq_subquery);
-						compress_actionseq(ssy_action_list, &actionseq_subquery);
-						slon_appendquery(provider_query,
-										 " and (%s)",
-										 dstring_data(&actionseq_subquery));
-						dstring_free(&actionseq_subquery);
-					}
-
-					/*
-					 * Now do it all over again to get the log rows from
-					 * in-progress transactions at snapshot one that have
-					 * committed by the time of snapshot two. again, we do:
-					 *
-					 * select ... from sl_log_N where log_origin = X and
-					 * log_tableid in (<this set's tables>)
-					 */
+					slon_appendquery(provider_query, " union all ");
+				}
+				need_union = 1;
 
-					slon_appendquery(provider_query,
-									 "union all "
+				slon_appendquery(provider_query,
 								 "select log_origin, log_txid, log_tableid, "
-									 "log_actionseq, log_tablenspname, "
-									 "log_tablerelname, log_cmdtype, "
-									 "log_cmdupdncols, log_cmdargs "
-									 "from %s.sl_log_%d "
-									 "where log_origin = %d "
-									 "and log_tableid in (",
-									 rtcfg_namespace, sl_log_no,
-									 node->no_id);
-					for (tupno2 = 0; tupno2 < ntuples2; tupno2++)
-					{
-						if (tupno2 > 0)
-							dstring_addchar(provider_query, ',');
-						dstring_append(provider_query,
-									   PQgetvalue(res2, tupno2, 0));
-					}
-					dstring_append(provider_query, ") ");
-
-					/*
-					 * and log_txid in (select
-					 * txid_snapshot_xip('<last_snapshot>')) and
-					 * txit_visible_in_snapshot(log_txid, '<this_snapshot>')
-					 */
-					slon_appendquery(provider_query,
-									 "and log_txid in (select * from "
-									 "\"pg_catalog\".txid_snapshot_xip('%s') "
-									 "except "
-									 "select * from "
-								  "\"pg_catalog\".txid_snapshot_xip('%s') )",
-									 ssy_snapshot,
-									 event->ev_snapshot_c);
-
-					/*
-					 * and (<actionseq_qual_on_first_sync>)
-					 */
-					actionlist_len = strlen(ssy_action_list);
-					if (actionlist_len > 0)
-					{
-						dstring_init(&actionseq_subquery);
-						compress_actionseq(ssy_action_list, &actionseq_subquery);
-						slon_appendquery(provider_query,
-										 " and (%s)",
-										 dstring_data(&actionseq_subquery));
-						dstring_free(&actionseq_subquery);
-					}
+								 "log_actionseq, log_tablenspname, "
+								 "log_tablerelname, log_cmdtype, "
+								 "log_cmdupdncols, %s"
+								 "from %s.logSyncRows('_%s', %d, %d, '{",
+								 log_args_cols, rtcfg_namespace,
+								 rtcfg_cluster_name, node->no_id,
+								 provider->log_status);
+				for (tupno2 = 0; tupno2 < ntuples2; tupno2++)
+				{
+					if (tupno2 > 0)
+						dstring_addchar(provider_query, ',');
+					dstring_append(provider_query,
+								   PQgetvalue(res2, tupno2, 0));
 				}
+
+				actionlist_len = strlen(ssy_action_list);
+				slon_log(SLON_DEBUG2, "remoteWorkerThread_%d_%d: "
+						 "ssy_action_list length: %d\n",
+						 node->no_id, provider->no_id,
+						 actionlist_len);
+				slon_log(SLON_DEBUG4, "remoteWorkerThread_%d_%d: "
+						 "ssy_action_list value: %s\n",
+						 node->no_id, provider->no_id,
+						 ssy_action_list);
+				dstring_init(&actionseq_subquery);
+				if (actionlist_len > 0)
+					compress_actionseq(ssy_action_list, &actionseq_subquery);
+				else
+					slon_mkquery(&actionseq_subquery, "{}");
+				slon_appendquery(provider_query, "}', '%s', '%s', '%s') ",
+								 ssy_snapshot, event->ev_snapshot_c,
+								 dstring_data(&actionseq_subquery));
+				dstring_free(&actionseq_subquery);
 				PQclear(res2);
 			}
 			PQclear(res1);
@@ -4262,10 +4366,10 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 						 "select log_origin, log_txid, log_tableid, "
 						 "log_actionseq, log_tablenspname, "
 						 "log_tablerelname, log_cmdtype, "
-						 "log_cmdupdncols, log_cmdargs "
+						 "log_cmdupdncols, %s"
 						 "from %s.sl_log_1 "
 						 "where false) TO STDOUT",
-						 rtcfg_namespace);
+						 log_args_cols, rtcfg_namespace);
 		}
 	}
 
@@ -4328,15 +4432,47 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 	}
 
 	/*
-	 * Time to get the helpers busy.
+	 * Open the transactions of the parallel apply connections. If that
+	 * is not possible, this SYNC group is applied serially.
+	 */
+	if (apply_parallel_begin(node, wd) < 0)
+	{
+		slon_log(SLON_WARN, "remoteWorkerThread_%d: "
+				 "cannot start parallel apply - applying serially\n",
+				 node->no_id);
+		apply_parallel_finish(node, wd, false);
+	}
+
+	/*
+	 * Time to get the helpers busy. The log selection is started on all
+	 * providers first, so they run it concurrently while we read the
+	 * rows of one provider after the other into the local COPY. If any
+	 * provider cannot be started, the others are rolled back before a
+	 * single COPY is sent.
 	 */
 	for (provider = wd->provider_head; provider; provider = provider->next)
 	{
-		/**
-		 * instead of starting the helpers we want to
-		 * perform the COPY on each provider.
-		 */
-		num_errors += sync_helper((void *) provider, local_dbconn);
+		provider->xact_started = false;
+		provider->copy_sent = false;
+	}
+	for (provider = wd->provider_head; provider && num_errors == 0;
+		 provider = provider->next)
+		num_errors += sync_helper_start(provider);
+	for (provider = wd->provider_head; provider && num_errors == 0;
+		 provider = provider->next)
+		num_errors += sync_helper_send(provider, local_dbconn);
+	if (num_errors != 0)
+	{
+		for (provider = wd->provider_head; provider; provider = provider->next)
+			sync_helper_abort(provider);
+	}
+	else
+	{
+		for (provider = wd->provider_head; provider; provider = provider->next)
+		{
+			if (provider->copy_sent)
+				num_errors += sync_helper((void *) provider, local_dbconn);
+		}
 	}
 
 
@@ -4345,13 +4481,16 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 
 
 	/*
-	 * If there have been any errors, abort the SYNC
+	 * If there have been any errors, abort the SYNC. A group that just
+	 * cannot be applied in parallel is retried serially right away.
 	 */
 	if (num_errors != 0)
 	{
 		dstring_free(&query);
 		dstring_free(&lsquery);
 		archive_terminate(node);
+		if (wd->apply_active > 0 && wd->apply_serial)
+			return 1;
 		slon_log(SLON_ERROR, "remoteWorkerThread_%d: SYNC aborted\n",
 				 node->no_id);
 		return 10;
@@ -4499,6 +4638,20 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 		PQclear(res1);
 	}
 
+	/*
+	 * Prepare the transactions of the parallel apply connections. They
+	 * are committed right after the SYNC transaction itself.
+	 */
+	if (apply_parallel_prepare(node, wd, seqbuf) < 0)
+	{
+		dstring_free(&query);
+		dstring_free(&lsquery);
+		archive_terminate(node);
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: SYNC aborted\n",
+				 node->no_id);
+		return 10;
+	}
+
 	/*
 	 * Add the final commit to the archive log, close it and rename the
 	 * temporary file to the real log chunk filename.
@@ -4521,6 +4674,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 			 node->no_id, event->ev_seqno,
 			 TIMEVAL_DIFF(&tv_start, &tv_now));
 	sprintf(wd->duration_buf, "%.3f s", TIMEVAL_DIFF(&tv_start, &tv_now));
+	wd->sync_seconds = TIMEVAL_DIFF(&tv_start, &tv_now);
 
 	slon_log(SLON_DEBUG1,
 		   "remoteWorkerThread_%d: SYNC " INT64_FORMAT " sync_event timing: "
@@ -4538,32 +4692,72 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 
 
 /* ----------
- * sync_helper
+ * sync_group_limit
+ *
+ * Cuts down the proposed number of SYNCs in the next group so that,
+ * going by the time and log data per SYNC of the last group, it should
+ * take no longer than desired_sync_time and carry no more than
+ * sync_group_maxdata MB of log data. Event counts alone are a poor
+ * guide, as one SYNC may carry a few rows and the next millions.
  * ----------
  */
 static int
-sync_helper(void *cdata, PGconn *local_conn)
+sync_group_limit(SlonNode * node, WorkerGroupData * wd,
+				 int last_grouping, int proposed)
+{
+	double		per_sync;
+	double		limit;
+
+	if (last_grouping < 1)
+		return proposed;
+
+	if (desired_sync_time > 0 && wd->sync_seconds > 0.0)
+	{
+		per_sync = wd->sync_seconds * 1000.0 / last_grouping;
+		limit = (double) desired_sync_time / per_sync;
+		if (limit < proposed)
+			proposed = (int) limit;
+	}
+	if (sync_group_maxdata > 0 && wd->sync_bytes > 0)
+	{
+		per_sync = (double) wd->sync_bytes / last_grouping;
+		limit = (double) sync_group_maxdata * 1048576.0 / per_sync;
+		if (limit < proposed)
+			proposed = (int) limit;
+	}
+	if (proposed < 1)
+		proposed = 1;
+
+	slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: last SYNC group of %d: "
+			 INT64_FORMAT " rows " INT64_FORMAT " bytes %.3f seconds "
+			 "- proposing %d\n",
+			 node->no_id, last_grouping, wd->sync_rows, wd->sync_bytes,
+			 wd->sync_seconds, proposed);
+
+	return proposed;
+}
+
+
+/* ----------
+ * sync_helper_start
+ *
+ * Opens the transaction for the log selection on a provider. On error
+ * the transaction is rolled back again.
+ * ----------
+ */
+static int
+sync_helper_start(ProviderInfo * provider)
 {
-	ProviderInfo *provider = (ProviderInfo *) cdata;
 	SlonNode   *node = provider->wd->node;
-	WorkerGroupData *wd = provider->wd;
 	PGconn	   *dbconn;
 	SlonDString query;
-	SlonDString copy_in;
 	int			errors;
-	struct timeval tv_start;
-	struct timeval tv_now;
-	int			first_fetch;
 	int			log_status;
 	int			rc;
-	int			rc2;
 	int			ntuples;
 	int			tupno;
 	PGresult   *res = NULL;
 	PGresult   *res2 = NULL;
-	char	   *buffer;
-
-	PerfMon		pm;
 
 	dstring_init(&query);
 
@@ -4575,8 +4769,6 @@ sync_helper(void *cdata, PGconn *local_conn)
 
 	errors = 0;
 
-	init_perfmon(&pm);
-
 	/*
 	 * Start a transaction
 	 */
@@ -4585,15 +4777,14 @@ sync_helper(void *cdata, PGconn *local_conn)
 						"set enable_seqscan = off; "
 						"set enable_indexscan = on; ");
 
-	start_monitored_event(&pm);
-
+	provider->xact_started = true;
 	if (query_execute(node, dbconn, &query) < 0)
 	{
 		errors++;
 		dstring_free(&query);
+		sync_helper_abort(provider);
 		return errors;
 	}
-	monitor_subscriber_query(&pm);
 
 	/*
 	 * Get the current sl_log_status value
@@ -4601,9 +4792,7 @@ sync_helper(void *cdata, PGconn *local_conn)
 	(void) slon_mkquery(&query, "select last_value from %s.sl_log_status",
 						rtcfg_namespace);
 
-	start_monitored_event(&pm);
 	res2 = PQexec(dbconn, dstring_data(&query));
-	monitor_provider_query(&pm);
 
 	rc = PQresultStatus(res2);
 	if (rc != PGRES_TUPLES_OK)
@@ -4616,6 +4805,7 @@ sync_helper(void *cdata, PGconn *local_conn)
 		PQclear(res2);
 		errors++;
 		dstring_free(&query);
+		sync_helper_abort(provider);
 		return errors;
 	}
 	if (PQntuples(res2) != 1)
@@ -4627,6 +4817,7 @@ sync_helper(void *cdata, PGconn *local_conn)
 		PQclear(res2);
 		errors++;
 		dstring_free(&query);
+		sync_helper_abort(provider);
 		return errors;
 	}
 	log_status = strtol(PQgetvalue(res2, 0, 0), NULL, 10);
@@ -4661,6 +4852,7 @@ sync_helper(void *cdata, PGconn *local_conn)
 			PQclear(res);
 			dstring_free(&explain_query);
 			errors++;
+			sync_helper_abort(provider);
 			return errors;
 		}
 
@@ -4689,73 +4881,249 @@ sync_helper(void *cdata, PGconn *local_conn)
 		dstring_free(&explain_query);
 	}
 
-	gettimeofday(&tv_start, NULL);
-	first_fetch = true;
-	res = NULL;
+	return errors;
+}
+
+
+/* ----------
+ * sync_helper_send
+ *
+ * Sends the log selection COPY to a provider without waiting for it.
+ * sync_event() sends it to all providers before reading any of them
+ * with sync_helper(), so the providers select their log rows at the
+ * same time.
+ * ----------
+ */
+static int
+sync_helper_send(ProviderInfo * provider, PGconn *local_conn)
+{
+	SlonNode   *node = provider->wd->node;
+	PGconn	   *dbconn = provider->conn->dbconn;
+	SlonDString copy_out;
+
+	gettimeofday(&provider->copy_start, NULL);
 
 	/*
-	 * execute the COPY to read the log data.
+	 * send the COPY to read the log data.
 	 */
-	start_monitored_event(&pm);
-	res = PQexec(dbconn, dstring_data(&provider->helper_query));
-	if (PQresultStatus(res) != PGRES_COPY_OUT)
+	provider->copy_binary = sync_copy_binary_ok(provider, local_conn);
+	dstring_init(&copy_out);
+	slon_mkquery(&copy_out, "%s%s", dstring_data(&provider->helper_query),
+				 (provider->copy_binary) ? " WITH BINARY" : "");
+	if (PQsendQuery(dbconn, dstring_data(&copy_out)) == 0)
 	{
-		errors++;
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error executing COPY OUT: \"%s\" %s",
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error sending COPY OUT: \"%s\" %s",
 				 node->no_id, provider->no_id,
-				 dstring_data(&provider->helper_query),
-				 PQresultErrorMessage(res));
-		PQclear(res);
-		return errors;
+				 dstring_data(&copy_out),
+				 PQerrorMessage(dbconn));
+		dstring_free(&copy_out);
+		return 1;
 	}
-	monitor_provider_query(&pm);
+	provider->copy_sent = true;
+	dstring_free(&copy_out);
 
-	/**
-	 * execute the COPY on the local node to write the log data.
-	 *
-	 */
-	dstring_init(&copy_in);
-	slon_mkquery(&copy_in, "COPY %s.\"sl_log_%d\" ( log_origin, " \
-				 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
-				 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
-				 "log_cmdargs) FROM STDIN",
-				 rtcfg_namespace, wd->active_log_table);
+	return 0;
+}
 
-	res2 = PQexec(local_conn, dstring_data(&copy_in));
-	\
-		if (PQresultStatus(res2) != PGRES_COPY_IN)
-	{
 
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error executing COPY IN: \"%s\" %s",
-				 node->no_id, provider->no_id,
-				 dstring_data(&copy_in),
-				 PQresultErrorMessage(res2));
-		errors++;
-		dstring_free(&copy_in);
-		PQclear(res2);
-		return errors;
+/* ----------
+ * sync_helper_abort
+ *
+ * Rolls back the log selection transaction of a provider that is not
+ * going to be read by sync_helper(). A COPY already sent is cancelled
+ * and its remaining data discarded first.
+ * ----------
+ */
+static void
+sync_helper_abort(ProviderInfo * provider)
+{
+	SlonNode   *node = provider->wd->node;
+	PGconn	   *dbconn = provider->conn->dbconn;
+	SlonDString query;
+	PGresult   *res;
+	char	   *buffer;
 
-	}
-	if (archive_dir)
+	if (provider->copy_sent)
 	{
-		SlonDString log_copy;
-
-		dstring_init(&log_copy);
-		slon_mkquery(&log_copy, "COPY %s.\"sl_log_archive\" ( log_origin, " \
-					 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
-					 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
-					 "log_cmdargs) FROM STDIN;",
-					 rtcfg_namespace);
-		archive_append_ds(node, &log_copy);
-		dstring_free(&log_copy);
-
+		PGcancel   *cancel = PQgetCancel(dbconn);
+		char		errbuf[256];
+
+		if (cancel != NULL)
+		{
+			if (PQcancel(cancel, errbuf, sizeof(errbuf)) == 0)
+				slon_log(SLON_WARN, "remoteWorkerThread_%d_%d: "
+						 "cannot cancel COPY OUT: %s\n",
+						 node->no_id, provider->no_id, errbuf);
+			PQfreeCancel(cancel);
+		}
+		while ((res = PQgetResult(dbconn)) != NULL)
+		{
+			if (PQresultStatus(res) == PGRES_COPY_OUT)
+			{
+				while (PQgetCopyData(dbconn, &buffer, 0) > 0)
+					PQfreemem(buffer);
+			}
+			PQclear(res);
+		}
+		provider->copy_sent = false;
+	}
+
+	if (!provider->xact_started)
+		return;
+	provider->xact_started = false;
+
+	dstring_init(&query);
+	(void) slon_mkquery(&query, "rollback transaction; "
+						"set enable_seqscan = default; "
+						"set enable_indexscan = default; ");
+	(void) query_execute(node, dbconn, &query);
+	dstring_free(&query);
+}
+
+
+/* ----------
+ * sync_helper
+ *
+ * Reads the log selection sent by sync_helper_send() into the
+ * local sl_log.
+ * ----------
+ */
+static int
+sync_helper(void *cdata, PGconn *local_conn)
+{
+	ProviderInfo *provider = (ProviderInfo *) cdata;
+	SlonNode   *node = provider->wd->node;
+	WorkerGroupData *wd = provider->wd;
+	PGconn	   *dbconn;
+	SlonDString query;
+	SlonDString copy_in;
+	int			errors;
+	struct timeval tv_now;
+	int			first_fetch;
+	int			rc;
+	int			rc2;
+	int			tupno;
+	PGresult   *res = NULL;
+	PGresult   *res2 = NULL;
+	char	   *buffer;
+	int			nparts;
+	int			part;
+	bool		copy_binary = provider->copy_binary;
+	int		   *pending = NULL;
+
+	PerfMon		pm;
+
+	dstring_init(&query);
+	dbconn = provider->conn->dbconn;
+	errors = 0;
+	first_fetch = true;
+
+	init_perfmon(&pm);
+
+	/*
+	 * wait for the provider to start the COPY.
+	 */
+	start_monitored_event(&pm);
+	res = PQgetResult(dbconn);
+	if (PQresultStatus(res) != PGRES_COPY_OUT)
+	{
+		errors++;
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error executing COPY OUT: \"%s\" %s",
+				 node->no_id, provider->no_id,
+				 dstring_data(&provider->helper_query),
+				 PQresultErrorMessage(res));
+		PQclear(res);
+
+		/*
+		 * Consume the rest of the results so the connection can be used
+		 * again.
+		 */
+		while ((res = PQgetResult(dbconn)) != NULL)
+			PQclear(res);
+		dstring_free(&query);
+		return errors;
+	}
+	monitor_provider_query(&pm);
+
+	/**
+	 * execute the COPY on the local node to write the log data.
+	 * With parallel apply, every apply connection gets its own COPY.
+	 */
+	dstring_init(&copy_in);
+	slon_mkquery(&copy_in, "COPY %s.\"sl_log_%d\" ( log_origin, " \
+				 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
+				 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
+				 "log_cmdargs%s) FROM STDIN%s",
+				 rtcfg_namespace, wd->active_log_table,
+				 (archive_dir) ? "" : ", log_cmdformat, log_cmdbinargs",
+				 (copy_binary) ? " WITH BINARY" : "");
+
+	nparts = wd->apply_active + 1;
+	for (part = 0; part < nparts; part++)
+	{
+		res2 = PQexec(apply_parallel_conn(wd, local_conn, part),
+					  dstring_data(&copy_in));
+		if (PQresultStatus(res2) != PGRES_COPY_IN)
+		{
+
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error executing COPY IN: \"%s\" %s",
+					 node->no_id, provider->no_id,
+					 dstring_data(&copy_in),
+					 PQresultErrorMessage(res2));
+			errors++;
+			dstring_free(&copy_in);
+			PQclear(res2);
+			return errors;
+
+		}
+		PQclear(res2);
+	}
+	res2 = NULL;
+	if (archive_dir)
+	{
+		SlonDString log_copy;
+
+		dstring_init(&log_copy);
+		slon_mkquery(&log_copy, "COPY %s.\"sl_log_archive\" ( log_origin, " \
+					 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
+					 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
+					 "log_cmdargs) FROM STDIN;",
+					 rtcfg_namespace);
+		archive_append_ds(node, &log_copy);
+		dstring_free(&log_copy);
+
+
+	}
+	dstring_free(&copy_in);
+
+	/*
+	 * With a prefetch buffer the local COPY IN runs in nonblocking mode,
+	 * so reading from the provider continues while the local backend
+	 * is busy applying the rows already sent.
+	 */
+	if (sync_prefetch_buffer > 0)
+	{
+		pending = (int *) calloc(nparts, sizeof(int));
+		for (part = 0; part < nparts; part++)
+			PQsetnonblocking(apply_parallel_conn(wd, local_conn, part), 1);
+	}
 
-	}
-	dstring_free(&copy_in);
 	tupno = 0;
 	while (!errors)
 	{
-		rc = PQgetCopyData(dbconn, &buffer, 0);
+		rc = PQgetCopyData(dbconn, &buffer, (pending != NULL) ? 1 : 0);
+		if (rc == 0)
+		{
+			if (sync_prefetch_wait(dbconn, wd, local_conn, nparts,
+								   pending) < 0)
+			{
+				slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error "
+						 "waiting for copy data: %s",
+						 node->no_id, provider->no_id, PQerrorMessage(dbconn));
+				errors++;
+			}
+			continue;
+		}
 		if (rc < 0)
 		{
 			if (rc == -2)
@@ -4773,37 +5141,117 @@ sync_helper(void *cdata, PGconn *local_conn)
 			slon_log(SLON_DEBUG1,
 			  "remoteWorkerThread_%d_%d: %.3f seconds delay for first row\n",
 					 node->no_id, provider->no_id,
-					 TIMEVAL_DIFF(&tv_start, &tv_now));
+					 TIMEVAL_DIFF(&provider->copy_start, &tv_now));
 
 			first_fetch = false;
 		}
-		rc2 = PQputCopyData(local_conn, buffer, rc);
-		if (rc2 < 0)
+
+		/*
+		 * Send the row to the apply connection of its table. Rows that
+		 * cannot be routed mean the group must be applied serially.
+		 */
+		part = 0;
+		if (nparts > 1)
+		{
+			part = apply_parallel_route(buffer, rc, nparts);
+			if (part < 0)
+			{
+				slon_log(SLON_INFO, "remoteWorkerThread_%d_%d: "
+						 "SYNC group contains DDL or TRUNCATE - "
+						 "cannot apply it in parallel\n",
+						 node->no_id, provider->no_id);
+				wd->apply_serial = true;
+				errors++;
+				if (buffer)
+					PQfreemem(buffer);
+				break;
+			}
+		}
+		rc2 = PQputCopyData(apply_parallel_conn(wd, local_conn, part),
+							buffer, rc);
+		if (rc2 <= 0)
 		{
 			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error writing" \
 					 " to sl_log: %s\n",
 					 node->no_id, provider->no_id,
-					 PQerrorMessage(local_conn));
+					 PQerrorMessage(apply_parallel_conn(wd, local_conn,
+														part)));
 			errors++;
 			if (buffer)
 				PQfreemem(buffer);
 			break;
 		}
 
+		wd->sync_bytes += rc;
 		if (archive_dir)
 			archive_append_data(node, buffer, rc);
 		if (buffer)
 			PQfreemem(buffer);
 
+		/*
+		 * Don't let libpq queue more than sync_prefetch_buffer kB for
+		 * a local connection.
+		 */
+		if (pending != NULL)
+		{
+			pending[part] += rc;
+			while (pending[part] > sync_prefetch_buffer * 1024)
+			{
+				if (sync_prefetch_wait(NULL, wd, local_conn, nparts,
+									   pending) < 0)
+				{
+					slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error "
+							 "writing to sl_log: %s\n",
+							 node->no_id, provider->no_id,
+							 PQerrorMessage(apply_parallel_conn(wd,
+													  local_conn, part)));
+					errors++;
+					break;
+				}
+			}
+		}
 	}							/* errors */
-	rc2 = PQputCopyEnd(local_conn, NULL);
-	if (rc2 < 0)
+	if (pending != NULL)
 	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error ending copy"
-				 " to sl_log:%s\n",
-				 node->no_id, provider->no_id,
-				 PQerrorMessage(local_conn));
-		errors++;
+		/*
+		 * Send what is still queued and go back to blocking mode.
+		 */
+		for (;;)
+		{
+			for (part = 0; part < nparts; part++)
+				if (pending[part] > 0)
+					break;
+			if (part == nparts)
+				break;
+			if (sync_prefetch_wait(NULL, wd, local_conn, nparts,
+								   pending) < 0)
+			{
+				slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error "
+						 "writing to sl_log: %s\n",
+						 node->no_id, provider->no_id,
+						 PQerrorMessage(apply_parallel_conn(wd, local_conn,
+															part)));
+				errors++;
+				break;
+			}
+		}
+		for (part = 0; part < nparts; part++)
+			PQsetnonblocking(apply_parallel_conn(wd, local_conn, part), 0);
+		free(pending);
+		pending = NULL;
+	}
+	for (part = 0; part < nparts; part++)
+	{
+		rc2 = PQputCopyEnd(apply_parallel_conn(wd, local_conn, part), NULL);
+		if (rc2 < 0)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error ending copy"
+					 " to sl_log:%s\n",
+					 node->no_id, provider->no_id,
+					 PQerrorMessage(apply_parallel_conn(wd, local_conn,
+														part)));
+			errors++;
+		}
 	}
 
 	if (archive_dir)
@@ -4831,16 +5279,19 @@ sync_helper(void *cdata, PGconn *local_conn)
 	}
 	PQclear(res);
 
-	res = PQgetResult(local_conn);
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+	for (part = 0; part < nparts; part++)
 	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error at end of COPY IN: %s",
-				 node->no_id, provider->no_id,
-				 PQresultErrorMessage(res));
-		errors++;
+		res = PQgetResult(apply_parallel_conn(wd, local_conn, part));
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: error at end of COPY IN: %s",
+					 node->no_id, provider->no_id,
+					 PQresultErrorMessage(res));
+			errors++;
+		}
+		PQclear(res);
+		res = NULL;
 	}
-	PQclear(res);
-	res = NULL;
 
 	if (errors)
 		slon_log(SLON_ERROR,
@@ -4859,9 +5310,10 @@ sync_helper(void *cdata, PGconn *local_conn)
 	slon_log(SLON_DEBUG1,
 			 "remoteWorkerThread_%d_%d: %.3f seconds until close cursor\n",
 			 node->no_id, provider->no_id,
-			 TIMEVAL_DIFF(&tv_start, &tv_now));
+			 TIMEVAL_DIFF(&provider->copy_start, &tv_now));
 	slon_log(SLON_DEBUG1, "remoteWorkerThread_%d_%d: rows=%d\n",
 			 node->no_id, provider->no_id, tupno);
+	wd->sync_rows += tupno;
 
 	slon_log(SLON_DEBUG1,
 			 "remoteWorkerThread_%d: sync_helper timing: "
@@ -4879,6 +5331,588 @@ sync_helper(void *cdata, PGconn *local_conn)
 	return errors;
 }
 
+/* ----------
+ * Functions for applying a SYNC group in parallel...
+ *
+ * With apply_parallel_conns > 1 the remote worker opens additional
+ * local connections. The log rows of a SYNC group are routed by their
+ * log_tableid, so all changes to one table go through one connection
+ * in log_actionseq order while different tables are applied by
+ * different backends at the same time. DDL scripts and TRUNCATE can
+ * affect more than one table, a group containing any is retried on the
+ * main connection alone.
+ *
+ * The additional transactions are prepared first, then the main SYNC
+ * transaction is prepared too. The additional ones are committed
+ * before the main one, so the SYNC does not become visible in sl_event
+ * and sl_setsync before all of its data. If slon dies in between,
+ * apply_parallel_init() finds the prepared transactions on restart.
+ * Once the main transaction of a SYNC was prepared, everything of it is
+ * committed; otherwise sl_setsync tells whether the SYNC made it.
+ * ----------
+ */
+
+
+/* ----------
+ * apply_parallel_init
+ *
+ * Resolves prepared transactions left behind by this remote worker and
+ * allocates the connection array if parallel apply is possible.
+ * ----------
+ */
+static void
+apply_parallel_init(SlonNode * node, WorkerGroupData * wd,
+					PGconn *local_dbconn)
+{
+	SlonDString query;
+	PGresult   *res;
+	PGresult   *res2;
+	char		prefix[256];
+	int			ntuples;
+	int			tupno;
+	int			pass;
+	int			i;
+
+	dstring_init(&query);
+	snprintf(prefix, sizeof(prefix), "slony_%s_%d_%d_",
+			 rtcfg_cluster_name, rtcfg_nodeid, node->no_id);
+
+	/*
+	 * Find the prepared transactions of an interrupted parallel apply.
+	 */
+	(void) slon_mkquery(&query,
+						"select gid from \"pg_catalog\".pg_prepared_xacts "
+						"where database = current_database() "
+						"    and substr(gid, 1, %d) = '%s'; ",
+						(int) strlen(prefix), prefix);
+	res = PQexec(local_dbconn, dstring_data(&query));
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: \"%s\" %s",
+				 node->no_id, dstring_data(&query),
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		dstring_free(&query);
+		slon_retry();
+	}
+	ntuples = PQntuples(res);
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (tupno = 0; tupno < ntuples; tupno++)
+		{
+			char	   *gid = PQgetvalue(res, tupno, 0);
+			char	   *rest = gid + strlen(prefix);
+			char		seqno[64];
+			char		main_gid[256];
+			size_t		len;
+			int			part;
+			bool		committed;
+
+			/*
+			 * The part of the GID after the prefix is <seqno>_<part>,
+			 * part 0 being the main SYNC transaction. The additional
+			 * transactions are resolved first and the main ones in a
+			 * second pass.
+			 */
+			len = strcspn(rest, "_");
+			if (len >= sizeof(seqno))
+				len = sizeof(seqno) - 1;
+			memcpy(seqno, rest, len);
+			seqno[len] = '\0';
+			part = (rest[len] == '_') ? atoi(rest + len + 1) : -1;
+			if ((pass == 0) == (part == 0))
+				continue;
+
+			/*
+			 * A prepared main transaction means the SYNC got to the
+			 * point where everything is committed. Without one the SYNC
+			 * made it if sl_setsync got that far.
+			 */
+			committed = (part == 0);
+			if (!committed)
+			{
+				apply_parallel_gid(main_gid, node->no_id, seqno, 0);
+				for (i = 0; i < ntuples && !committed; i++)
+					committed = (strcmp(PQgetvalue(res, i, 0), main_gid) == 0);
+			}
+			if (!committed)
+			{
+				(void) slon_mkquery(&query,
+									"select 1 from %s.sl_setsync "
+									"where ssy_origin = %d and ssy_seqno >= '%s'; ",
+									rtcfg_namespace, node->no_id, seqno);
+				res2 = PQexec(local_dbconn, dstring_data(&query));
+				if (PQresultStatus(res2) != PGRES_TUPLES_OK)
+				{
+					slon_log(SLON_ERROR, "remoteWorkerThread_%d: \"%s\" %s",
+							 node->no_id, dstring_data(&query),
+							 PQresultErrorMessage(res2));
+					PQclear(res2);
+					PQclear(res);
+					dstring_free(&query);
+					slon_retry();
+				}
+				committed = (PQntuples(res2) > 0);
+				PQclear(res2);
+			}
+
+			slon_log(SLON_INFO, "remoteWorkerThread_%d: "
+					 "%s prepared transaction '%s' of SYNC %s\n",
+					 node->no_id, committed ? "committing" : "rolling back",
+					 gid, seqno);
+			(void) slon_mkquery(&query, "%s prepared '%s'; ",
+								committed ? "commit" : "rollback", gid);
+			if (query_execute(node, local_dbconn, &query) < 0)
+			{
+				PQclear(res);
+				dstring_free(&query);
+				slon_retry();
+			}
+		}
+	}
+	PQclear(res);
+
+	wd->apply_nconn = apply_parallel_conns - 1;
+	if (wd->apply_nconn > 0)
+	{
+		/*
+		 * Every connection, the main one included, holds a prepared
+		 * transaction for a short moment.
+		 */
+		(void) slon_mkquery(&query, "show max_prepared_transactions; ");
+		res = PQexec(local_dbconn, dstring_data(&query));
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: \"%s\" %s",
+					 node->no_id, dstring_data(&query),
+					 PQresultErrorMessage(res));
+			PQclear(res);
+			dstring_free(&query);
+			slon_retry();
+		}
+		if (strtol(PQgetvalue(res, 0, 0), NULL, 10) < wd->apply_nconn + 1)
+		{
+			slon_log(SLON_WARN, "remoteWorkerThread_%d: "
+					 "max_prepared_transactions is %s - "
+					 "parallel apply disabled\n",
+					 node->no_id, PQgetvalue(res, 0, 0));
+			wd->apply_nconn = 0;
+		}
+		PQclear(res);
+	}
+	if (wd->apply_nconn > 0)
+	{
+		wd->apply_conn = (SlonConn **) calloc(wd->apply_nconn,
+											  sizeof(SlonConn *));
+		if (wd->apply_conn == NULL)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "could not calloc() space for apply connections\n",
+					 node->no_id);
+			dstring_free(&query);
+			slon_retry();
+		}
+		slon_log(SLON_CONFIG, "remoteWorkerThread_%d: "
+				 "applying SYNC groups over %d connections\n",
+				 node->no_id, wd->apply_nconn + 1);
+	}
+	wd->apply_active = 0;
+	wd->apply_nprepared = 0;
+	wd->apply_serial = false;
+
+	dstring_free(&query);
+}
+
+
+/* ----------
+ * apply_parallel_begin
+ *
+ * Connects the apply connections if needed and starts their
+ * transactions. Returns -1 if that failed, the caller then rolls back
+ * whatever was started and applies serially.
+ * ----------
+ */
+static int
+apply_parallel_begin(SlonNode * node, WorkerGroupData * wd)
+{
+	SlonDString query;
+	char		conn_symname[64];
+	int			part;
+
+	wd->apply_active = 0;
+	wd->apply_nprepared = 0;
+	if (wd->apply_nconn == 0 || wd->apply_serial)
+		return 0;
+
+	dstring_init(&query);
+	for (part = 0; part < wd->apply_nconn; part++)
+	{
+		if (wd->apply_conn[part] != NULL &&
+			PQstatus(wd->apply_conn[part]->dbconn) != CONNECTION_OK)
+		{
+			slon_disconnectdb(wd->apply_conn[part]);
+			wd->apply_conn[part] = NULL;
+		}
+
+		if (wd->apply_conn[part] == NULL)
+		{
+			sprintf(conn_symname, "remoteWorkerThread_%d_apply_%d",
+					node->no_id, part + 1);
+			wd->apply_conn[part] = slon_connectdb(rtcfg_conninfo,
+												  conn_symname);
+			if (wd->apply_conn[part] == NULL)
+			{
+				dstring_free(&query);
+				return -1;
+			}
+
+			/*
+			 * Same session setup as the main connection.
+			 */
+			(void) slon_mkquery(&query,
+								"set session_replication_role = replica; "
+								"select %s.logApplySetCacheSize(%d); "
+								"select %s.logApplySetCacheMaxSize(%d); "
+								"select %s.logApplySetBatchSize(%d); ",
+								rtcfg_namespace, apply_cache_size,
+								rtcfg_namespace, apply_cache_max_size,
+								rtcfg_namespace, apply_batch_size);
+			if (query_execute(node, wd->apply_conn[part]->dbconn,
+							  &query) < 0)
+			{
+				slon_disconnectdb(wd->apply_conn[part]);
+				wd->apply_conn[part] = NULL;
+				dstring_free(&query);
+				return -1;
+			}
+		}
+
+		(void) slon_mkquery(&query,
+							"begin transaction; "
+						 "set transaction isolation level read committed; ");
+		if (apply_catchup_batch_size > 0)
+			slon_appendquery(&query,
+							 "select %s.logApplySetInsertBatchSize(%d); ",
+							 rtcfg_namespace, wd->apply_catchup ?
+							 apply_catchup_batch_size : 0);
+		if (query_execute(node, wd->apply_conn[part]->dbconn, &query) < 0)
+		{
+			dstring_free(&query);
+			return -1;
+		}
+		wd->apply_active++;
+	}
+
+	dstring_free(&query);
+	return 0;
+}
+
+
+/* ----------
+ * apply_parallel_prepare
+ *
+ * Prepares the transactions of the apply connections for the SYNC
+ * group ending with seqbuf.
+ * ----------
+ */
+static int
+apply_parallel_prepare(SlonNode * node, WorkerGroupData * wd, char *seqbuf)
+{
+	SlonDString query;
+	char		gid[256];
+	int			part;
+
+	if (wd->apply_active == 0)
+		return 0;
+
+	dstring_init(&query);
+	strcpy(wd->apply_seqbuf, seqbuf);
+	for (part = 0; part < wd->apply_active; part++)
+	{
+		apply_parallel_gid(gid, node->no_id, seqbuf, part + 1);
+		dstring_reset(&query);
+		if (monitor_threads)
+		{
+			/*
+			 * The apply statistics of the origin are saved by the main
+			 * connection, only the per table ones are saved here.
+			 */
+			slon_appendquery(&query, "select %s.logApplySaveTableStats("
+							 "'_%s', %d); ",
+							 rtcfg_namespace, rtcfg_cluster_name,
+							 node->no_id);
+		}
+		slon_appendquery(&query, "prepare transaction '%s'; ", gid);
+		if (query_execute(node, wd->apply_conn[part]->dbconn, &query) < 0)
+		{
+			dstring_free(&query);
+			return -1;
+		}
+		wd->apply_nprepared++;
+	}
+
+	dstring_free(&query);
+	return 0;
+}
+
+
+/* ----------
+ * apply_parallel_finish
+ *
+ * Commits or rolls back the transactions of the apply connections. A
+ * failure to resolve a prepared transaction restarts slon, which lets
+ * apply_parallel_init() clean up.
+ * ----------
+ */
+static void
+apply_parallel_finish(SlonNode * node, WorkerGroupData * wd, bool commit)
+{
+	SlonDString query;
+	char		gid[256];
+	int			part;
+
+	if (wd->apply_active == 0)
+		return;
+
+	dstring_init(&query);
+	for (part = 0; part < wd->apply_active; part++)
+	{
+		if (part < wd->apply_nprepared)
+		{
+			apply_parallel_gid(gid, node->no_id, wd->apply_seqbuf, part + 1);
+			(void) slon_mkquery(&query, "%s prepared '%s'; ",
+								commit ? "commit" : "rollback", gid);
+			if (query_execute(node, wd->apply_conn[part]->dbconn,
+							  &query) < 0)
+			{
+				dstring_free(&query);
+				slon_retry();
+			}
+		}
+		else
+		{
+			/*
+			 * If even the rollback fails, dropping the connection makes
+			 * the server abort the transaction.
+			 */
+			(void) slon_mkquery(&query, "rollback transaction; ");
+			if (query_execute(node, wd->apply_conn[part]->dbconn,
+							  &query) < 0)
+			{
+				slon_disconnectdb(wd->apply_conn[part]);
+				wd->apply_conn[part] = NULL;
+			}
+		}
+	}
+	wd->apply_active = 0;
+	wd->apply_nprepared = 0;
+
+	dstring_free(&query);
+}
+
+
+/* ----------
+ * apply_parallel_conn
+ *
+ * Returns the local connection that applies partition part.
+ * ----------
+ */
+static PGconn *
+apply_parallel_conn(WorkerGroupData * wd, PGconn *local_dbconn, int part)
+{
+	if (part == 0)
+		return local_dbconn;
+	return wd->apply_conn[part - 1]->dbconn;
+}
+
+
+/* ----------
+ * apply_parallel_route
+ *
+ * Returns the partition a COPY text row of the log selection goes to,
+ * based on its log_tableid. Rows without a table (DDL scripts) and
+ * TRUNCATE return -1.
+ * ----------
+ */
+static int
+apply_parallel_route(const char *buffer, int len, int nparts)
+{
+	const char *cp = buffer;
+	const char *end = buffer + len;
+	long		tab_id = -1;
+	int			field = 0;
+
+	while (cp < end && field < 7)
+	{
+		/*
+		 * Field 2 is log_tableid, field 6 is log_cmdtype.
+		 */
+		if (field == 2)
+		{
+			if (*cp == '\\')
+				return -1;
+			tab_id = strtol(cp, NULL, 10);
+		}
+		else if (field == 6)
+		{
+			if (*cp == 'T' || *cp == 'S')
+				return -1;
+			break;
+		}
+
+		while (cp < end && *cp != '\t')
+			cp++;
+		cp++;
+		field++;
+	}
+	if (tab_id < 0)
+		return -1;
+
+	return (int) (tab_id % nparts);
+}
+
+
+/* ----------
+ * apply_parallel_gid
+ *
+ * Builds the GID of a prepared parallel apply transaction.
+ * ----------
+ */
+static void
+apply_parallel_gid(char *buf, int origin, char *seqbuf, int part)
+{
+	snprintf(buf, 256, "slony_%s_%d_%d_%s_%d",
+			 rtcfg_cluster_name, rtcfg_nodeid, origin, seqbuf, part);
+}
+
+
+/* ----------
+ * sync_prefetch_wait
+ *
+ * Sends the queued COPY data of the local connections and, if dbconn
+ * is given, waits until either more data from the provider arrives or
+ * a local connection can take more. pending[] holds the number of
+ * bytes queued per local connection and is reset once a connection
+ * has sent everything.
+ * ----------
+ */
+static int
+sync_prefetch_wait(PGconn *dbconn, WorkerGroupData * wd,
+				   PGconn *local_dbconn, int nparts, int *pending)
+{
+	fd_set		rmask;
+	fd_set		wmask;
+	int			maxfd = -1;
+	int			part;
+	int			sock;
+	int			rc;
+
+	FD_ZERO(&rmask);
+	FD_ZERO(&wmask);
+
+	for (part = 0; part < nparts; part++)
+	{
+		PGconn	   *conn = apply_parallel_conn(wd, local_dbconn, part);
+
+		if (pending[part] == 0)
+			continue;
+		rc = PQflush(conn);
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+		{
+			pending[part] = 0;
+			continue;
+		}
+
+		/*
+		 * The backend might be waiting for us to read a notice before it
+		 * takes more data, so watch for input too.
+		 */
+		sock = PQsocket(conn);
+		FD_SET(sock, &rmask);
+		FD_SET(sock, &wmask);
+		if (sock > maxfd)
+			maxfd = sock;
+	}
+	if (dbconn != NULL)
+	{
+		sock = PQsocket(dbconn);
+		FD_SET(sock, &rmask);
+		if (sock > maxfd)
+			maxfd = sock;
+	}
+	if (maxfd < 0)
+		return 0;
+
+	rc = select(maxfd + 1, &rmask, &wmask, NULL, NULL);
+	if (rc < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	for (part = 0; part < nparts; part++)
+	{
+		PGconn	   *conn = apply_parallel_conn(wd, local_dbconn, part);
+
+		if (pending[part] > 0 && FD_ISSET(PQsocket(conn), &rmask))
+		{
+			if (PQconsumeInput(conn) == 0)
+				return -1;
+		}
+	}
+	if (dbconn != NULL && FD_ISSET(PQsocket(dbconn), &rmask))
+	{
+		if (PQconsumeInput(dbconn) == 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/* ----------
+ * sync_copy_binary_ok
+ *
+ * Decides if the log selection of a provider can be streamed into
+ * the local sl_log in binary COPY format. Binary text values are sent
+ * in the server encoding without any conversion, so both databases
+ * must use the same one. The archive and the parallel apply router
+ * need the text format.
+ * ----------
+ */
+static bool
+sync_copy_binary_ok(ProviderInfo * provider, PGconn *local_dbconn)
+{
+	PGconn	   *dbconn = provider->conn->dbconn;
+	const char *remote_enc;
+	const char *local_enc;
+
+	if (!sync_copy_binary || archive_dir || provider->wd->apply_active > 0)
+		return false;
+
+	/*
+	 * COPY (query) TO STDOUT WITH BINARY needs 8.2 or later.
+	 */
+	if (PQserverVersion(dbconn) < 80200 ||
+		PQserverVersion(local_dbconn) < 80200)
+		return false;
+
+	remote_enc = PQparameterStatus(dbconn, "server_encoding");
+	local_enc = PQparameterStatus(local_dbconn, "server_encoding");
+	if (remote_enc == NULL || local_enc == NULL ||
+		strcmp(remote_enc, local_enc) != 0)
+	{
+		slon_log(SLON_DEBUG2, "remoteWorkerThread_%d_%d: server encoding "
+				 "%s differs from local %s - using text COPY\n",
+				 provider->wd->node->no_id, provider->no_id,
+				 (remote_enc == NULL) ? "unknown" : remote_enc,
+				 (local_enc == NULL) ? "unknown" : local_enc);
+		return false;
+	}
+
+	return true;
+}
+
+
 /* ----------
  * Functions for processing log archives...
  *
@@ -5251,6 +6285,10 @@ typedef enum
 
 /* ----------
  * compress_actionseq
+ *
+ * Folds the ssy_action_list of a set into an int8 array literal of
+ * lo,hi pairs of action sequences, for logActionseqInRanges() on the
+ * provider.
  * ----------
  */
 void
@@ -5269,7 +6307,7 @@ compress_actionseq(const char *ssy_actionlist, SlonDString * action_subquery)
 	curr_max = MINMAXINITIAL;
 	first_subquery = 1;
 	state = START_STATE;
-	(void) slon_mkquery(action_subquery, " ");
+	(void) slon_mkquery(action_subquery, "{");
 
 	slon_log(SLON_DEBUG4, "compress_actionseq(list,subquery) Action list: %s\n", ssy_actionlist);
 	while (state != DONE)
@@ -5452,21 +6490,20 @@ compress_actionseq(const char *ssy_actionlist, SlonDString * action_subquery)
 						}
 						else
 						{
-							slon_appendquery(action_subquery, " and ");
+							slon_appendquery(action_subquery, ",");
 						}
 						if (curr_max == curr_min)
 						{
 							slon_log(SLON_DEBUG4, "simple entry - %lld\n", curr_max);
 							slon_appendquery(action_subquery,
-										" log_actionseq <> '%L' ", curr_max);
+											 "%L,%L", curr_max, curr_max);
 						}
 						else
 						{
 							slon_log(SLON_DEBUG4, "between entry - %lld %lld\n",
 									 curr_min, curr_max);
 							slon_appendquery(action_subquery,
-								 " log_actionseq not between '%L' and '%L' ",
-											 curr_min, curr_max);
+											 "%L,%L", curr_min, curr_max);
 						}
 						curr_min = curr_number;
 						curr_max = curr_number;
@@ -5487,26 +6524,26 @@ compress_actionseq(const char *ssy_actionlist, SlonDString * action_subquery)
 		}
 		else
 		{
-			slon_appendquery(action_subquery, " and ");
+			slon_appendquery(action_subquery, ",");
 		}
 		if (curr_max == curr_min)
 		{
 			slon_log(SLON_DEBUG4, "simple entry - %lld\n", curr_max);
 			slon_appendquery(action_subquery,
-							 " log_actionseq <> '%L' ", curr_max);
+							 "%L,%L", curr_max, curr_max);
 		}
 		else
 		{
 			slon_log(SLON_DEBUG4, "between entry - %lld %lld\n",
 					 curr_min, curr_max);
 			slon_appendquery(action_subquery,
-							 " log_actionseq not between '%L' and '%L' ",
-							 curr_min, curr_max);
+							 "%L,%L", curr_min, curr_max);
 		}
 
 
 	}
-	slon_log(SLON_DEBUG4, " compressed actionseq subquery... %s\n", dstring_data(action_subquery));
+	slon_appendquery(action_subquery, "}");
+	slon_log(SLON_DEBUG4, " compressed actionseq ranges... %s\n", dstring_data(action_subquery));
 }
 
 #ifdef UNUSED
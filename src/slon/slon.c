@@ -62,6 +62,12 @@ int			slon_listen_started = 0;
 bool		monitor_threads;
 
 int			apply_cache_size;
+int			apply_cache_max_size;
+int			apply_batch_size;
+int			apply_catchup_batch_size;
+int			apply_parallel_conns;
+bool		sync_copy_binary;
+int			sync_prefetch_buffer;
 
 /* ----------
  * Local data
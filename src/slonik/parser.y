@@ -135,6 +135,7 @@ static int	assign_options(statement_option *so, option_list *ol);
 %token	K_CLONE
 %token	K_CLUSTER
 %token	K_CLUSTERNAME
+%token	K_COLUMNS
 %token	K_COMMENT
 %token	K_CONFIG
 %token	K_CONFIRMED
@@ -153,6 +154,7 @@ static int	assign_options(statement_option *so, option_list *ol);
 %token	K_FAILOVER
 %token	K_FALSE
 %token	K_FILENAME
+%token	K_FILTER
 %token	K_FINISH
 %token	K_FOR
 %token	K_FORWARD
@@ -1104,6 +1106,8 @@ stmt_set_add_table	: lno K_SET K_ADD K_TABLE option_list
 							STMT_OPTION_STR( O_COMMENT, NULL ),
 							STMT_OPTION_STR( O_TABLES,NULL),
 							STMT_OPTION_YN(O_ADD_SEQUENCES,0),
+							STMT_OPTION_STR( O_COLUMNS, NULL ),
+							STMT_OPTION_STR( O_FILTER, NULL ),
 							STMT_OPTION_END
 						};
 
@@ -1124,6 +1128,8 @@ stmt_set_add_table	: lno K_SET K_ADD K_TABLE option_list
 							new->tab_comment	= opt[5].str;
 							new->tables			= opt[6].str;
 							new->add_sequences  = opt[7].ival;
+							new->tab_columns	= opt[8].str;
+							new->tab_filter		= opt[9].str;
 						}
 						else
 							parser_errors++;
@@ -1730,6 +1736,11 @@ option_list_item	: K_ID '=' option_item_id
 						$3->opt_code	= O_CONNRETRY;
 						$$ = $3;
 					}
+					| K_COLUMNS '=' option_item_literal
+					{
+						$3->opt_code	= O_COLUMNS;
+						$$ = $3;
+					}
 					| K_COMMENT '=' option_item_literal
 					{
 						$3->opt_code	= O_COMMENT;
@@ -1785,6 +1796,11 @@ option_list_item	: K_ID '=' option_item_id
 						$3->opt_code	= O_FILENAME;
 						$$ = $3;
 					}
+					| K_FILTER '=' option_item_literal
+					{
+						$3->opt_code	= O_FILTER;
+						$$ = $3;
+					}
 					| K_ORIGIN '=' K_ALL
 					{
 						option_list *new;
@@ -1980,6 +1996,7 @@ option_str(option_code opt_code)
 		case O_ADD_SEQUENCES:	return "add sequences"; 
 		case O_BACKUP_NODE:		return "backup node";
 		case O_CLIENT:			return "client";
+		case O_COLUMNS:			return "columns";
 		case O_COMMENT:			return "comment";
 		case O_CONNINFO:		return "conninfo";
 		case O_CONNRETRY:		return "connretry";
@@ -1988,6 +2005,7 @@ option_str(option_code opt_code)
 		case O_EXECUTE_ONLY_ON:	return "execute only on";
 		case O_EXECUTE_ONLY_LIST:	return "execute only on";
 		case O_FILENAME:		return "filename";
+		case O_FILTER:			return "filter";
 		case O_FORWARD:			return "forward";
 		case O_FQNAME:			return "full qualified name";
 		case O_ID:				return "id";
@@ -777,6 +777,16 @@ script_check_stmts(SlonikScript * script, SlonikStmt * hdr)
 							   hdr->stmt_lno);
 						errors++;
 					}
+					if (stmt->tables != NULL &&
+						(stmt->tab_columns != NULL ||
+						 stmt->tab_filter != NULL))
+					{
+						printf("%s:%d: ERROR: "
+							   "'columns' and 'filter' can not be used with "
+							   "the 'tables' option.", hdr->stmt_filename,
+							   hdr->stmt_lno);
+						errors++;
+					}
 
 					if (stmt->tab_comment == NULL && stmt->tab_fqname != NULL)
 						stmt->tab_comment = strdup(stmt->tab_fqname);
@@ -4251,13 +4261,41 @@ slonik_set_add_single_table(SlonikStmt_set_add_table * stmt,
 	else
 		tab_id = stmt->tab_id;
 
-	slon_mkquery(&query,
-				 "lock table \"_%s\".sl_config_lock;"
-				 "select \"_%s\".setAddTable(%d, %d, '%q', '%q', '%q'); ",
-				 stmt->hdr.script->clustername,
-				 stmt->hdr.script->clustername,
-				 stmt->set_id, tab_id,
-				 fqname, idxname, stmt->tab_comment);
+	if (stmt->tab_columns == NULL && stmt->tab_filter == NULL)
+		slon_mkquery(&query,
+					 "lock table \"_%s\".sl_config_lock;"
+					 "select \"_%s\".setAddTable(%d, %d, '%q', '%q', '%q'); ",
+					 stmt->hdr.script->clustername,
+					 stmt->hdr.script->clustername,
+					 stmt->set_id, tab_id,
+					 fqname, idxname, stmt->tab_comment);
+	else
+	{
+		slon_mkquery(&query,
+					 "lock table \"_%s\".sl_config_lock;"
+					 "select \"_%s\".setAddTable(%d, %d, '%q', '%q', '%q', ",
+					 stmt->hdr.script->clustername,
+					 stmt->hdr.script->clustername,
+					 stmt->set_id, tab_id,
+					 fqname, idxname, stmt->tab_comment);
+
+		/*
+		 * The column list is a comma separated list of column names as
+		 * they appear in pg_attribute.
+		 */
+		if (stmt->tab_columns == NULL)
+			slon_appendquery(&query, "NULL::text[], ");
+		else
+			slon_appendquery(&query,
+							 "pg_catalog.regexp_split_to_array("
+							 "pg_catalog.btrim('%q'), "
+							 "'[[:space:]]*,[[:space:]]*'), ",
+							 stmt->tab_columns);
+		if (stmt->tab_filter == NULL)
+			slon_appendquery(&query, "NULL::text); ");
+		else
+			slon_appendquery(&query, "'%q'); ", stmt->tab_filter);
+	}
 	if (slonik_submitEvent((SlonikStmt *) stmt, adminfo1, &query,
 						   stmt->hdr.script, auto_wait_disabled) < 0)
 	{
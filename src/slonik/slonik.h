@@ -319,6 +319,8 @@ struct SlonikStmt_set_add_table_s
 	char	   *tab_fqname;
 	char	   *tab_comment;
 	char	   *tables;
+	char	   *tab_columns;
+	char	   *tab_filter;
 	int			add_sequences;
 };
 
@@ -660,6 +662,7 @@ typedef enum
 	O_ADD_SEQUENCES,
 	O_BACKUP_NODE,
 	O_CLIENT,
+	O_COLUMNS,
 	O_COMMENT,
 	O_CONNINFO,
 	O_CONNRETRY,
@@ -668,6 +671,7 @@ typedef enum
 	O_EXECUTE_ONLY_ON,
 	O_EXECUTE_ONLY_LIST,
 	O_FILENAME,
+	O_FILTER,
 	O_FORWARD,
 	O_FQNAME,
 	O_ID,